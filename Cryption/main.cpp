@@ -3,21 +3,52 @@
 #include <string>
 #include <algorithm>
 #include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <openssl/crypto.h>
 #include "./src/app/processes/ProcessManagement.hpp"
 #include "./src/app/processes/Task.hpp"
+#include "./src/app/tracing/Trace.hpp"
+#include "./src/app/encryptDecrypt/KeyDerivation.hpp"
+#include "./src/app/encryptDecrypt/BatchCryption.hpp"
+#include "./src/app/encryptDecrypt/Rekey.hpp"
+#include "./src/app/encryptDecrypt/Compression.hpp"
+#include "./src/app/fileHandling/Journal.hpp"
+#include "./src/app/fileHandling/Manifest.hpp"
 
 namespace fs = std::filesystem;
 
 void printUsage(const char* programName) {
     std::cout << "Usage: " << programName << " <directory/filename> <action> [key]" << std::endl;
+    std::cout << "       " << programName << " <directory/filename> rekey <old key> <new key>" << std::endl;
+    std::cout << "       " << programName << " --manifest <file, or - for standard input>" << std::endl;
     std::cout << "  directory/filename: Path to directory or single file to process" << std::endl;
     std::cout << "  action: 'encrypt' or 'decrypt' (or 'e' or 'd')" << std::endl;
-    std::cout << "  key (optional): Encryption/decryption key (default: LockBox)" << std::endl;
+    std::cout << "  key (optional): Password the file key is derived from; without one the key in .env is used" << std::endl;
+    std::cout << "  rekey: moves encrypted files to a new password by rewriting only their headers" << std::endl;
+    std::cout << "  --manifest: runs tab-separated records (key <id> <password>, encrypt|decrypt <id> <path>)" << std::endl;
+    std::cout << "              in one process and prints one result line per file" << std::endl;
     std::cout << std::endl;
     std::cout << "Examples:" << std::endl;
     std::cout << "  " << programName << " /path/to/directory encrypt mykey123" << std::endl;
     std::cout << "  " << programName << " document.txt decrypt" << std::endl;
     std::cout << "  " << programName << " ./files e" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Set CRYPTION_TRACE=<file.json> to record a per-stage trace of the job." << std::endl;
+    std::cout << "Set CRYPTION_KDF=scrypt[:logN:r:p] or pbkdf2[:iterations] to tune key derivation" << std::endl;
+    std::cout << "(default scrypt:15:8:1); the choice and the salt are stored in each file's header." << std::endl;
+    std::cout << "Set CRYPTION_IO=uring or blocking (or pass --backend uring|blocking) to process files in this" << std::endl;
+    std::cout << "process in one batch instead of one worker per file (uring falls back to blocking where io_uring" << std::endl;
+    std::cout << "is unavailable)." << std::endl;
+    std::cout << "Progress is journaled: if a job is interrupted, run the same command again to finish it." << std::endl;
+    std::cout << "Directories run as background work (below-normal CPU priority) and single files as interactive;" << std::endl;
+    std::cout << "set CRYPTION_PRIORITY=interactive or background to override, and CRYPTION_BACKGROUND_MBPS=<MB/s>" << std::endl;
+    std::cout << "to throttle background work. Workers of all running jobs take turns, interactive files first," << std::endl;
+    std::cout << "through a shared intake directory (CRYPTION_INTAKE, default cryption-intake in the temp directory)." << std::endl;
+    std::cout << "Set CRYPTION_COMPRESS=zlib[:level] to compress password-protected files before encrypting" << std::endl;
+    std::cout << "them (files that do not compress are stored as they are)." << std::endl;
 }
 
 
@@ -36,13 +67,41 @@ Action getActionType(const std::string& action) {
     return (action == "encrypt" || action == "e") ? Action::ENCRYPT : Action::DECRYPT;
 }
 
-void processFile(const std::string& filePath, Action taskAction, ProcessManagement& processManagement) {
+// Directory scans skip hidden files (including job journals) and the
+// unfinished results of an interrupted job.
+bool isJobFile(const std::string& name) {
+    size_t suffixLength = sizeof(CRYPTION_TMP_SUFFIX) - 1;
+    return !name.empty() && name[0] != '.' &&
+           !(name.size() > suffixLength &&
+             name.compare(name.size() - suffixLength, suffixLength, CRYPTION_TMP_SUFFIX) == 0);
+}
+
+// Files encrypted in this run share `sessionParams` (one salt), so the KDF
+// runs once for all of them. A file being decrypted brings its own
+// parameters in its header; files without one, and every file when no
+// password was given, use the legacy .env key.
+void processFile(const std::string& filePath, Action taskAction, TaskPriority priority,
+                 ProcessManagement& processManagement, const std::string& password,
+                 const KdfParams& sessionParams, DerivedKeyCache& keyCache) {
     try {
+        TraceSpan span("queue", filePath);
         IO io(filePath);
         std::fstream f_stream = std::move(io.getFileStream());
 
         if (f_stream.is_open()) {
             auto task = std::make_unique<Task>(std::move(f_stream), taskAction, filePath);
+            task->priority = priority;
+            KdfParams params = sessionParams;
+            if (!password.empty() && (taskAction == Action::ENCRYPT || readKdfHeader(filePath, params))) {
+                auto key = std::make_shared<TaskKey>();
+                encodeKdfHeader(params, key->header);
+                TraceSpan kdfSpan("kdf", filePath);
+                if (!keyCache.get(password, params, key->key)) {
+                    std::cout << "Key derivation failed for: " << filePath << std::endl;
+                    return;
+                }
+                task->key = std::move(key);
+            }
             processManagement.submitToQueue(std::move(task));
             std::cout << "Queued: " << filePath << std::endl;
         } else {
@@ -53,9 +112,245 @@ void processFile(const std::string& filePath, Action taskAction, ProcessManageme
     }
 }
 
+// CRYPTION_IO=uring|blocking: all files in this process, see BatchCryption.hpp.
+// Encryption derives the session key once; decryption derives (through the
+// cache) the key for each header it meets, from the crypto threads.
+int runBatch(const std::vector<std::string>& files, Action taskAction, BatchBackend backend,
+             const std::string& password, const KdfParams& sessionParams, DerivedKeyCache& keyCache,
+             JobJournal& journal) {
+    std::shared_ptr<const TaskKey> sessionKey;
+    if (taskAction == Action::ENCRYPT && !password.empty()) {
+        TraceSpan span("kdf", "session");
+        auto key = std::make_shared<TaskKey>();
+        encodeKdfHeader(sessionParams, key->header);
+        if (!keyCache.get(password, sessionParams, key->key)) {
+            std::cerr << "Error: Key derivation failed." << std::endl;
+            return 1;
+        }
+        sessionKey = std::move(key);
+    }
+    KeyResolver resolveKey = [&](const std::vector<unsigned char>& contents) -> std::shared_ptr<const TaskKey> {
+        if (sessionKey || password.empty()) return sessionKey;
+        KdfParams params;
+        if (contents.size() < (size_t)KDF_HEADER_LENGTH || !decodeKdfHeader(contents.data(), params)) return nullptr;
+        auto key = std::make_shared<TaskKey>();
+        memcpy(key->header, contents.data(), KDF_HEADER_LENGTH);
+        if (!keyCache.get(password, params, key->key)) return nullptr;
+        return key;
+    };
+
+    // Files encrypted without a password, or before password support, need
+    // the .env key.
+    unsigned char envKey[AES_KEY_LENGTH];
+    bool haveEnvKey = (taskAction == Action::DECRYPT || password.empty()) && loadEnvKey(envKey);
+
+    BatchResult result;
+    {
+        TraceSpan span("batch", batchBackendName(backend));
+        CommitHook record = [&](size_t index) { return journal.recordDone(files[index]); };
+        result = cryptFilesBatched(files, taskAction, resolveKey, haveEnvKey ? envKey : nullptr, backend, record);
+        span.setBytes(result.bytesIn);
+    }
+    OPENSSL_cleanse(envKey, sizeof(envKey));
+
+    for (const std::string& error : result.errors) std::cout << "Failed: " << error << std::endl;
+    std::cout << "Processed " << result.files << " file(s) (" << result.bytesIn << " bytes) with the "
+              << batchBackendName(result.backend) << " backend in " << result.seconds << " s";
+    size_t retryable = result.failed - result.rejected;
+    if (result.failed) std::cout << "; " << result.failed << " failed";
+    if (retryable) std::cout << " (" << retryable << " of them may succeed if the same command is run again)";
+    std::cout << "." << std::endl;
+    // A journal without finished files has nothing to resume and would only
+    // block the other action.
+    if (!result.failed || journal.doneCount() == 0) journal.remove();
+    traceWriteReport();
+    return result.failed ? 1 : 0;
+}
+
+// Rewraps each file's data key under the new password; see Rekey.hpp. The
+// new key is derived once; old keys once per salt found, through the cache.
+int runRekey(const std::vector<std::string>& files, const std::string& oldPassword,
+             const std::string& newPassword, const KdfParams& sessionParams, DerivedKeyCache& keyCache) {
+    TaskKey newKey;
+    encodeKdfHeader(sessionParams, newKey.header);
+    {
+        TraceSpan span("kdf", "session");
+        if (!keyCache.get(newPassword, sessionParams, newKey.key)) {
+            std::cerr << "Error: Key derivation failed." << std::endl;
+            return 1;
+        }
+    }
+    OldKeyResolver oldKey = [&](const KdfParams& params, unsigned char* key) {
+        return keyCache.get(oldPassword, params, key);
+    };
+
+    RekeyResult result;
+    {
+        TraceSpan span("rekey", std::to_string(files.size()) + " file(s)");
+        result = rekeyFiles(files, oldKey, newKey);
+    }
+    for (const std::string& error : result.errors) std::cout << "Failed: " << error << std::endl;
+    std::cout << "Rekeyed " << result.files << " file(s) in " << result.seconds << " s";
+    if (result.failed) std::cout << "; " << result.failed << " failed";
+    std::cout << "." << std::endl;
+    traceWriteReport();
+    return result.failed ? 1 : 0;
+}
+
+// --manifest: every file record of the manifest (see Manifest.hpp) in this
+// process, through the batch path. Records run grouped by action and key id,
+// so encryption derives each key id's key once and decryption each header's
+// key once (through the cache). One result line per record goes to standard
+// output in manifest order; the summary goes to standard error.
+int runManifest(const std::string& source, BatchBackend backend, const KdfParams& sessionParams,
+                DerivedKeyCache& keyCache) {
+    Manifest manifest;
+    std::string error;
+    bool ok;
+    if (source == "-") {
+        ok = readManifest(std::cin, manifest, error);
+    } else {
+        std::ifstream in(source);
+        if (!in) {
+            std::cerr << "Error: Cannot open manifest " << source << std::endl;
+            return 1;
+        }
+        ok = readManifest(in, manifest, error);
+    }
+    if (!ok) {
+        std::cerr << "Error: Invalid manifest, " << error << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> failures(manifest.entries.size());
+    std::map<std::pair<Action, std::string>, std::vector<size_t>> groups;
+    bool anyDecrypt = false;
+    for (size_t i = 0; i < manifest.entries.size(); ++i) {
+        const ManifestEntry& entry = manifest.entries[i];
+        failures[i] = entry.error;
+        if (!entry.error.empty()) continue;
+        groups[{entry.action, entry.keyId}].push_back(i);
+        anyDecrypt = anyDecrypt || entry.action == Action::DECRYPT;
+    }
+
+    // Only files encrypted before password support need the .env key.
+    unsigned char envKey[AES_KEY_LENGTH];
+    bool haveEnvKey = anyDecrypt && loadEnvKey(envKey);
+
+    size_t done = 0;
+    uint64_t bytes = 0;
+    double seconds = 0;
+    for (const auto& group : groups) {
+        Action action = group.first.first;
+        const std::string& password = manifest.passwords[group.first.second];
+        const std::vector<size_t>& indices = group.second;
+
+        std::shared_ptr<const TaskKey> sessionKey;
+        if (action == Action::ENCRYPT) {
+            TraceSpan span("kdf", "key " + group.first.second);
+            auto key = std::make_shared<TaskKey>();
+            encodeKdfHeader(sessionParams, key->header);
+            if (!keyCache.get(password, sessionParams, key->key)) {
+                for (size_t i : indices) failures[i] = "key derivation failed";
+                continue;
+            }
+            sessionKey = std::move(key);
+        }
+        KeyResolver resolveKey = [&](const std::vector<unsigned char>& contents) -> std::shared_ptr<const TaskKey> {
+            if (sessionKey) return sessionKey;
+            KdfParams params;
+            if (contents.size() < (size_t)KDF_HEADER_LENGTH || !decodeKdfHeader(contents.data(), params)) return nullptr;
+            auto key = std::make_shared<TaskKey>();
+            memcpy(key->header, contents.data(), KDF_HEADER_LENGTH);
+            if (!keyCache.get(password, params, key->key)) return nullptr;
+            return key;
+        };
+
+        std::vector<std::string> paths;
+        for (size_t i : indices) paths.push_back(manifest.entries[i].path);
+        BatchResult result;
+        {
+            TraceSpan span("batch", batchBackendName(backend));
+            result = cryptFilesBatched(paths, action, resolveKey, haveEnvKey ? envKey : nullptr, backend);
+            span.setBytes(result.bytesIn);
+        }
+        for (size_t j = 0; j < indices.size(); ++j) failures[indices[j]] = result.fileErrors[j];
+        done += result.files;
+        bytes += result.bytesIn;
+        seconds += result.seconds;
+    }
+    OPENSSL_cleanse(envKey, sizeof(envKey));
+
+    for (size_t i = 0; i < manifest.entries.size(); ++i) {
+        std::cout << manifestResultLine(manifest.entries[i], failures[i]) << "\n";
+    }
+    std::cout.flush();
+    size_t failed = manifest.entries.size() - done;
+    std::cerr << "Processed " << done << " of " << manifest.entries.size() << " file(s) (" << bytes
+              << " bytes) in " << groups.size() << " group(s) in " << seconds << " s";
+    if (failed) std::cerr << "; " << failed << " failed";
+    std::cerr << "." << std::endl;
+    traceWriteReport();
+    return failed ? 1 : 0;
+}
+
 int main(int argc, char* argv[]) {
-    // Allow 3 or 4 arguments
-    if (argc < 3 || argc > 4) {
+    // --backend uring|blocking (anywhere on the command line) does what
+    // CRYPTION_IO does; it is taken out before the other arguments are read.
+    std::vector<char*> args(argv, argv + argc);
+    std::string backendOption;
+    for (size_t i = 1; i + 1 < args.size(); ++i) {
+        if (std::string(args[i]) == "--backend") {
+            backendOption = args[i + 1];
+            args.erase(args.begin() + i, args.begin() + i + 2);
+            break;
+        }
+    }
+    argc = (int)args.size();
+    args.push_back(nullptr);
+    argv = args.data();
+
+    // Allow 3 or 4 arguments, or 5 for rekey
+    std::string rekeyAction = argc > 2 ? argv[2] : "";
+    std::transform(rekeyAction.begin(), rekeyAction.end(), rekeyAction.begin(), ::tolower);
+    bool rekey = rekeyAction == "rekey";
+    if (rekey && argc == 5) {
+        std::string oldKey = argv[3];
+        std::string newKey = argv[4];
+        clearKey(argv[3]);
+        clearKey(argv[4]);
+        if (oldKey.empty() || newKey.empty()) {
+            std::cerr << "Error: Key cannot be empty!" << std::endl;
+            return 1;
+        }
+        KdfParams sessionParams;
+        if (!kdfParamsFromEnv(sessionParams)) {
+            std::cerr << "Error: Invalid CRYPTION_KDF (use scrypt[:logN:r:p] or pbkdf2[:iterations])" << std::endl;
+            return 1;
+        }
+        DerivedKeyCache keyCache;
+        std::vector<std::string> files;
+        std::error_code ec;
+        if (fs::is_directory(argv[1], ec)) {
+            TraceSpan span("scan", argv[1]);
+            for (const auto& entry : fs::recursive_directory_iterator(argv[1], ec)) {
+                if (entry.is_regular_file() && isJobFile(entry.path().filename().string())) {
+                    files.push_back(entry.path().string());
+                }
+            }
+        } else if (fs::is_regular_file(argv[1], ec)) {
+            files.push_back(argv[1]);
+        } else {
+            std::cerr << "Error: Path does not exist: " << argv[1] << std::endl;
+            return 1;
+        }
+        int status = runRekey(files, oldKey, newKey, sessionParams, keyCache);
+        std::fill(oldKey.begin(), oldKey.end(), '\0');
+        std::fill(newKey.begin(), newKey.end(), '\0');
+        return status;
+    }
+    bool manifestMode = argc == 3 && std::string(argv[1]) == "--manifest";
+    if (rekey || argc < 3 || argc > 4) {
         std::cerr << "Error: Incorrect number of arguments." << std::endl;
         printUsage(argv[0]);
         return 1;
@@ -65,7 +360,8 @@ int main(int argc, char* argv[]) {
     std::string action = argv[2];
     std::string key;
 
-    // If key is provided, use it. Otherwise, default to "LockBox"
+    // If key is provided, use it. Otherwise files are encrypted with the
+    // key from .env, as before passwords (no header).
     if (argc == 4) {
         key = argv[3];
         if (key.empty()) {
@@ -73,54 +369,166 @@ int main(int argc, char* argv[]) {
             return 1;
         }
         clearKey(argv[3]); // Clear the original key from argv
-    } else {
-        key = "LockBox"; // Default key
     }
 
     // Convert action to lowercase
     std::transform(action.begin(), action.end(), action.begin(), ::tolower);
 
     // Validate action
-    if (!isValidAction(action)) {
+    if (!manifestMode && !isValidAction(action)) {
         std::cerr << "Error: Invalid action '" << argv[2] << "'" << std::endl;
         std::cerr << "Action must be 'encrypt', 'decrypt', 'e', or 'd'" << std::endl;
         return 1;
     }
 
+    KdfParams sessionParams;
+    if (!kdfParamsFromEnv(sessionParams)) {
+        std::cerr << "Error: Invalid CRYPTION_KDF (use scrypt[:logN:r:p] or pbkdf2[:iterations])" << std::endl;
+        return 1;
+    }
+    int compressLevel;
+    if (!compressionFromEnv(compressLevel)) {
+        std::cerr << "Error: Invalid CRYPTION_COMPRESS (use off, zlib or zlib:1-9)" << std::endl;
+        return 1;
+    }
+    DerivedKeyCache keyCache;
+
+    const char* ioMode = backendOption.empty() ? std::getenv("CRYPTION_IO") : backendOption.c_str();
+    bool batchMode = ioMode && *ioMode;
+    BatchBackend backend = BatchBackend::BLOCKING;
+    if (batchMode) {
+        std::string mode = ioMode;
+        if (mode == "uring") {
+            backend = BatchBackend::URING;
+        } else if (mode != "blocking") {
+            std::cerr << "Error: Invalid " << (backendOption.empty() ? "CRYPTION_IO" : "--backend")
+                      << " (use uring or blocking)" << std::endl;
+            return 1;
+        }
+    }
+
+    if (manifestMode) {
+        // Always in this process; CRYPTION_IO only picks the backend.
+        return runManifest(argv[2], batchMode ? backend : BatchBackend::URING, sessionParams, keyCache);
+    }
+
+    const char* priorityMode = std::getenv("CRYPTION_PRIORITY");
+    std::string priorityName = priorityMode ? priorityMode : "";
+    if (!priorityName.empty() && priorityName != "interactive" && priorityName != "background") {
+        std::cerr << "Error: Invalid CRYPTION_PRIORITY (use interactive or background)" << std::endl;
+        return 1;
+    }
+    const char* limitMode = std::getenv("CRYPTION_BACKGROUND_MBPS");
+    double backgroundMbps = 0;
+    if (limitMode && *limitMode) {
+        char* end = nullptr;
+        backgroundMbps = std::strtod(limitMode, &end);
+        if (*end || !(backgroundMbps > 0)) {
+            std::cerr << "Error: Invalid CRYPTION_BACKGROUND_MBPS (use a positive number of MB/s)" << std::endl;
+            return 1;
+        }
+    }
+
     try {
         fs::path fsPath(path);
         Action taskAction = getActionType(action);
         ProcessManagement processManagement;
-        int fileCount = 0;
+        processManagement.setBackgroundLimit((uint64_t)(backgroundMbps * 1024 * 1024));
+        processManagement.setIntake(TaskIntake::defaultDirectory());
+        std::vector<std::string> files;
+        // A directory is bulk work; a single file is what LockFS is waiting on.
+        TaskPriority priority = fs::is_directory(fsPath) ? TaskPriority::BACKGROUND : TaskPriority::INTERACTIVE;
+        if (!priorityName.empty()) {
+            priority = priorityName == "background" ? TaskPriority::BACKGROUND : TaskPriority::INTERACTIVE;
+        }
 
         if (fs::exists(fsPath)) {
             if (fs::is_directory(fsPath)) {
                 std::cout << "Processing directory: " << fsPath << std::endl;
 
+                TraceSpan span("scan", fsPath.string());
                 for (const auto& entry : fs::recursive_directory_iterator(fsPath)) {
                     if (entry.is_regular_file()) {
-                        if (entry.path().filename().string()[0] == '.') {
+                        if (!isJobFile(entry.path().filename().string())) {
                             continue;
                         }
-                        processFile(entry.path().string(), taskAction, processManagement);
-                        fileCount++;
+                        files.push_back(entry.path().string());
                     }
                 }
             } else if (fs::is_regular_file(fsPath)) {
                 std::cout << "Processing file: " << fsPath << std::endl;
-                processFile(fsPath.string(), taskAction, processManagement);
-                fileCount = 1;
+                files.push_back(fsPath.string());
             } else {
                 std::cerr << "Error: Path is neither a regular file nor a directory!" << std::endl;
                 return 1;
             }
 
+            // Files an earlier, interrupted run of this job finished are
+            // skipped without being read.
+            JobJournal journal;
+            std::string journalError;
+            if (!journal.open(JobJournal::pathFor(path), taskAction, journalError)) {
+                std::cerr << "Error: " << journalError << std::endl;
+                return 1;
+            }
+            for (const std::string& failure : journal.finishRenames()) {
+                std::cout << "Failed: " << failure << std::endl;
+            }
+            size_t totalFiles = files.size();
+            files.erase(std::remove_if(files.begin(), files.end(),
+                                       [&](const std::string& file) { return journal.isDone(file); }),
+                        files.end());
+            if (files.size() < totalFiles) {
+                std::cout << "Resuming: " << totalFiles - files.size() << " of " << totalFiles
+                          << " file(s) were already done." << std::endl;
+            }
+
+            int fileCount = (int)files.size();
+            if (fileCount > 0 && batchMode) {
+                int status = runBatch(files, taskAction, backend, key, sessionParams, keyCache, journal);
+                std::fill(key.begin(), key.end(), '\0');
+                return status;
+            }
+            processManagement.setJournal(JobJournal::pathFor(path));
+            for (const std::string& file : files) {
+                processFile(file, taskAction, priority, processManagement, key, sessionParams, keyCache);
+            }
+
             if (fileCount > 0) {
+                std::cout << "Derived " << keyCache.misses() << " key(s) for " << keyCache.misses() + keyCache.hits()
+                          << " protected file(s)." << std::endl;
                 std::cout << "\nExecuting " << fileCount << " task(s)..." << std::endl;
-                processManagement.executeTasks();
-                std::cout << "All tasks completed successfully!" << std::endl;
+                int failedTasks = processManagement.executeTasks();
+                journal.reload();
+                int unfinished = (int)std::count_if(files.begin(), files.end(),
+                                                    [&](const std::string& file) { return !journal.isDone(file); });
+                if (unfinished == 0 && failedTasks == 0) {
+                    journal.remove();
+                    std::cout << "All tasks completed successfully!" << std::endl;
+                } else {
+                    // A journal without finished files has nothing to resume
+                    // and would only block the other action.
+                    if (journal.doneCount() == 0) journal.remove();
+                    int rejected = processManagement.rejectedTasks();
+                    int retryable = std::max(unfinished, failedTasks) - rejected;
+                    if (retryable > 0) {
+                        std::cout << retryable << " file(s) were not finished; run the same command again to retry them."
+                                  << std::endl;
+                    }
+                    if (rejected > 0) {
+                        std::cout << rejected << " file(s) were refused (see above); running the command again will "
+                                  << "not change that." << std::endl;
+                    }
+                }
+                traceWriteReport();
+                if (unfinished > 0 || failedTasks > 0) {
+                    std::fill(key.begin(), key.end(), '\0');
+                    return 1;
+                }
             } else {
-                std::cout << "No files found to process." << std::endl;
+                journal.remove();
+                std::cout << (totalFiles > 0 ? "All files were already done." : "No files found to process.")
+                          << std::endl;
             }
         } else {
             std::cerr << "Error: Path does not exist: " << path << std::endl;
@@ -0,0 +1,97 @@
+#include <openssl/evp.h>
+#include <cstring>
+#include "AES.hpp"
+
+bool aesEncrypt(std::vector<unsigned char>& plaintext, std::vector<unsigned char>& ciphertext, const unsigned char* key, unsigned char* iv) {
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    int len;
+    int ciphertext_len;
+
+    if (!EVP_EncryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, key, iv)) return false;
+
+    ciphertext.resize(plaintext.size() + AES_BLOCK_SIZE);
+    if (!EVP_EncryptUpdate(ctx, ciphertext.data(), &len, plaintext.data(), plaintext.size())) return false;
+
+    ciphertext_len = len;
+
+    if (!EVP_EncryptFinal_ex(ctx, ciphertext.data() + len, &len)) return false;
+    ciphertext_len += len;
+
+    ciphertext.resize(ciphertext_len);
+    EVP_CIPHER_CTX_free(ctx);
+    return true;
+}
+
+bool aesDecrypt(std::vector<unsigned char>& ciphertext, std::vector<unsigned char>& plaintext, const unsigned char* key, unsigned char* iv) {
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    int len;
+    int plaintext_len;
+
+    if (!EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, key, iv)) return false;
+
+    plaintext.resize(ciphertext.size());
+    if (!EVP_DecryptUpdate(ctx, plaintext.data(), &len, ciphertext.data(), ciphertext.size())) return false;
+
+    plaintext_len = len;
+
+    if (!EVP_DecryptFinal_ex(ctx, plaintext.data() + len, &len)) return false;
+    plaintext_len += len;
+
+    plaintext.resize(plaintext_len);
+    EVP_CIPHER_CTX_free(ctx);
+    return true;
+}
+
+bool aesCtrCrypt(const unsigned char* in, unsigned char* out, size_t length, const unsigned char* key, const unsigned char* nonce, uint64_t offset) {
+    // Advance the big-endian 128-bit counter to the block containing `offset`.
+    unsigned char iv[AES_BLOCK_SIZE];
+    memcpy(iv, nonce, AES_BLOCK_SIZE);
+    uint64_t blocks = offset / AES_BLOCK_SIZE;
+    unsigned int carry = 0;
+    for (int i = AES_BLOCK_SIZE - 1; i >= 0; --i) {
+        unsigned int sum = iv[i] + (unsigned int)(blocks & 0xff) + carry;
+        iv[i] = sum & 0xff;
+        carry = sum >> 8;
+        blocks >>= 8;
+    }
+
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    int len;
+    bool ok = EVP_EncryptInit_ex(ctx, EVP_aes_256_ctr(), nullptr, key, iv);
+
+    // Discard the keystream bytes that precede `offset` inside its block.
+    int skip = offset % AES_BLOCK_SIZE;
+    if (ok && skip) {
+        unsigned char zero[AES_BLOCK_SIZE] = {0};
+        unsigned char discard[AES_BLOCK_SIZE];
+        ok = EVP_EncryptUpdate(ctx, discard, &len, zero, skip);
+    }
+    if (ok && length) {
+        ok = EVP_EncryptUpdate(ctx, out, &len, in, (int)length);
+    }
+
+    EVP_CIPHER_CTX_free(ctx);
+    return ok;
+}
+
+bool aesWrapKey(const unsigned char* kek, const unsigned char* key, unsigned char* wrapped) {
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    EVP_CIPHER_CTX_set_flags(ctx, EVP_CIPHER_CTX_FLAG_WRAP_ALLOW);
+    int len;
+    bool ok = EVP_EncryptInit_ex(ctx, EVP_aes_256_wrap(), nullptr, kek, nullptr) &&
+              EVP_EncryptUpdate(ctx, wrapped, &len, key, AES_KEY_LENGTH) &&
+              len == AES_WRAPPED_KEY_LENGTH;
+    EVP_CIPHER_CTX_free(ctx);
+    return ok;
+}
+
+bool aesUnwrapKey(const unsigned char* kek, const unsigned char* wrapped, unsigned char* key) {
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    EVP_CIPHER_CTX_set_flags(ctx, EVP_CIPHER_CTX_FLAG_WRAP_ALLOW);
+    int len;
+    bool ok = EVP_DecryptInit_ex(ctx, EVP_aes_256_wrap(), nullptr, kek, nullptr) &&
+              EVP_DecryptUpdate(ctx, key, &len, wrapped, AES_WRAPPED_KEY_LENGTH) &&
+              len == AES_KEY_LENGTH;
+    EVP_CIPHER_CTX_free(ctx);
+    return ok;
+}
@@ -0,0 +1,25 @@
+#ifndef AES_HPP
+#define AES_HPP
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+const int AES_KEY_LENGTH = 32; // AES-256
+const int AES_BLOCK_SIZE = 16;
+const int AES_WRAPPED_KEY_LENGTH = AES_KEY_LENGTH + 8; // RFC 3394 adds one 8-byte block
+
+// Whole-buffer AES-256-CBC with PKCS#7 padding (used for Cryption file bodies).
+bool aesEncrypt(std::vector<unsigned char>& plaintext, std::vector<unsigned char>& ciphertext, const unsigned char* key, unsigned char* iv);
+bool aesDecrypt(std::vector<unsigned char>& ciphertext, std::vector<unsigned char>& plaintext, const unsigned char* key, unsigned char* iv);
+
+// AES-256-CTR starting at byte `offset` of the keystream for `nonce`.
+// Encryption and decryption are the same operation, and any byte range can
+// be processed on its own, which is what block-level callers need.
+bool aesCtrCrypt(const unsigned char* in, unsigned char* out, size_t length, const unsigned char* key, const unsigned char* nonce, uint64_t offset);
+
+// AES-256 key wrap (RFC 3394) of a 32-byte data key under a key-encryption key.
+bool aesWrapKey(const unsigned char* kek, const unsigned char* key, unsigned char* wrapped);
+bool aesUnwrapKey(const unsigned char* kek, const unsigned char* wrapped, unsigned char* key);
+
+#endif
@@ -0,0 +1,461 @@
+#include "BatchCryption.hpp"
+#include "../fileHandling/Uring.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#ifdef __linux__
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+void recordFailure(BatchResult& result, size_t job, const std::string& path, const std::string& reason,
+                   bool rejected = false) {
+    ++result.failed;
+    if (rejected) ++result.rejected;
+    result.errors.push_back(path + ": " + reason);
+    result.fileErrors[job] = reason;
+}
+
+void cryptFileBlocking(size_t job, const std::string& path, Action action, const KeyResolver& resolveKey,
+                       const unsigned char* envKey, const CommitHook& onCommit, BatchResult& result) {
+    std::error_code ec;
+    if (!fs::is_regular_file(path, ec)) {
+        recordFailure(result, job, path, ec ? ec.message() : "not a regular file");
+        return;
+    }
+    std::vector<unsigned char> contents;
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            recordFailure(result, job, path, "cannot open the file");
+            return;
+        }
+        contents.assign(std::istreambuf_iterator<char>(in), {});
+    }
+    result.bytesIn += contents.size();
+
+    std::string error;
+    std::shared_ptr<const TaskKey> key = resolveKey(contents);
+    if (!transformContents(action, key.get(), envKey, contents, error)) {
+        recordFailure(result, job, path, error, true);
+        return;
+    }
+
+    std::function<bool()> beforeRename;
+    if (onCommit) beforeRename = [&] { return onCommit(job); };
+    if (!replaceFile(path, contents, beforeRename, error)) {
+        recordFailure(result, job, path, error);
+        return;
+    }
+    ++result.files;
+    result.bytesOut += contents.size();
+    result.fileErrors[job].clear();
+}
+
+#ifdef __linux__
+
+// Files in flight at once. Each has at most two requests queued, so a ring
+// of 4 * MAX_IN_FLIGHT entries never fills up and the completion queue
+// (twice the ring) never overflows.
+const unsigned MAX_IN_FLIGHT = 128;
+const unsigned RING_ENTRIES = 4 * MAX_IN_FLIGHT;
+
+enum Op : uint64_t {
+    OP_OPEN_IN,
+    OP_STATX,
+    OP_READ,
+    OP_CLOSE,
+    OP_OPEN_OUT,
+    OP_WRITE,
+    OP_RENAME
+};
+
+enum class Stage {
+    META,          // open + statx of the input
+    READING,
+    CLOSING_IN,
+    CRYPTO,        // with the worker pool
+    OPENING_OUT,   // the temporary file
+    WRITING,
+    CLOSING_OUT,
+    COMMITTING,    // the rename over the original
+    ABORTING       // closing after an error
+};
+
+struct Slot {
+    size_t job = 0;
+    Stage stage = Stage::META;
+    int fd = -1;
+    int pending = 0;          // requests in the ring
+    int errorCode = 0;        // -errno of the first failed request
+    std::string error;        // from the crypto step
+    bool rejected = false;    // the crypto step refused the contents
+    bool tmpCreated = false;
+    size_t done = 0;          // bytes read or written so far
+    std::vector<unsigned char> data;
+    std::string tmp;
+    struct statx meta;
+};
+
+class UringPipeline {
+public:
+    UringPipeline(const std::vector<std::string>& paths, Action action, const KeyResolver& resolveKey,
+                  const unsigned char* envKey, const CommitHook& onCommit, BatchResult& result)
+        : paths(paths), action(action), resolveKey(resolveKey), envKey(envKey), onCommit(onCommit),
+          result(result), slots(MAX_IN_FLIGHT) {}
+
+    bool init() {
+        return ring.init(RING_ENTRIES);
+    }
+
+    void run() {
+        unsigned threads = std::thread::hardware_concurrency();
+        if (threads == 0) threads = 1;
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i < threads; ++i) workers.emplace_back([this] { cryptoWorker(); });
+
+        for (size_t i = slots.size(); i > 0; --i) freeSlots.push_back(i - 1);
+        size_t next = 0;
+        while (finished < paths.size()) {
+            while (next < paths.size() && !freeSlots.empty()) {
+                size_t slot = freeSlots.back();
+                freeSlots.pop_back();
+                startFile(slot, next++);
+            }
+            takeCryptoResults(ioInFlight == 0);
+            if (ioInFlight == 0) continue;
+            if (!ring.submit(1)) {
+                abandon(std::strerror(errno));
+                break;
+            }
+            uint64_t tag;
+            int res;
+            while (ring.reap(tag, res)) complete(tag, res);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        workReady.notify_all();
+        for (std::thread& worker : workers) worker.join();
+    }
+
+private:
+    static uint64_t tagFor(size_t slot, Op op) {
+        return ((uint64_t)slot << 8) | op;
+    }
+
+    void queued(Slot& slot, bool ok) {
+        if (ok) {
+            ++slot.pending;
+            ++ioInFlight;
+        } else if (!slot.errorCode) {
+            slot.errorCode = -EAGAIN;
+        }
+    }
+
+    void fail(Slot& slot, int res) {
+        if (!slot.errorCode) slot.errorCode = res;
+    }
+
+    void startFile(size_t index, size_t job) {
+        Slot& slot = slots[index];
+        slot.job = job;
+        slot.stage = Stage::META;
+        slot.fd = -1;
+        slot.pending = 0;
+        slot.errorCode = 0;
+        slot.error.clear();
+        slot.rejected = false;
+        slot.tmpCreated = false;
+        slot.done = 0;
+        slot.data.clear();
+        const char* path = paths[job].c_str();
+        queued(slot, ring.queueOpen(path, O_RDONLY, 0, tagFor(index, OP_OPEN_IN)));
+        queued(slot, ring.queueStatx(path, &slot.meta, tagFor(index, OP_STATX)));
+        if (slot.pending == 0) advance(index);
+    }
+
+    void complete(uint64_t tag, int res) {
+        size_t index = tag >> 8;
+        Slot& slot = slots[index];
+        --slot.pending;
+        --ioInFlight;
+        switch ((Op)(tag & 0xff)) {
+        case OP_OPEN_IN:
+        case OP_OPEN_OUT:
+            if (res >= 0) {
+                slot.fd = res;
+                slot.tmpCreated = slot.tmpCreated || (tag & 0xff) == OP_OPEN_OUT;
+            } else {
+                fail(slot, res);
+            }
+            break;
+        case OP_READ:
+            if (res < 0) fail(slot, res);
+            else if (res == 0) slot.data.resize(slot.done);   // the file shrank since statx
+            else slot.done += res;
+            break;
+        case OP_WRITE:
+            if (res <= 0) fail(slot, res < 0 ? res : -EIO);
+            else slot.done += res;
+            break;
+        case OP_CLOSE:
+            if (res < 0) fail(slot, res);
+            break;
+        case OP_RENAME:
+            if (res < 0) fail(slot, res);
+            else slot.tmpCreated = false;
+            break;
+        case OP_STATX:
+            if (res < 0) fail(slot, res);
+            break;
+        }
+        if (slot.pending == 0) advance(index);
+    }
+
+    // Queues the next step for a file whose requests have all completed.
+    void advance(size_t index) {
+        Slot& slot = slots[index];
+        if (slot.errorCode || !slot.error.empty()) {
+            if (slot.fd >= 0) {
+                slot.stage = Stage::ABORTING;
+                int fd = slot.fd;
+                slot.fd = -1;
+                queued(slot, ring.queueClose(fd, tagFor(index, OP_CLOSE)));
+                if (slot.pending) return;
+            }
+            if (slot.tmpCreated) unlink(slot.tmp.c_str());
+            finish(index, false);
+            return;
+        }
+
+        switch (slot.stage) {
+        case Stage::META:
+            if (!S_ISREG(slot.meta.stx_mode)) {
+                slot.error = "not a regular file";
+                advance(index);
+                return;
+            }
+            slot.data.resize(slot.meta.stx_size);
+            slot.stage = Stage::READING;
+            readMore(index);
+            break;
+        case Stage::READING:
+            readMore(index);
+            break;
+        case Stage::CLOSING_IN:
+            slot.stage = Stage::CRYPTO;
+            result.bytesIn += slot.data.size();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                cryptoQueue.push_back(index);
+            }
+            ++inCrypto;
+            workReady.notify_one();
+            return;
+        case Stage::OPENING_OUT:
+            slot.stage = Stage::WRITING;
+            slot.done = 0;
+            writeMore(index);
+            break;
+        case Stage::WRITING:
+            writeMore(index);
+            break;
+        case Stage::CLOSING_OUT:
+            // Once the hook has recorded the file, its temporary result
+            // belongs to the journal and is kept even if the rename fails.
+            if (onCommit) {
+                if (!onCommit(slot.job)) {
+                    slot.error = "cannot update the job journal";
+                    advance(index);
+                    return;
+                }
+                slot.tmpCreated = false;
+            }
+            slot.stage = Stage::COMMITTING;
+            queued(slot, ring.queueRename(slot.tmp.c_str(), paths[slot.job].c_str(), tagFor(index, OP_RENAME)));
+            break;
+        case Stage::COMMITTING:
+            finish(index, true);
+            return;
+        case Stage::CRYPTO:
+        case Stage::ABORTING:
+            break;
+        }
+        if (slot.pending == 0 && slot.errorCode) advance(index);
+    }
+
+    void readMore(size_t index) {
+        Slot& slot = slots[index];
+        if (slot.done < slot.data.size()) {
+            size_t length = std::min<size_t>(slot.data.size() - slot.done, 1u << 30);
+            queued(slot, ring.queueRead(slot.fd, slot.data.data() + slot.done, (unsigned)length, slot.done,
+                                        tagFor(index, OP_READ)));
+        } else {
+            slot.stage = Stage::CLOSING_IN;
+            int fd = slot.fd;
+            slot.fd = -1;
+            queued(slot, ring.queueClose(fd, tagFor(index, OP_CLOSE)));
+        }
+    }
+
+    void writeMore(size_t index) {
+        Slot& slot = slots[index];
+        if (slot.done < slot.data.size()) {
+            size_t length = std::min<size_t>(slot.data.size() - slot.done, 1u << 30);
+            queued(slot, ring.queueWrite(slot.fd, slot.data.data() + slot.done, (unsigned)length, slot.done,
+                                         tagFor(index, OP_WRITE)));
+        } else {
+            slot.stage = Stage::CLOSING_OUT;
+            int fd = slot.fd;
+            slot.fd = -1;
+            queued(slot, ring.queueClose(fd, tagFor(index, OP_CLOSE)));
+        }
+    }
+
+    void afterCrypto(size_t index) {
+        Slot& slot = slots[index];
+        --inCrypto;
+        if (!slot.error.empty()) {
+            advance(index);
+            return;
+        }
+        slot.stage = Stage::OPENING_OUT;
+        slot.tmp = paths[slot.job] + CRYPTION_TMP_SUFFIX;
+        queued(slot, ring.queueOpen(slot.tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, slot.meta.stx_mode & 07777,
+                                    tagFor(index, OP_OPEN_OUT)));
+        if (slot.pending == 0) advance(index);
+    }
+
+    void finish(size_t index, bool ok) {
+        Slot& slot = slots[index];
+        if (ok) {
+            ++result.files;
+            result.bytesOut += slot.data.size();
+            result.fileErrors[slot.job].clear();
+        } else {
+            recordFailure(result, slot.job, paths[slot.job],
+                          slot.error.empty() ? std::strerror(-slot.errorCode) : slot.error, slot.rejected);
+        }
+        freeSlots.push_back(index);
+        ++finished;
+    }
+
+    // With `wait`, blocks until at least one file comes back from the pool.
+    void takeCryptoResults(bool wait) {
+        std::deque<size_t> ready;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (wait && inCrypto > 0) cryptoDone.wait(lock, [this] { return !doneQueue.empty(); });
+            ready.swap(doneQueue);
+        }
+        for (size_t index : ready) afterCrypto(index);
+    }
+
+    void cryptoWorker() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            workReady.wait(lock, [this] { return stopping || !cryptoQueue.empty(); });
+            if (cryptoQueue.empty()) return;
+            size_t index = cryptoQueue.front();
+            cryptoQueue.pop_front();
+            lock.unlock();
+
+            Slot& slot = slots[index];
+            std::shared_ptr<const TaskKey> key = resolveKey(slot.data);
+            if (!transformContents(action, key.get(), envKey, slot.data, slot.error)) {
+                if (slot.error.empty()) slot.error = "Cryption failed.";
+                slot.rejected = true;
+            }
+
+            lock.lock();
+            doneQueue.push_back(index);
+            cryptoDone.notify_one();
+        }
+    }
+
+    // The ring itself failed: every file not yet finished is reported failed.
+    void abandon(const std::string& reason) {
+        size_t remaining = paths.size() - finished;
+        result.failed += remaining;
+        result.errors.push_back("io_uring: " + reason + " (" + std::to_string(remaining) + " file(s) not processed)");
+        finished = paths.size();
+    }
+
+    const std::vector<std::string>& paths;
+    Action action;
+    const KeyResolver& resolveKey;
+    const unsigned char* envKey;
+    const CommitHook& onCommit;
+    BatchResult& result;
+
+    std::vector<Slot> slots;   // declared before the ring, so the ring closes first
+    Uring ring;
+    std::vector<size_t> freeSlots;
+    size_t finished = 0;
+    size_t ioInFlight = 0;
+    size_t inCrypto = 0;
+
+    std::mutex mutex;
+    std::condition_variable workReady;
+    std::condition_variable cryptoDone;
+    std::deque<size_t> cryptoQueue;
+    std::deque<size_t> doneQueue;
+    bool stopping = false;
+};
+
+#endif
+
+}
+
+bool uringAvailable() {
+    Uring ring;
+    return ring.init(8);
+}
+
+const char* batchBackendName(BatchBackend backend) {
+    return backend == BatchBackend::URING ? "io_uring" : "blocking";
+}
+
+BatchResult cryptFilesBatched(const std::vector<std::string>& paths, Action action,
+                              const KeyResolver& resolveKey, const unsigned char* envKey,
+                              BatchBackend backend, const CommitHook& onCommit) {
+    BatchResult result;
+    result.fileErrors.assign(paths.size(), "not processed");
+    auto start = std::chrono::steady_clock::now();
+    bool ran = false;
+#ifdef __linux__
+    if (backend == BatchBackend::URING) {
+        UringPipeline pipeline(paths, action, resolveKey, envKey, onCommit, result);
+        if (pipeline.init()) {
+            result.backend = BatchBackend::URING;
+            pipeline.run();
+            ran = true;
+        }
+    }
+#endif
+    if (!ran) {
+        result.backend = BatchBackend::BLOCKING;
+        for (size_t i = 0; i < paths.size(); ++i) {
+            cryptFileBlocking(i, paths[i], action, resolveKey, envKey, onCommit, result);
+        }
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
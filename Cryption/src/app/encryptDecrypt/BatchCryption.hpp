@@ -0,0 +1,58 @@
+#ifndef BATCH_CRYPTION_HPP
+#define BATCH_CRYPTION_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+#include "Cryption.hpp"
+
+// In-process alternative to one worker process per file, for jobs with many
+// small files. BLOCKING reads, transforms and writes one file at a time;
+// URING keeps up to a few hundred files in flight on one io_uring (open,
+// statx, read, close, then open/write/close/rename of the result) and hands
+// each file's contents to a pool of crypto threads as its reads complete.
+// Either way the result is written to "<file>.cryption.tmp" and renamed over
+// the original (see replaceFile), so an interrupted job never leaves a
+// half-written file.
+enum class BatchBackend {
+    BLOCKING,
+    URING
+};
+
+// Picks the key for a file given its contents: for encryption the session
+// key, for decryption the one matching the file's KDF header, or null for
+// the legacy .env key. Called from several threads at once.
+using KeyResolver = std::function<std::shared_ptr<const TaskKey>(const std::vector<unsigned char>& contents)>;
+
+// Called with the index in `paths` of a file whose result is complete in its
+// temporary file, right before the rename; returning false fails the file
+// and leaves the original alone. Used to record progress in a job journal.
+using CommitHook = std::function<bool(size_t index)>;
+
+struct BatchResult {
+    size_t files = 0;
+    size_t failed = 0;
+    size_t rejected = 0;   // of `failed`: refused by transformContents (e.g. a wrong password), which a retry would not change
+    uint64_t bytesIn = 0;
+    uint64_t bytesOut = 0;
+    double seconds = 0;
+    BatchBackend backend = BatchBackend::BLOCKING;
+    std::vector<std::string> errors;   // "<path>: <reason>" for each failed file
+    std::vector<std::string> fileErrors;   // per entry of `paths`: empty if done, else why not
+};
+
+// True if io_uring can be set up here and supports every operation used.
+bool uringAvailable();
+const char* batchBackendName(BatchBackend backend);
+
+// Encrypts or decrypts every file in `paths` in place. URING falls back to
+// BLOCKING when io_uring is unavailable; the result says which one ran.
+// `envKey` may be null if no file needs the legacy key.
+BatchResult cryptFilesBatched(const std::vector<std::string>& paths, Action action,
+                              const KeyResolver& resolveKey, const unsigned char* envKey,
+                              BatchBackend backend, const CommitHook& onCommit = nullptr);
+
+#endif
@@ -0,0 +1,109 @@
+#include "Compression.hpp"
+#include <openssl/crypto.h>
+#include <zlib.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+const size_t FRAME_HEADER = 8;
+const size_t PROBE_LENGTH = 16 << 10;
+
+// A body is only stored compressed if it shrinks by at least one eighth;
+// below that the saving does not pay for the decompression on every open.
+bool worthIt(size_t stored, size_t raw) {
+    return stored <= raw - raw / 8;
+}
+
+void putLength(unsigned char* out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) out[i] = (value >> (8 * i)) & 0xff;
+}
+
+uint32_t getLength(const unsigned char* in) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) value |= (uint32_t)in[i] << (8 * i);
+    return value;
+}
+
+// Appends one frame for `length` bytes at `data`.
+bool appendChunk(const unsigned char* data, size_t length, int level, std::vector<unsigned char>& framed) {
+    size_t start = framed.size();
+    uLongf stored = compressBound(length);
+    framed.resize(start + FRAME_HEADER + stored);
+    if (compress2(framed.data() + start + FRAME_HEADER, &stored, data, length, level) != Z_OK) return false;
+    if (stored >= length) {
+        std::copy(data, data + length, framed.begin() + start + FRAME_HEADER);
+        stored = length;
+    }
+    putLength(framed.data() + start, (uint32_t)length);
+    putLength(framed.data() + start + 4, (uint32_t)stored);
+    framed.resize(start + FRAME_HEADER + stored);
+    return true;
+}
+
+}
+
+bool compressionFromEnv(int& level) {
+    level = 0;
+    const char* spec = std::getenv("CRYPTION_COMPRESS");
+    std::string value = spec ? spec : "";
+    if (value.empty() || value == "off") return true;
+    if (value == "zlib") {
+        level = 1;
+        return true;
+    }
+    if (value.size() == 6 && value.compare(0, 5, "zlib:") == 0 && value[5] >= '1' && value[5] <= '9') {
+        level = value[5] - '0';
+        return true;
+    }
+    return false;
+}
+
+bool compressBody(const std::vector<unsigned char>& plain, int level, std::vector<unsigned char>& framed) {
+    framed.clear();
+    if (plain.empty()) return false;
+    // Already compressed or encrypted data (images, archives) is given up on
+    // after a fast pass over its first few KB.
+    size_t probe = std::min(PROBE_LENGTH, plain.size());
+    bool ok = appendChunk(plain.data(), probe, 1, framed) && worthIt(framed.size(), probe);
+    OPENSSL_cleanse(framed.data(), framed.size());
+    framed.clear();
+    framed.reserve(plain.size());
+    for (size_t offset = 0; ok && offset < plain.size(); offset += COMPRESSION_CHUNK) {
+        size_t length = std::min(COMPRESSION_CHUNK, plain.size() - offset);
+        ok = appendChunk(plain.data() + offset, length, level, framed);
+    }
+    if (ok && worthIt(framed.size(), plain.size())) return true;
+    OPENSSL_cleanse(framed.data(), framed.size());
+    framed.clear();
+    return false;
+}
+
+bool decompressBody(const std::vector<unsigned char>& framed, std::vector<unsigned char>& plain) {
+    plain.clear();
+    size_t offset = 0;
+    while (offset < framed.size()) {
+        if (framed.size() - offset < FRAME_HEADER) return false;
+        uLongf length = getLength(framed.data() + offset);
+        size_t stored = getLength(framed.data() + offset + 4);
+        offset += FRAME_HEADER;
+        if (length == 0 || length > COMPRESSION_CHUNK || stored > length || framed.size() - offset < stored) {
+            return false;
+        }
+        size_t start = plain.size();
+        plain.resize(start + length);
+        if (stored == length) {
+            std::copy(framed.begin() + offset, framed.begin() + offset + stored, plain.begin() + start);
+        } else {
+            uLongf written = length;
+            if (uncompress(plain.data() + start, &written, framed.data() + offset, stored) != Z_OK ||
+                written != length) {
+                return false;
+            }
+        }
+        offset += stored;
+    }
+    return true;
+}
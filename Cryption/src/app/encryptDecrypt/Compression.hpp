@@ -0,0 +1,27 @@
+#ifndef COMPRESSION_HPP
+#define COMPRESSION_HPP
+
+#include <vector>
+#include <cstddef>
+
+// Optional zlib stage in front of encryption. The body is cut into chunks of
+// COMPRESSION_CHUNK bytes, each compressed on its own and framed as
+//   raw length (4, little endian) | stored length (4, little endian) | data
+// where a chunk whose stored length equals its raw length was kept as is.
+// Whether a file went through this stage is recorded in its KDF header (see
+// KeyDerivation.hpp), so files without a header are never compressed.
+const size_t COMPRESSION_CHUNK = 1 << 20;
+
+// Level from CRYPTION_COMPRESS ("zlib[:level]", level 1-9, default 1; unset
+// or "off" is 0, no compression). False if the variable is malformed.
+bool compressionFromEnv(int& level);
+
+// Compresses `plain` into `framed` at `level`. False (and `framed` left
+// empty) if the data does not compress well enough to be worth it. The
+// first 16 KB are tried before the rest, so incompressible files cost little.
+bool compressBody(const std::vector<unsigned char>& plain, int level, std::vector<unsigned char>& framed);
+
+// Reverses compressBody. False if the framing or a chunk is corrupt.
+bool decompressBody(const std::vector<unsigned char>& framed, std::vector<unsigned char>& plain);
+
+#endif
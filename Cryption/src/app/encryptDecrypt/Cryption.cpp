@@ -1,97 +1,206 @@
-#include <openssl/evp.h>
 #include <openssl/rand.h>
+#include <openssl/crypto.h>
+#include <filesystem>
 #include <fstream>
 #include <vector>
 #include <cstring>
+#include "Cryption.hpp"
 #include "../processes/Task.hpp"
+#include "AES.hpp"
+#include "KeyDerivation.hpp"
+#include "Compression.hpp"
 #include "../fileHandling/ReadEnv.cpp"
+#include "../tracing/Trace.hpp"
 
-const int AES_KEY_LENGTH = 32; // AES-256
-const int AES_BLOCK_SIZE = 16;
-
-bool aesEncrypt(std::vector<unsigned char>& plaintext, std::vector<unsigned char>& ciphertext, const unsigned char* key, unsigned char* iv) {
-    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-    int len;
-    int ciphertext_len;
-
-    if (!EVP_EncryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, key, iv)) return false;
-
-    ciphertext.resize(plaintext.size() + AES_BLOCK_SIZE);
-    if (!EVP_EncryptUpdate(ctx, ciphertext.data(), &len, plaintext.data(), plaintext.size())) return false;
-
-    ciphertext_len = len;
-
-    if (!EVP_EncryptFinal_ex(ctx, ciphertext.data() + len, &len)) return false;
-    ciphertext_len += len;
-
-    ciphertext.resize(ciphertext_len);
-    EVP_CIPHER_CTX_free(ctx);
-    return true;
-}
-
-bool aesDecrypt(std::vector<unsigned char>& ciphertext, std::vector<unsigned char>& plaintext, const unsigned char* key, unsigned char* iv) {
-    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-    int len;
-    int plaintext_len;
-
-    if (!EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, key, iv)) return false;
-
-    plaintext.resize(ciphertext.size());
-    if (!EVP_DecryptUpdate(ctx, plaintext.data(), &len, ciphertext.data(), ciphertext.size())) return false;
-
-    plaintext_len = len;
-
-    if (!EVP_DecryptFinal_ex(ctx, plaintext.data() + len, &len)) return false;
-    plaintext_len += len;
-
-    plaintext.resize(plaintext_len);
-    EVP_CIPHER_CTX_free(ctx);
-    return true;
-}
-
-int executeCryption(const std::string& taskData) {
-    Task task = Task::fromString(taskData);
+bool loadEnvKey(unsigned char* key) {
     ReadEnv env;
     std::string envKey = env.getenv();
-
     if (envKey.size() < AES_KEY_LENGTH) {
         std::cerr << "Key must be at least 32 bytes for AES-256.\n";
-        return 1;
+        return false;
+    }
+    memcpy(key, envKey.c_str(), AES_KEY_LENGTH);
+    OPENSSL_cleanse(&envKey[0], envKey.size());
+    return true;
+}
+
+bool transformContents(Action action, const TaskKey* taskKey, const unsigned char* envKey,
+                       std::vector<unsigned char>& contents, std::string& error) {
+    // A KDF header on the input means the file was encrypted with a
+    // password; it has to be the one the task key was derived for.
+    KdfParams fileParams;
+    bool hasHeader = action == Action::DECRYPT && contents.size() >= (size_t)KDF_HEADER_LENGTH &&
+                     decodeKdfHeader(contents.data(), fileParams);
+    if (taskKey && action == Action::DECRYPT &&
+        (!hasHeader || !sameKdfHeader(contents.data(), taskKey->header))) {
+        error = "Key does not match the file header.";
+        return false;
+    }
+    if (!taskKey && hasHeader) {
+        error = "File is password protected; no key was given.";
+        return false;
+    }
+    const unsigned char* key = taskKey ? taskKey->key : envKey;
+    if (!key) {
+        error = "No key was given and the legacy key from .env is unavailable.";
+        return false;
     }
 
-    std::ifstream inputFile(task.filePath, std::ios::binary);
-    std::vector<unsigned char> buffer((std::istreambuf_iterator<char>(inputFile)), {});
-    inputFile.close();
+    // With an envelope the body is under the file's own data key, which the
+    // derived key only wraps.
+    KdfParams keyParams;
+    bool envelope = taskKey && decodeKdfHeader(taskKey->header, keyParams) && keyParams.envelope;
+    unsigned char dataKey[AES_KEY_LENGTH];
+    unsigned char wrappedKey[AES_WRAPPED_KEY_LENGTH];
+    if (envelope && action == Action::ENCRYPT) {
+        if (RAND_bytes(dataKey, AES_KEY_LENGTH) != 1 || !aesWrapKey(taskKey->key, dataKey, wrappedKey)) {
+            OPENSSL_cleanse(dataKey, AES_KEY_LENGTH);
+            error = "Could not create the file's data key.";
+            return false;
+        }
+        key = dataKey;
+    }
+    if (envelope && action == Action::DECRYPT) {
+        if (contents.size() < (size_t)FILE_HEADER_LENGTH ||
+            !aesUnwrapKey(taskKey->key, contents.data() + KDF_HEADER_LENGTH, dataKey)) {
+            error = "Wrong password for this file.";
+            return false;
+        }
+        key = dataKey;
+    }
 
     std::vector<unsigned char> result;
-    unsigned char key[AES_KEY_LENGTH];
-    memcpy(key, envKey.c_str(), AES_KEY_LENGTH);
     unsigned char iv[AES_BLOCK_SIZE];
-
-    if (task.action == Action::ENCRYPT) {
+    if (action == Action::ENCRYPT) {
+        // Only files with a header can say they were compressed.
+        int level = 0;
+        std::vector<unsigned char> framed;
+        bool compressed = taskKey && compressionFromEnv(level) && level > 0 &&
+                          compressBody(contents, level, framed);
         RAND_bytes(iv, AES_BLOCK_SIZE);  // Generate random IV
-        if (!aesEncrypt(buffer, result, key, iv)) {
-            std::cerr << "Encryption failed.\n";
-            return 1;
+        bool ok = aesEncrypt(compressed ? framed : contents, result, key, iv);
+        OPENSSL_cleanse(dataKey, AES_KEY_LENGTH);
+        OPENSSL_cleanse(framed.data(), framed.size());
+        if (!ok) {
+            error = "Encryption failed.";
+            return false;
+        }
+        // Header and wrapped data key (password-protected files only), then
+        // the IV, then the ciphertext.
+        size_t headerLength = taskKey ? (envelope ? FILE_HEADER_LENGTH : KDF_HEADER_LENGTH) : 0;
+        contents.resize(headerLength + AES_BLOCK_SIZE + result.size());
+        if (taskKey) {
+            memcpy(contents.data(), taskKey->header, KDF_HEADER_LENGTH);
+            setKdfHeaderCompressed(contents.data(), compressed);
         }
+        if (envelope) memcpy(contents.data() + KDF_HEADER_LENGTH, wrappedKey, AES_WRAPPED_KEY_LENGTH);
+        memcpy(contents.data() + headerLength, iv, AES_BLOCK_SIZE);
+        memcpy(contents.data() + headerLength + AES_BLOCK_SIZE, result.data(), result.size());
+        return true;
+    }
 
-        std::ofstream outputFile(task.filePath, std::ios::binary);
-        outputFile.write(reinterpret_cast<char*>(iv), AES_BLOCK_SIZE); // Save IV at beginning
-        outputFile.write(reinterpret_cast<char*>(result.data()), result.size());
-        outputFile.close();
-    } else {
-        memcpy(iv, buffer.data(), AES_BLOCK_SIZE); // Extract IV
-        buffer.erase(buffer.begin(), buffer.begin() + AES_BLOCK_SIZE);
+    size_t skip = hasHeader ? (fileParams.envelope ? FILE_HEADER_LENGTH : KDF_HEADER_LENGTH) : 0;
+    if (contents.size() < skip + AES_BLOCK_SIZE) {
+        OPENSSL_cleanse(dataKey, AES_KEY_LENGTH);
+        error = "File is too short to be encrypted.";
+        return false;
+    }
+    bool compressed = hasHeader && kdfHeaderCompressed(contents.data());
+    memcpy(iv, contents.data() + skip, AES_BLOCK_SIZE); // Extract IV
+    contents.erase(contents.begin(), contents.begin() + skip + AES_BLOCK_SIZE);
+    bool ok = aesDecrypt(contents, result, key, iv);
+    OPENSSL_cleanse(dataKey, AES_KEY_LENGTH);
+    if (!ok) {
+        error = "Decryption failed.";
+        return false;
+    }
+    if (compressed) {
+        ok = decompressBody(result, contents);
+        OPENSSL_cleanse(result.data(), result.size());
+        if (!ok) {
+            OPENSSL_cleanse(contents.data(), contents.size());
+            error = "Compressed contents are corrupt.";
+            return false;
+        }
+        return true;
+    }
+    contents.swap(result);
+    OPENSSL_cleanse(result.data(), result.size());
+    return true;
+}
 
-        if (!aesDecrypt(buffer, result, key, iv)) {
-            std::cerr << "Decryption failed.\n";
-            return 1;
+bool replaceFile(const std::string& path, const std::vector<unsigned char>& contents,
+                 const std::function<bool()>& beforeRename, std::string& error) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    std::string tmp = path + CRYPTION_TMP_SUFFIX;
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(contents.data()), contents.size());
+        out.close();
+        if (!out) {
+            fs::remove(tmp, ec);
+            error = "cannot write " + tmp;
+            return false;
         }
+    }
+    fs::permissions(tmp, fs::status(path, ec).permissions(), ec);
+    if (beforeRename && !beforeRename()) {
+        fs::remove(tmp, ec);
+        error = "cannot update the job journal";
+        return false;
+    }
+    fs::rename(tmp, path, ec);
+    if (ec) {
+        error = ec.message();
+        if (!beforeRename) fs::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
 
-        std::ofstream outputFile(task.filePath, std::ios::binary);
-        outputFile.write(reinterpret_cast<char*>(result.data()), result.size());
-        outputFile.close();
+int executeCryption(const std::string& taskData, const TaskKey* taskKey,
+                    const std::function<bool()>& beforeRename) {
+    Task task = [&] {
+        TraceSpan span("open", taskData);
+        return Task::fromString(taskData);
+    }();
+    const std::string& path = task.filePath;
+
+    std::vector<unsigned char> buffer;
+    {
+        TraceSpan span("read", path);
+        std::ifstream inputFile(path, std::ios::binary);
+        buffer.assign(std::istreambuf_iterator<char>(inputFile), {});
+        inputFile.close();
+        span.setBytes(buffer.size());
     }
 
+    unsigned char envKey[AES_KEY_LENGTH];
+    {
+        TraceSpan span("key", path);
+        if (!taskKey && !loadEnvKey(envKey)) return 1;
+    }
+
+    {
+        TraceSpan span("cipher", path);
+        span.setBytes(buffer.size());
+        std::string error;
+        bool ok = transformContents(task.action, taskKey, envKey, buffer, error);
+        OPENSSL_cleanse(envKey, AES_KEY_LENGTH);
+        if (!ok) {
+            std::cerr << error << "\n";
+            return CRYPTION_EXIT_REJECTED;
+        }
+    }
+
+    TraceSpan span("write", path);
+    span.setBytes(buffer.size());
+    task.f_stream.close();  // Windows cannot rename over an open file
+    std::string error;
+    if (!replaceFile(path, buffer, beforeRename, error)) {
+        std::cerr << path << ": " << error << "\n";
+        return 1;
+    }
     return 0;
 }
@@ -2,7 +2,43 @@
 #define CRYPTION_HPP
 
 #include<string>
+#include <vector>
+#include <functional>
+#include "KeyDerivation.hpp"
+#include "../processes/Task.hpp"
 
-int executeCryption(const std::string &taskData);
+// Reads the legacy key (first 32 bytes of .env).
+bool loadEnvKey(unsigned char* key);
+
+// Replaces file contents with their encrypted form (KDF header and wrapped
+// data key if there is a task key, IV, ciphertext) or their decrypted form. Without a task key the
+// legacy `envKey` is used. With a task key and CRYPTION_COMPRESS set, the
+// data is compressed first when that pays off (see Compression.hpp). On
+// failure `error` says why.
+bool transformContents(Action action, const TaskKey* taskKey, const unsigned char* envKey,
+                       std::vector<unsigned char>& contents, std::string& error);
+
+// Results are written next to the file under this suffix and renamed over
+// it, so an interrupted job never leaves a half-written file.
+const char CRYPTION_TMP_SUFFIX[] = ".cryption.tmp";
+
+// Writes `contents` to "<path>.cryption.tmp" and renames it over `path`,
+// keeping the file's permissions. `beforeRename` (if set) runs once the
+// temporary file is complete; if it returns false nothing is replaced. After
+// it returned true the temporary file is kept even if the rename fails, so
+// a resumed job (see Journal.hpp) can finish it.
+bool replaceFile(const std::string& path, const std::vector<unsigned char>& contents,
+                 const std::function<bool()>& beforeRename, std::string& error);
+
+// Exit status of a worker whose file transformContents refused (e.g. a
+// wrong password); running the task again would fail the same way.
+const int CRYPTION_EXIT_REJECTED = 2;
+
+// Encrypts or decrypts the file named in `taskData` in place. With a task
+// key the file carries that key's KDF header; without one the legacy key
+// from .env is used. `beforeRename` is passed on to replaceFile. Returns 0,
+// CRYPTION_EXIT_REJECTED, or 1 for any other failure.
+int executeCryption(const std::string &taskData, const TaskKey* taskKey = nullptr,
+                    const std::function<bool()>& beforeRename = nullptr);
 
 #endif 
\ No newline at end of file
@@ -1,12 +1,53 @@
 #include<iostream>
+#include <cstdio>
+#include <cstring>
+#include <memory>
 #include "Cryption.hpp"
+#include "../tracing/Trace.hpp"
+#include "../fileHandling/Journal.hpp"
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+// With --key-stdin the parent writes a TaskKey (KDF header, then the derived
+// key) to this process's standard input.
+static bool readTaskKey(TaskKey& taskKey) {
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    return fread(taskKey.header, 1, KDF_HEADER_LENGTH, stdin) == (size_t)KDF_HEADER_LENGTH &&
+           fread(taskKey.key, 1, AES_KEY_LENGTH, stdin) == (size_t)AES_KEY_LENGTH;
+}
 
 int main(int argc, char* argv[]) {
-    if(argc !=2) {
-    std::cerr << "Usage: ./cryption <task_data>" << std::endl;
+    bool keyOnStdin = false;
+    const char* journalPath = nullptr;
+    bool usageOk = argc >= 2;
+    for (int i = 2; i < argc && usageOk; ++i) {
+        if (strcmp(argv[i], "--key-stdin") == 0) keyOnStdin = true;
+        else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc) journalPath = argv[++i];
+        else usageOk = false;
+    }
+    if(!usageOk) {
+    std::cerr << "Usage: ./cryption <task_data> [--key-stdin] [--journal <file>]" << std::endl;
     return 1;
     }
-    executeCryption(argv[1]);
-    return 0;
+    std::unique_ptr<TaskKey> taskKey;
+    if (keyOnStdin) {
+        taskKey.reset(new TaskKey());
+        if (!readTaskKey(*taskKey)) {
+            std::cerr << "Could not read the key from standard input." << std::endl;
+            return 1;
+        }
+    }
+    // With --journal the file is recorded there before its result replaces it.
+    std::function<bool()> beforeRename;
+    if (journalPath) {
+        std::string filePath = std::string(argv[1]).substr(0, std::string(argv[1]).rfind(','));
+        beforeRename = [&] { return JobJournal::appendDone(journalPath, filePath); };
+    }
+    int status = executeCryption(argv[1], taskKey.get(), beforeRename);
+    traceFlushWorker();
+    return status;
 }
-
@@ -0,0 +1,193 @@
+#include "KeyDerivation.hpp"
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/crypto.h>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+const char KDF_MAGIC[4] = {'L', 'K', 'D', 'F'};
+const unsigned char FLAG_ENVELOPE = 1;
+const unsigned char FLAG_COMPRESSED = 2;
+const int FLAGS_OFFSET = 28;
+const uint64_t KDF_MAX_MEMORY = 256ull << 20;  // scrypt memory accepted from a header
+
+uint64_t scryptMemory(const KdfParams& params) {
+    // What OpenSSL allocates: 128 * r * (N + 2 + p) bytes.
+    return 128ull * params.r * ((1ull << params.logN) + 2 + params.p);
+}
+
+bool validParams(const KdfParams& params) {
+    if (params.type == KdfType::PBKDF2_SHA256) {
+        return params.iterations >= 1000 && params.iterations <= 10000000;
+    }
+    if (params.type == KdfType::SCRYPT) {
+        return params.logN >= 10 && params.logN <= 22 && params.r >= 1 && params.r <= 32 &&
+               params.p >= 1 && params.p <= 16 && scryptMemory(params) <= KDF_MAX_MEMORY;
+    }
+    return false;
+}
+
+// Splits "name:a:b" at the colons.
+std::vector<std::string> splitSpec(const std::string& spec) {
+    std::vector<std::string> parts;
+    std::stringstream ss(spec);
+    std::string part;
+    while (std::getline(ss, part, ':')) parts.push_back(part);
+    return parts;
+}
+
+bool parseNumber(const std::string& text, unsigned long& value) {
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos || text.size() > 9) return false;
+    value = std::stoul(text);
+    return true;
+}
+
+}
+
+bool kdfParamsFromEnv(KdfParams& params) {
+    params = KdfParams();
+    const char* spec = std::getenv("CRYPTION_KDF");
+    if (spec && *spec) {
+        std::vector<std::string> parts = splitSpec(spec);
+        unsigned long a, b, c;
+        if (parts[0] == "pbkdf2" && parts.size() <= 2) {
+            params.type = KdfType::PBKDF2_SHA256;
+            if (parts.size() == 2) {
+                if (!parseNumber(parts[1], a)) return false;
+                params.iterations = (uint32_t)a;
+            }
+        } else if (parts[0] == "scrypt" && (parts.size() == 1 || parts.size() == 4)) {
+            params.type = KdfType::SCRYPT;
+            if (parts.size() == 4) {
+                if (!parseNumber(parts[1], a) || !parseNumber(parts[2], b) || !parseNumber(parts[3], c) ||
+                    a > 255 || b > 255 || c > 255) {
+                    return false;
+                }
+                params.logN = (uint8_t)a;
+                params.r = (uint8_t)b;
+                params.p = (uint8_t)c;
+            }
+        } else {
+            return false;
+        }
+    }
+    return validParams(params) && RAND_bytes(params.salt, KDF_SALT_LENGTH) == 1;
+}
+
+void encodeKdfHeader(const KdfParams& params, unsigned char* header) {
+    memset(header, 0, KDF_HEADER_LENGTH);
+    memcpy(header, KDF_MAGIC, sizeof(KDF_MAGIC));
+    header[4] = (unsigned char)params.type;
+    header[5] = params.logN;
+    header[6] = params.r;
+    header[7] = params.p;
+    for (int i = 0; i < 4; ++i) header[8 + i] = (params.iterations >> (8 * i)) & 0xff;
+    memcpy(header + 12, params.salt, KDF_SALT_LENGTH);
+    header[FLAGS_OFFSET] = params.envelope ? FLAG_ENVELOPE : 0;
+}
+
+bool decodeKdfHeader(const unsigned char* header, KdfParams& params) {
+    if (memcmp(header, KDF_MAGIC, sizeof(KDF_MAGIC)) != 0) return false;
+    params.type = (KdfType)header[4];
+    params.logN = header[5];
+    params.r = header[6];
+    params.p = header[7];
+    params.iterations = 0;
+    for (int i = 0; i < 4; ++i) params.iterations |= (uint32_t)header[8 + i] << (8 * i);
+    memcpy(params.salt, header + 12, KDF_SALT_LENGTH);
+    params.envelope = (header[FLAGS_OFFSET] & FLAG_ENVELOPE) != 0;
+    return validParams(params);
+}
+
+bool kdfHeaderCompressed(const unsigned char* header) {
+    return (header[FLAGS_OFFSET] & FLAG_COMPRESSED) != 0;
+}
+
+void setKdfHeaderCompressed(unsigned char* header, bool compressed) {
+    if (compressed) header[FLAGS_OFFSET] |= FLAG_COMPRESSED;
+    else header[FLAGS_OFFSET] &= ~FLAG_COMPRESSED;
+}
+
+bool sameKdfHeader(const unsigned char* a, const unsigned char* b) {
+    return memcmp(a, b, FLAGS_OFFSET) == 0 &&
+           (a[FLAGS_OFFSET] & ~FLAG_COMPRESSED) == (b[FLAGS_OFFSET] & ~FLAG_COMPRESSED) &&
+           memcmp(a + FLAGS_OFFSET + 1, b + FLAGS_OFFSET + 1, KDF_HEADER_LENGTH - FLAGS_OFFSET - 1) == 0;
+}
+
+bool readKdfHeader(const std::string& path, KdfParams& params) {
+    unsigned char header[KDF_HEADER_LENGTH];
+    std::ifstream in(path, std::ios::binary);
+    in.read(reinterpret_cast<char*>(header), KDF_HEADER_LENGTH);
+    return in.gcount() == KDF_HEADER_LENGTH && decodeKdfHeader(header, params);
+}
+
+bool deriveKey(const std::string& password, const KdfParams& params, unsigned char* key) {
+    if (!validParams(params)) return false;
+    if (params.type == KdfType::PBKDF2_SHA256) {
+        return PKCS5_PBKDF2_HMAC(password.data(), password.size(), params.salt, KDF_SALT_LENGTH,
+                                 params.iterations, EVP_sha256(), AES_KEY_LENGTH, key) == 1;
+    }
+    return EVP_PBE_scrypt(password.data(), password.size(), params.salt, KDF_SALT_LENGTH,
+                          1ull << params.logN, params.r, params.p, scryptMemory(params) + (1 << 20),
+                          key, AES_KEY_LENGTH) == 1;
+}
+
+DerivedKeyCache::DerivedKeyCache(size_t capacity) : capacity(capacity ? capacity : 1) {}
+
+DerivedKeyCache::~DerivedKeyCache() {
+    clear();
+}
+
+void DerivedKeyCache::evict(std::list<Entry>::iterator it) {
+    OPENSSL_cleanse(it->key, sizeof(it->key));
+    entries.erase(it);
+}
+
+bool DerivedKeyCache::get(const std::string& password, const KdfParams& params, unsigned char* key) {
+    // The tag binds the password to the full header, so different salts or
+    // parameters never share an entry.
+    unsigned char header[KDF_HEADER_LENGTH];
+    encodeKdfHeader(params, header);
+    unsigned char tag[32];
+    unsigned int tagLength = 0;
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    bool ok = ctx && EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr) &&
+              EVP_DigestUpdate(ctx, header, sizeof(header)) &&
+              EVP_DigestUpdate(ctx, password.data(), password.size()) &&
+              EVP_DigestFinal_ex(ctx, tag, &tagLength);
+    EVP_MD_CTX_free(ctx);
+    if (!ok) return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (memcmp(it->tag, tag, sizeof(tag)) == 0) {
+            entries.splice(entries.begin(), entries, it);
+            memcpy(key, it->key, AES_KEY_LENGTH);
+            ++hitCount;
+            return true;
+        }
+    }
+
+    ++missCount;
+    if (!deriveKey(password, params, key)) return false;
+    if (entries.size() >= capacity) evict(std::prev(entries.end()));
+    entries.emplace_front();
+    memcpy(entries.front().tag, tag, sizeof(tag));
+    memcpy(entries.front().key, key, AES_KEY_LENGTH);
+    return true;
+}
+
+void DerivedKeyCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    while (!entries.empty()) evict(entries.begin());
+}
+
+TaskKey::~TaskKey() {
+    OPENSSL_cleanse(key, sizeof(key));
+}
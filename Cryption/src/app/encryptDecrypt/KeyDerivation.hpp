@@ -0,0 +1,103 @@
+#ifndef KEY_DERIVATION_HPP
+#define KEY_DERIVATION_HPP
+
+#include <string>
+#include <list>
+#include <mutex>
+#include <cstddef>
+#include <cstdint>
+#include "AES.hpp"
+
+// Files encrypted with a password start with a 32-byte header naming the KDF,
+// its parameters and the salt:
+//   "LKDF" | kdf (1) | scrypt log2 N (1) | scrypt r (1) | scrypt p (1) |
+//   PBKDF2 iterations (4, little endian) | salt (16) | flags (1) | reserved (3)
+// With the envelope flag, the header is followed by the file's random data
+// key, wrapped (RFC 3394) by the key derived from the password; then come the
+// IV and the AES-256-CBC ciphertext under the data key. Changing the password
+// only rewrites the header and the wrapped key (see Rekey.hpp). Older files
+// have no envelope and are encrypted under the derived key itself; files
+// without the header use the legacy key from .env. The compressed flag marks
+// a body that was compressed before encryption (see Compression.hpp); it is
+// per file, so it is not part of KdfParams and does not change the key.
+const int KDF_SALT_LENGTH = 16;
+const int KDF_HEADER_LENGTH = 32;
+const int FILE_HEADER_LENGTH = KDF_HEADER_LENGTH + AES_WRAPPED_KEY_LENGTH;
+
+enum class KdfType : uint8_t {
+    PBKDF2_SHA256 = 1,
+    SCRYPT = 2
+};
+
+struct KdfParams {
+    KdfType type = KdfType::SCRYPT;
+    uint32_t iterations = 600000;   // PBKDF2
+    uint8_t logN = 15;              // scrypt: N = 2^logN, memory is 128 * N * r bytes
+    uint8_t r = 8;
+    uint8_t p = 1;
+    unsigned char salt[KDF_SALT_LENGTH] = {};
+    bool envelope = true;           // a wrapped data key follows the header
+};
+
+// Parameters from CRYPTION_KDF ("scrypt[:logN:r:p]" or "pbkdf2[:iterations]",
+// default scrypt 15:8:1) with a fresh random salt. False if the variable is
+// malformed or out of range.
+bool kdfParamsFromEnv(KdfParams& params);
+
+void encodeKdfHeader(const KdfParams& params, unsigned char* header);
+// False if `header` does not start with the magic or holds parameters out of
+// range (so a crafted file cannot ask for gigabytes of scrypt memory).
+bool decodeKdfHeader(const unsigned char* header, KdfParams& params);
+// Whether a header (with the flags byte) says the body is compressed.
+bool kdfHeaderCompressed(const unsigned char* header);
+void setKdfHeaderCompressed(unsigned char* header, bool compressed);
+// Whether two headers name the same KDF, parameters and salt, whatever their
+// per-file flags say.
+bool sameKdfHeader(const unsigned char* a, const unsigned char* b);
+// Reads and decodes the header of the file at `path`.
+bool readKdfHeader(const std::string& path, KdfParams& params);
+
+bool deriveKey(const std::string& password, const KdfParams& params, unsigned char* key);
+
+// Derived keys by (password, KDF parameters, salt), least recently used
+// first out. Keys are wiped when evicted, on clear() and on destruction;
+// lookups are by a SHA-256 tag, so the password itself is not kept. The
+// cache is per process: it saves work within one run, not across runs.
+class DerivedKeyCache {
+public:
+    explicit DerivedKeyCache(size_t capacity = 8);
+    ~DerivedKeyCache();
+    DerivedKeyCache(const DerivedKeyCache&) = delete;
+    DerivedKeyCache& operator=(const DerivedKeyCache&) = delete;
+
+    // Copies the key into `key`, running the KDF only on a miss.
+    bool get(const std::string& password, const KdfParams& params, unsigned char* key);
+    void clear();
+    size_t hits() const { return hitCount; }
+    size_t misses() const { return missCount; }
+
+private:
+    struct Entry {
+        unsigned char tag[32];
+        unsigned char key[AES_KEY_LENGTH];
+    };
+    void evict(std::list<Entry>::iterator it);
+
+    std::list<Entry> entries;    // most recently used first
+    size_t capacity;
+    size_t hitCount = 0;
+    size_t missCount = 0;
+    std::mutex mutex;
+};
+
+// What a worker process needs to encrypt or decrypt one password-protected
+// file: the header to write (or expect) and the derived key, which wraps the
+// file's data key. Sent to the worker over its standard input, never on the
+// command line.
+struct TaskKey {
+    unsigned char header[KDF_HEADER_LENGTH];
+    unsigned char key[AES_KEY_LENGTH];
+    ~TaskKey();
+};
+
+#endif
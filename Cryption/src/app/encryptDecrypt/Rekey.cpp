@@ -0,0 +1,79 @@
+#include "Rekey.hpp"
+#include <openssl/crypto.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+// Returns an empty string on success, otherwise why the file was skipped.
+std::string rekeyFile(const std::string& path, const OldKeyResolver& oldKey, const TaskKey& newKey) {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file) return "cannot open the file";
+    unsigned char header[FILE_HEADER_LENGTH];
+    file.read(reinterpret_cast<char*>(header), FILE_HEADER_LENGTH);
+    KdfParams params;
+    if (file.gcount() < KDF_HEADER_LENGTH || !decodeKdfHeader(header, params)) {
+        return "not password protected";
+    }
+    if (!params.envelope || file.gcount() < FILE_HEADER_LENGTH) {
+        return "no data key envelope; decrypt and encrypt it once to convert it";
+    }
+
+    unsigned char key[AES_KEY_LENGTH];
+    unsigned char dataKey[AES_KEY_LENGTH];
+    bool ok = oldKey(params, key) && aesUnwrapKey(key, header + KDF_HEADER_LENGTH, dataKey);
+    OPENSSL_cleanse(key, sizeof(key));
+    if (!ok) return "wrong password for this file";
+
+    unsigned char rewrapped[FILE_HEADER_LENGTH];
+    memcpy(rewrapped, newKey.header, KDF_HEADER_LENGTH);
+    setKdfHeaderCompressed(rewrapped, kdfHeaderCompressed(header));
+    ok = aesWrapKey(newKey.key, dataKey, rewrapped + KDF_HEADER_LENGTH);
+    OPENSSL_cleanse(dataKey, sizeof(dataKey));
+    if (!ok) return "key wrap failed";
+
+    // One write of the whole header, so the file never has the new KDF
+    // header next to the old wrapped key.
+    file.clear();
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(rewrapped), FILE_HEADER_LENGTH);
+    file.flush();
+    if (!file) return "cannot write the new header";
+    return "";
+}
+
+}
+
+RekeyResult rekeyFiles(const std::vector<std::string>& paths, const OldKeyResolver& oldKey,
+                       const TaskKey& newKey) {
+    auto start = std::chrono::steady_clock::now();
+    RekeyResult result;
+    std::atomic<size_t> next(0);
+    std::mutex mutex;
+    auto worker = [&] {
+        for (size_t i = next++; i < paths.size(); i = next++) {
+            std::string error = rekeyFile(paths[i], oldKey, newKey);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (error.empty()) {
+                ++result.files;
+            } else {
+                ++result.failed;
+                result.errors.push_back(paths[i] + ": " + error);
+            }
+        }
+    };
+
+    size_t threadCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), paths.size());
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < threadCount; ++t) threads.emplace_back(worker);
+    worker();
+    for (std::thread& thread : threads) thread.join();
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
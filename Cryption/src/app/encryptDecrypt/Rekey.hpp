@@ -0,0 +1,34 @@
+#ifndef REKEY_HPP
+#define REKEY_HPP
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstddef>
+#include "KeyDerivation.hpp"
+
+// Moves password-protected files to a new password without touching their
+// contents: each file's data key is unwrapped with the old derived key,
+// wrapped again with the new one, and the first FILE_HEADER_LENGTH bytes
+// (KDF header and wrapped key) are rewritten in place. The cost is one small
+// read and write per file however large it is. Files are spread over a
+// thread per core.
+
+// Copies the old derived key for a file's KDF header into `key`. Called
+// from several threads at once.
+using OldKeyResolver = std::function<bool(const KdfParams& params, unsigned char* key)>;
+
+struct RekeyResult {
+    size_t files = 0;
+    size_t failed = 0;
+    double seconds = 0;
+    std::vector<std::string> errors;   // "<path>: <reason>" for each failed file
+};
+
+// Rewraps every file in `paths` under `newKey`. Files without a data key
+// envelope (encrypted before envelopes, or with the .env key) fail and keep
+// their old key; decrypting and encrypting them once converts them.
+RekeyResult rekeyFiles(const std::vector<std::string>& paths, const OldKeyResolver& oldKey,
+                       const TaskKey& newKey);
+
+#endif
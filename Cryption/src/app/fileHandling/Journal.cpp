@@ -0,0 +1,146 @@
+#include "Journal.hpp"
+#include "../encryptDecrypt/Cryption.hpp"
+#include <filesystem>
+#include <sstream>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char JOURNAL_MAGIC[] = "cryption-journal 1";
+const char DONE_PREFIX[] = "done ";
+
+const char* actionName(Action action) {
+    return action == Action::ENCRYPT ? "encrypt" : "decrypt";
+}
+
+// Journal entries use absolute paths, so a job finds them again whichever
+// way its path is written on the command line.
+std::string journalKey(const std::string& file) {
+    std::error_code ec;
+    fs::path absolute = fs::absolute(file, ec);
+    return (ec ? fs::path(file) : absolute).lexically_normal().string();
+}
+
+bool writeLine(std::ostream& out, const std::string& line) {
+    out << line << '\n';
+    out.flush();
+    return (bool)out;
+}
+
+}
+
+std::string JobJournal::pathFor(const std::string& target) {
+    std::error_code ec;
+    fs::path p = fs::path(target).lexically_normal();
+    if (fs::is_directory(p, ec)) return (p / ".cryption-journal").string();
+    return (p.parent_path() / ("." + p.filename().string() + ".cryption-journal")).string();
+}
+
+// Loads the done set and, with `action`, the job's action (left alone for an
+// empty journal). A line cut short by a crash is dropped, and cut off the
+// file, so the next record does not run into it. False if the file is not
+// a journal.
+bool JobJournal::read(Action* action) {
+    done.clear();
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return true;
+    std::string text((std::istreambuf_iterator<char>(in)), {});
+    in.close();
+
+    size_t complete = text.rfind('\n');
+    complete = complete == std::string::npos ? 0 : complete + 1;
+    if (complete < text.size()) {
+        std::error_code ec;
+        fs::resize_file(path, complete, ec);
+        text.resize(complete);
+    }
+
+    std::istringstream lines(text);
+    std::string line;
+    bool first = true;
+    while (std::getline(lines, line)) {
+        if (first) {
+            first = false;
+            if (action) {
+                if (line == std::string(JOURNAL_MAGIC) + " encrypt") *action = Action::ENCRYPT;
+                else if (line == std::string(JOURNAL_MAGIC) + " decrypt") *action = Action::DECRYPT;
+                else return false;
+            }
+        } else if (line.compare(0, sizeof(DONE_PREFIX) - 1, DONE_PREFIX) == 0) {
+            done.insert(line.substr(sizeof(DONE_PREFIX) - 1));
+        }
+    }
+    hasHeader = !first;
+    return true;
+}
+
+bool JobJournal::open(const std::string& journalPath, Action action, std::string& error) {
+    path = journalPath;
+    hasHeader = false;
+    Action journalAction = action;
+    if (!read(&journalAction)) {
+        error = path + " is not a Cryption job journal";
+        return false;
+    }
+    bool otherAction = journalAction != action;
+    if (otherAction && !done.empty()) {
+        error = "an unfinished " + std::string(actionName(journalAction)) + " job is recorded in " + path +
+                "; run it again to finish it, or delete the journal to drop it";
+        return false;
+    }
+    out.open(path, std::ios::binary | (otherAction ? std::ios::trunc : std::ios::app));
+    if (!out) {
+        error = "cannot write " + path;
+        return false;
+    }
+    if (otherAction) hasHeader = false;
+    if (!hasHeader && !writeLine(out, std::string(JOURNAL_MAGIC) + " " + actionName(action))) {
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+void JobJournal::reload() {
+    std::lock_guard<std::mutex> lock(mutex);
+    read(nullptr);
+}
+
+bool JobJournal::isDone(const std::string& file) const {
+    return done.count(journalKey(file)) > 0;
+}
+
+std::vector<std::string> JobJournal::finishRenames() {
+    std::vector<std::string> failures;
+    for (const std::string& file : done) {
+        std::error_code ec;
+        std::string tmp = file + CRYPTION_TMP_SUFFIX;
+        if (!fs::exists(tmp, ec)) continue;
+        fs::rename(tmp, file, ec);
+        if (ec) failures.push_back(file + ": " + ec.message());
+    }
+    return failures;
+}
+
+bool JobJournal::recordDone(const std::string& file) {
+    std::string key = journalKey(file);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!writeLine(out, DONE_PREFIX + key)) return false;
+    done.insert(key);
+    return true;
+}
+
+bool JobJournal::appendDone(const std::string& journalPath, const std::string& file) {
+    std::ofstream out(journalPath, std::ios::binary | std::ios::app);
+    return writeLine(out, DONE_PREFIX + journalKey(file));
+}
+
+void JobJournal::remove() {
+    std::lock_guard<std::mutex> lock(mutex);
+    out.close();
+    std::error_code ec;
+    fs::remove(path, ec);
+    done.clear();
+}
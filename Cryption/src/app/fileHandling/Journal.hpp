@@ -0,0 +1,63 @@
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <fstream>
+#include <unordered_set>
+#include "../processes/Task.hpp"
+
+// Progress record of a bulk job, so an interrupted job can simply be run
+// again: files it finished are skipped without being read, and it carries
+// on with the rest. The journal is a hidden text file in the job's directory
+// (".cryption-journal", or ".<name>.cryption-journal" next to a single
+// file), holding the action and one "done <absolute path>" line per file.
+//
+// A file is recorded once its result is complete in "<file>.cryption.tmp",
+// just before the rename over the original. So after a crash a file without
+// a record is untouched and is processed again, and a recorded file is
+// either renamed already or has a complete temporary file whose rename
+// finishRenames() completes. The journal is deleted when a job ends with
+// every file done, or with none done, since it then holds nothing to resume.
+class JobJournal {
+public:
+    // The journal for a job over `target` (a directory or a single file).
+    static std::string pathFor(const std::string& target);
+
+    // Reads an existing journal at `path` or starts a new one. Fails, with
+    // `error` set, if the journal belongs to an unfinished job of the other
+    // action that already finished files (re-running that job finishes it;
+    // deleting the journal drops it). One of the other action without any
+    // finished file is started over.
+    bool open(const std::string& path, Action action, std::string& error);
+    // Reads the journal again, after worker processes appended to it.
+    void reload();
+
+    bool isDone(const std::string& file) const;
+    size_t doneCount() const { return done.size(); }
+
+    // Renames the temporary results that were recorded but not yet renamed
+    // when the job stopped. Returns "<path>: <reason>" for each failure.
+    std::vector<std::string> finishRenames();
+
+    // Records `file` as done. Thread safe; the line is flushed before this
+    // returns.
+    bool recordDone(const std::string& file);
+    // The same for a worker process, which only knows the journal's path.
+    static bool appendDone(const std::string& journalPath, const std::string& file);
+
+    // The job is complete.
+    void remove();
+
+private:
+    bool read(Action* action);
+
+    std::string path;
+    bool hasHeader = false;
+    std::unordered_set<std::string> done;
+    std::ofstream out;
+    std::mutex mutex;
+};
+
+#endif
@@ -0,0 +1,82 @@
+#include "Manifest.hpp"
+#include <filesystem>
+#include <set>
+#include <algorithm>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Splits `line` at its first two tabs; the third field keeps any later ones.
+bool splitRecord(const std::string& line, std::string fields[3]) {
+    size_t first = line.find('\t');
+    if (first == std::string::npos) return false;
+    size_t second = line.find('\t', first + 1);
+    if (second == std::string::npos) return false;
+    fields[0] = line.substr(0, first);
+    fields[1] = line.substr(first + 1, second - first - 1);
+    fields[2] = line.substr(second + 1);
+    return !fields[0].empty() && !fields[1].empty() && !fields[2].empty();
+}
+
+// Two spellings of the same file are one file.
+std::string fileKey(const std::string& path) {
+    std::error_code ec;
+    fs::path absolute = fs::absolute(path, ec);
+    return (ec ? fs::path(path) : absolute).lexically_normal().string();
+}
+
+}
+
+Manifest::~Manifest() {
+    for (auto& entry : passwords) std::fill(entry.second.begin(), entry.second.end(), '\0');
+}
+
+bool readManifest(std::istream& in, Manifest& manifest, std::string& error) {
+    std::string line;
+    std::string fields[3];
+    size_t lineNumber = 0;
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        bool ok = splitRecord(line, fields);
+        std::fill(line.begin(), line.end(), '\0');
+        if (ok && fields[0] == "key") {
+            std::string& password = manifest.passwords[fields[1]];
+            std::fill(password.begin(), password.end(), '\0');
+            password.swap(fields[2]);
+        } else if (ok && (fields[0] == "encrypt" || fields[0] == "decrypt")) {
+            ManifestEntry entry;
+            entry.action = fields[0] == "encrypt" ? Action::ENCRYPT : Action::DECRYPT;
+            entry.keyId = fields[1];
+            entry.path = fields[2];
+            manifest.entries.push_back(std::move(entry));
+        } else {
+            std::fill(fields[2].begin(), fields[2].end(), '\0');
+            error = "line " + std::to_string(lineNumber) +
+                    ": expected key, encrypt or decrypt, a key id and a value separated by tabs";
+            return false;
+        }
+    }
+
+    // Entries run grouped by action and key, so a file listed twice could
+    // not keep its order; only its first record is run.
+    std::set<std::string> seen;
+    for (ManifestEntry& entry : manifest.entries) {
+        if (!seen.insert(fileKey(entry.path)).second) {
+            entry.error = "listed more than once";
+        } else if (!manifest.passwords.count(entry.keyId)) {
+            entry.error = "unknown key id " + entry.keyId;
+        }
+    }
+    return true;
+}
+
+std::string manifestResultLine(const ManifestEntry& entry, const std::string& failure) {
+    std::string line = failure.empty() ? "ok" : "failed";
+    line += entry.action == Action::ENCRYPT ? "\tencrypt\t" : "\tdecrypt\t";
+    line += entry.path;
+    if (!failure.empty()) line += "\t" + failure;
+    return line;
+}
@@ -0,0 +1,41 @@
+#ifndef MANIFEST_HPP
+#define MANIFEST_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <istream>
+#include "../processes/Task.hpp"
+
+// Job description for `encrypt_decrypt --manifest <file|->`: many files, each
+// with its own action and key, in one process. One record per line, fields
+// separated by tabs:
+//   key     <key-id>  <password>
+//   encrypt <key-id>  <path>
+//   decrypt <key-id>  <path>
+// Key lines may come anywhere; blank lines and lines starting with '#' are
+// ignored. A path may contain spaces but not tabs. Since key lines hold
+// passwords, the manifest is best given on standard input.
+struct ManifestEntry {
+    Action action = Action::ENCRYPT;
+    std::string keyId;
+    std::string path;
+    std::string error;   // why the record cannot be run, empty if it can
+};
+
+struct Manifest {
+    std::vector<ManifestEntry> entries;            // in the order given
+    std::map<std::string, std::string> passwords;  // by key id
+    ~Manifest();                                   // wipes the passwords
+};
+
+// Reads every record from `in`. A malformed line fails the whole manifest,
+// with `error` naming the line; an unknown key id or a file listed twice
+// only marks that entry (see ManifestEntry::error).
+bool readManifest(std::istream& in, Manifest& manifest, std::string& error);
+
+// The result line for one entry: "ok<TAB><action><TAB><path>" or
+// "failed<TAB><action><TAB><path><TAB><reason>".
+std::string manifestResultLine(const ManifestEntry& entry, const std::string& failure);
+
+#endif
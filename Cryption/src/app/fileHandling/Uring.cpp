@@ -0,0 +1,213 @@
+#include "Uring.hpp"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define CRYPTION_HAVE_URING 1
+#endif
+#endif
+
+#ifdef CRYPTION_HAVE_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+template <typename T>
+T* ringField(void* ring, unsigned offset) {
+    return reinterpret_cast<T*>(static_cast<char*>(ring) + offset);
+}
+
+unsigned loadAcquire(const unsigned* p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+void storeRelease(unsigned* p, unsigned value) {
+    __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+// Every operation the batch pipeline queues has to be there; most kernels
+// before 5.11 lack RENAMEAT.
+bool probeOps(int ringFd) {
+    const unsigned count = 256;
+    std::vector<char> storage(sizeof(io_uring_probe) + count * sizeof(io_uring_probe_op));
+    io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(storage.data());
+    if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PROBE, probe, count) < 0) return false;
+    const unsigned needed[] = {IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ,
+                               IORING_OP_WRITE, IORING_OP_CLOSE, IORING_OP_RENAMEAT};
+    for (unsigned op : needed) {
+        if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+    }
+    return true;
+}
+
+}
+
+Uring::Uring()
+    : ringFd(-1), sqRing(MAP_FAILED), cqRing(MAP_FAILED), entries(MAP_FAILED),
+      sqRingSize(0), cqRingSize(0), entriesSize(0), sqHead(nullptr), sqTail(nullptr),
+      sqMask(nullptr), sqArray(nullptr), sqEntries(0), cqHead(nullptr), cqTail(nullptr),
+      cqMask(nullptr), cqes(nullptr), localTail(0), submittedTail(0) {}
+
+Uring::~Uring() {
+    if (entries != MAP_FAILED) munmap(entries, entriesSize);
+    if (cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+    if (sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+    if (ringFd >= 0) close(ringFd);
+}
+
+bool Uring::init(unsigned count) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = (int)syscall(__NR_io_uring_setup, count, &params);
+    if (fd < 0) return false;
+    ringFd = fd;
+    if (!probeOps(ringFd)) return false;
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMap) sqRingSize = cqRingSize = sqRingSize > cqRingSize ? sqRingSize : cqRingSize;
+
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) return false;
+    cqRing = singleMap ? sqRing
+                       : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                              ringFd, IORING_OFF_CQ_RING);
+    if (cqRing == MAP_FAILED) return false;
+    entriesSize = params.sq_entries * sizeof(io_uring_sqe);
+    entries = mmap(nullptr, entriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   ringFd, IORING_OFF_SQES);
+    if (entries == MAP_FAILED) return false;
+
+    sqHead = ringField<unsigned>(sqRing, params.sq_off.head);
+    sqTail = ringField<unsigned>(sqRing, params.sq_off.tail);
+    sqMask = ringField<unsigned>(sqRing, params.sq_off.ring_mask);
+    sqArray = ringField<unsigned>(sqRing, params.sq_off.array);
+    sqEntries = params.sq_entries;
+    cqHead = ringField<unsigned>(cqRing, params.cq_off.head);
+    cqTail = ringField<unsigned>(cqRing, params.cq_off.tail);
+    cqMask = ringField<unsigned>(cqRing, params.cq_off.ring_mask);
+    cqes = ringField<io_uring_cqe>(cqRing, params.cq_off.cqes);
+    localTail = submittedTail = *sqTail;
+    return true;
+}
+
+void* Uring::nextEntry(uint8_t opcode, int fd, uint64_t tag) {
+    if (!cqes || localTail - loadAcquire(sqHead) >= sqEntries) return nullptr;
+    unsigned index = localTail & *sqMask;
+    io_uring_sqe* sqe = static_cast<io_uring_sqe*>(entries) + index;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->user_data = tag;
+    sqArray[index] = index;
+    ++localTail;
+    return sqe;
+}
+
+bool Uring::queueOpen(const char* path, int flags, unsigned mode, uint64_t tag) {
+    io_uring_sqe* sqe = static_cast<io_uring_sqe*>(nextEntry(IORING_OP_OPENAT, AT_FDCWD, tag));
+    if (!sqe) return false;
+    sqe->addr = reinterpret_cast<uint64_t>(path);
+    sqe->len = mode;
+    sqe->open_flags = flags | O_CLOEXEC;
+    return true;
+}
+
+bool Uring::queueStatx(const char* path, void* statxBuffer, uint64_t tag) {
+    io_uring_sqe* sqe = static_cast<io_uring_sqe*>(nextEntry(IORING_OP_STATX, AT_FDCWD, tag));
+    if (!sqe) return false;
+    sqe->addr = reinterpret_cast<uint64_t>(path);
+    sqe->len = STATX_SIZE | STATX_MODE;
+    sqe->off = reinterpret_cast<uint64_t>(statxBuffer);
+    return true;
+}
+
+bool Uring::queueRead(int fd, void* buffer, unsigned length, uint64_t offset, uint64_t tag) {
+    io_uring_sqe* sqe = static_cast<io_uring_sqe*>(nextEntry(IORING_OP_READ, fd, tag));
+    if (!sqe) return false;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer);
+    sqe->len = length;
+    sqe->off = offset;
+    return true;
+}
+
+bool Uring::queueWrite(int fd, const void* buffer, unsigned length, uint64_t offset, uint64_t tag) {
+    io_uring_sqe* sqe = static_cast<io_uring_sqe*>(nextEntry(IORING_OP_WRITE, fd, tag));
+    if (!sqe) return false;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer);
+    sqe->len = length;
+    sqe->off = offset;
+    return true;
+}
+
+bool Uring::queueClose(int fd, uint64_t tag, bool link) {
+    io_uring_sqe* sqe = static_cast<io_uring_sqe*>(nextEntry(IORING_OP_CLOSE, fd, tag));
+    if (!sqe) return false;
+    if (link) sqe->flags |= IOSQE_IO_LINK;
+    return true;
+}
+
+bool Uring::queueRename(const char* from, const char* to, uint64_t tag) {
+    io_uring_sqe* sqe = static_cast<io_uring_sqe*>(nextEntry(IORING_OP_RENAMEAT, AT_FDCWD, tag));
+    if (!sqe) return false;
+    sqe->addr = reinterpret_cast<uint64_t>(from);
+    sqe->len = (unsigned)AT_FDCWD;
+    sqe->addr2 = reinterpret_cast<uint64_t>(to);
+    return true;
+}
+
+bool Uring::submit(unsigned waitFor) {
+    if (!cqes) return false;  // init() did not finish
+    storeRelease(sqTail, localTail);
+    for (;;) {
+        unsigned pending = localTail - submittedTail;
+        long ret = syscall(__NR_io_uring_enter, ringFd, pending, waitFor,
+                           waitFor ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+        if (ret >= 0) {
+            submittedTail += (unsigned)ret;
+            return true;
+        }
+        if (errno != EINTR && errno != EAGAIN) return false;
+    }
+}
+
+bool Uring::reap(uint64_t& tag, int& result) {
+    if (!cqes) return false;  // init() did not finish
+    unsigned head = *cqHead;
+    if (head == loadAcquire(cqTail)) return false;
+    const io_uring_cqe* cqe = static_cast<io_uring_cqe*>(cqes) + (head & *cqMask);
+    tag = cqe->user_data;
+    result = cqe->res;
+    storeRelease(cqHead, head + 1);
+    return true;
+}
+
+#else
+
+Uring::Uring()
+    : ringFd(-1), sqRing(nullptr), cqRing(nullptr), entries(nullptr), sqRingSize(0), cqRingSize(0),
+      entriesSize(0), sqHead(nullptr), sqTail(nullptr), sqMask(nullptr), sqArray(nullptr),
+      sqEntries(0), cqHead(nullptr), cqTail(nullptr), cqMask(nullptr), cqes(nullptr),
+      localTail(0), submittedTail(0) {}
+Uring::~Uring() {}
+bool Uring::init(unsigned) { return false; }
+void* Uring::nextEntry(uint8_t, int, uint64_t) { return nullptr; }
+bool Uring::queueOpen(const char*, int, unsigned, uint64_t) { return false; }
+bool Uring::queueStatx(const char*, void*, uint64_t) { return false; }
+bool Uring::queueRead(int, void*, unsigned, uint64_t, uint64_t) { return false; }
+bool Uring::queueWrite(int, const void*, unsigned, uint64_t, uint64_t) { return false; }
+bool Uring::queueClose(int, uint64_t, bool) { return false; }
+bool Uring::queueRename(const char*, const char*, uint64_t) { return false; }
+bool Uring::submit(unsigned) { return false; }
+bool Uring::reap(uint64_t&, int&) { return false; }
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef URING_HPP
+#define URING_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// A minimal io_uring wrapper over the raw system calls (no liburing needed).
+// Requests are queued with a caller-chosen tag, sent to the kernel in one
+// system call by submit(), and their results are collected with reap().
+// Only available on Linux; elsewhere init() fails and callers fall back to
+// blocking I/O.
+class Uring {
+public:
+    Uring();
+    ~Uring();
+    Uring(const Uring&) = delete;
+    Uring& operator=(const Uring&) = delete;
+
+    // Sets up a ring with room for `entries` queued requests. False if
+    // io_uring is unavailable or lacks one of the operations used below.
+    bool init(unsigned entries);
+
+    // Each returns false when the submission queue is full. With `link`, the
+    // next request queued only starts if this one succeeds.
+    bool queueOpen(const char* path, int flags, unsigned mode, uint64_t tag);
+    // Size and mode of `path` into a struct statx (at least 256 bytes).
+    bool queueStatx(const char* path, void* statxBuffer, uint64_t tag);
+    bool queueRead(int fd, void* buffer, unsigned length, uint64_t offset, uint64_t tag);
+    bool queueWrite(int fd, const void* buffer, unsigned length, uint64_t offset, uint64_t tag);
+    bool queueClose(int fd, uint64_t tag, bool link = false);
+    bool queueRename(const char* from, const char* to, uint64_t tag);
+
+    // Hands everything queued to the kernel and waits until at least
+    // `waitFor` results are ready. Returns false on a system call error.
+    bool submit(unsigned waitFor);
+    // Takes the next ready result, if any: `result` is the system call's
+    // return value, or -errno.
+    bool reap(uint64_t& tag, int& result);
+
+private:
+    void* nextEntry(uint8_t opcode, int fd, uint64_t tag);
+
+    int ringFd;
+    void* sqRing;
+    void* cqRing;
+    void* entries;
+    size_t sqRingSize;
+    size_t cqRingSize;
+    size_t entriesSize;
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    unsigned sqEntries;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    void* cqes;
+    unsigned localTail;     // entries queued, not yet published to the kernel
+    unsigned submittedTail;
+};
+
+#endif
@@ -0,0 +1,226 @@
+#include "Intake.hpp"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+// An exclusive lock on a file, released by unlock(), on destruction or when
+// the process exits. Two IntakeLocks on the same file exclude each other even
+// within one process.
+class IntakeLock {
+public:
+    explicit IntakeLock(const std::string& path) {
+#ifdef _WIN32
+        handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_ALWAYS,
+                             FILE_ATTRIBUTE_NORMAL, NULL);
+#else
+        fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+#endif
+    }
+    ~IntakeLock() {
+        unlock();
+#ifdef _WIN32
+        if (handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+#else
+        if (fd >= 0) close(fd);
+#endif
+    }
+    bool isOpen() const {
+#ifdef _WIN32
+        return handle != INVALID_HANDLE_VALUE;
+#else
+        return fd >= 0;
+#endif
+    }
+    // With `wait` false, fails at once if somebody else holds the lock.
+    bool lock(bool wait) {
+        if (!isOpen()) return false;
+#ifdef _WIN32
+        OVERLAPPED at{};
+        DWORD flags = LOCKFILE_EXCLUSIVE_LOCK | (wait ? 0 : LOCKFILE_FAIL_IMMEDIATELY);
+        held = LockFileEx(handle, flags, 0, 1, 0, &at) != 0;
+#else
+        int result;
+        while ((result = flock(fd, LOCK_EX | (wait ? 0 : LOCK_NB))) != 0 && errno == EINTR) {
+        }
+        held = result == 0;
+#endif
+        return held;
+    }
+    void unlock() {
+        if (!held) return;
+#ifdef _WIN32
+        OVERLAPPED at{};
+        UnlockFileEx(handle, 0, 1, 0, &at);
+#else
+        flock(fd, LOCK_UN);
+#endif
+        held = false;
+    }
+
+private:
+#ifdef _WIN32
+    HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
+    bool held = false;
+};
+
+size_t pickNextEntry(const std::vector<IntakeEntry>& waiting, unsigned bypassed) {
+    size_t interactive = waiting.size(), background = waiting.size();
+    for (size_t i = 0; i < waiting.size(); ++i) {
+        size_t& oldest = waiting[i].priority == TaskPriority::BACKGROUND ? background : interactive;
+        if (oldest == waiting.size() || waiting[i].sequence < waiting[oldest].sequence) oldest = i;
+    }
+    if (interactive == waiting.size()) return background;
+    if (background == waiting.size()) return interactive;
+    return bypassed >= INTAKE_INTERACTIVE_BURST ? background : interactive;
+}
+
+TaskIntake::TaskIntake(const std::string& directory) : directory(directory) {}
+
+TaskIntake::~TaskIntake() {
+    leave();
+    if (ticket) {
+        ticket.reset();
+        std::error_code ec;
+        fs::remove(ticketPath, ec);
+    }
+}
+
+std::string TaskIntake::defaultDirectory() {
+    const char* configured = std::getenv("CRYPTION_INTAKE");
+    if (configured && *configured) return configured;
+    std::error_code ec;
+    fs::path temp = fs::temp_directory_path(ec);
+    return ((ec ? fs::path(".") : temp) / "cryption-intake").string();
+}
+
+// The directory holds "lock" (held while the rest is read or changed),
+// "state" (the next ticket number and the bypass count), "slot" (held by the
+// process whose worker is running) and one "<number>-i|b.ticket" per waiting
+// process, held by that process.
+bool TaskIntake::lockState() {
+    if (!state) state.reset(new IntakeLock((fs::path(directory) / "lock").string()));
+    return state->lock(true);
+}
+
+void TaskIntake::readState(uint64_t& next, unsigned& bypassed) {
+    next = 0;
+    bypassed = 0;
+    std::ifstream in(fs::path(directory) / "state");
+    in >> next >> bypassed;
+}
+
+void TaskIntake::writeState(uint64_t next, unsigned bypassed) {
+    std::ofstream out(fs::path(directory) / "state", std::ios::trunc);
+    out << next << " " << bypassed << "\n";
+}
+
+// Tickets of processes that exited without leaving are dropped on the way.
+std::vector<IntakeEntry> TaskIntake::waitingTickets() {
+    std::vector<IntakeEntry> waiting;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(directory, ec)) {
+        std::string name = entry.path().filename().string();
+        unsigned long long sequence;
+        char kind;
+        if (entry.path().extension() != ".ticket" || sscanf(name.c_str(), "%llu-%c", &sequence, &kind) != 2) continue;
+        if (entry.path().string() != ticketPath) {
+            bool abandoned;
+            {
+                IntakeLock owner(entry.path().string());
+                abandoned = owner.lock(false);
+            }
+            if (abandoned) {
+                fs::remove(entry.path(), ec);
+                continue;
+            }
+        }
+        waiting.push_back({sequence, kind == 'b' ? TaskPriority::BACKGROUND : TaskPriority::INTERACTIVE});
+    }
+    return waiting;
+}
+
+bool TaskIntake::join(TaskPriority priority) {
+    std::error_code ec;
+    fs::create_directories(directory, ec);
+    if (!lockState()) {
+        std::cerr << "Warning: cannot use the task intake in " << directory << "; running without it." << std::endl;
+        return false;
+    }
+    uint64_t next;
+    unsigned bypassed;
+    readState(next, bypassed);
+    char name[40];
+    snprintf(name, sizeof(name), "%020llu-%c.ticket", (unsigned long long)next,
+             priority == TaskPriority::BACKGROUND ? 'b' : 'i');
+    ticketPath = (fs::path(directory) / name).string();
+    ticket.reset(new IntakeLock(ticketPath));
+    bool ok = ticket->lock(false);
+    if (ok) {
+        own = {next, priority};
+        writeState(next + 1, bypassed);
+    } else {
+        ticket.reset();
+        std::cerr << "Warning: cannot use the task intake in " << directory << "; running without it." << std::endl;
+    }
+    state->unlock();
+    return ok;
+}
+
+void TaskIntake::waitTurn() {
+    if (!ticket) return;
+    if (!slot) slot.reset(new IntakeLock((fs::path(directory) / "slot").string()));
+    if (!slot->isOpen()) return;
+    for (;;) {
+        bool granted = false;
+        if (lockState()) {
+            if (slot->lock(false)) {
+                std::vector<IntakeEntry> waiting = waitingTickets();
+                uint64_t next;
+                unsigned bypassed;
+                readState(next, bypassed);
+                if (waiting.empty() || waiting[pickNextEntry(waiting, bypassed)].sequence == own.sequence) {
+                    bool backgroundWaiting = std::any_of(waiting.begin(), waiting.end(), [](const IntakeEntry& e) {
+                        return e.priority == TaskPriority::BACKGROUND;
+                    });
+                    bool bypassing = own.priority == TaskPriority::INTERACTIVE && backgroundWaiting;
+                    writeState(next, bypassing ? bypassed + 1 : 0);
+                    ticket.reset();
+                    std::error_code ec;
+                    fs::remove(ticketPath, ec);
+                    granted = true;
+                } else {
+                    slot->unlock();
+                }
+            }
+            state->unlock();
+        } else {
+            // The directory went away; run rather than wait forever.
+            granted = true;
+        }
+        if (granted) return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+}
+
+void TaskIntake::leave() {
+    if (slot) slot->unlock();
+}
@@ -0,0 +1,67 @@
+#ifndef INTAKE_HPP
+#define INTAKE_HPP
+
+#include "Task.hpp"
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+// Admission of worker processes across every encrypt_decrypt running on the
+// machine: LockFS starts one per file it opens or saves, and a bulk job is
+// another. They share a directory (CRYPTION_INTAKE, by default
+// "cryption-intake" in the temporary directory) in which each one that wants
+// to start a worker leaves a ticket, and only one worker runs at a time:
+//
+// - a waiting interactive ticket always goes before waiting background
+//   tickets, so a file LockFS is waiting on waits at most for the worker
+//   already running;
+// - after INTAKE_INTERACTIVE_BURST interactive tickets in a row have gone
+//   ahead of a waiting background ticket, the oldest background ticket goes
+//   next, so background work keeps moving however busy LockFS is.
+//
+// A ticket and the running slot are lock files held by their process, so a
+// process that dies leaves the intake without blocking anybody.
+const unsigned INTAKE_INTERACTIVE_BURST = 4;
+
+struct IntakeEntry {
+    uint64_t sequence;       // order of arrival
+    TaskPriority priority;
+};
+
+// Which of the waiting tickets goes next (an index into `waiting`, which must
+// not be empty), given how many interactive tickets have gone ahead of
+// waiting background ones since the last background ticket went.
+size_t pickNextEntry(const std::vector<IntakeEntry>& waiting, unsigned bypassed);
+
+class IntakeLock;
+
+class TaskIntake {
+public:
+    explicit TaskIntake(const std::string& directory);
+    ~TaskIntake();
+    // CRYPTION_INTAKE, or "cryption-intake" in the temporary directory.
+    static std::string defaultDirectory();
+
+    // Leaves a ticket. Returns false (and the caller runs without the
+    // intake) if the directory cannot be used.
+    bool join(TaskPriority priority);
+    // Blocks until this ticket's turn, then holds the slot until leave().
+    void waitTurn();
+    void leave();
+
+private:
+    bool lockState();
+    std::vector<IntakeEntry> waitingTickets();
+    void readState(uint64_t& next, unsigned& bypassed);
+    void writeState(uint64_t next, unsigned bypassed);
+
+    std::string directory;
+    std::string ticketPath;
+    IntakeEntry own{0, TaskPriority::INTERACTIVE};
+    std::unique_ptr<IntakeLock> state;    // guards the directory while it is read or changed
+    std::unique_ptr<IntakeLock> ticket;
+    std::unique_ptr<IntakeLock> slot;
+};
+
+#endif
@@ -1,9 +1,190 @@
 #include <iostream>
 #include "ProcessManagement.hpp"
+#ifdef _WIN32
 #include <windows.h>  // Windows process API
+#else
+#include <spawn.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+extern char** environ;
+#endif
 #include <memory>
 #include <queue>
+#include <vector>
+#include <filesystem>
+#include <thread>
 #include "../encryptDecrypt/Cryption.hpp"
+#include "../tracing/Trace.hpp"
+
+namespace {
+
+#ifdef _WIN32
+
+// Starts cryption.exe with `args`, writes the task key (if any) to its
+// standard input and waits for it. Returns false if it could not be started.
+bool runWorker(const std::vector<std::string>& args, const TaskKey* taskKey, bool background,
+               const std::string& filePath, int& exitStatus) {
+    // Build the command line: cryption.exe "taskDataString" [--key-stdin] [--journal "file"]
+    std::string command = "cryption.exe";
+    for (const std::string& arg : args) {
+        command += arg.compare(0, 2, "--") == 0 ? " " + arg : " \"" + arg + "\"";
+    }
+
+    // Covers process startup and teardown as well as the worker's own stages
+    TraceSpan span("spawn", filePath);
+
+    // Convert to LPSTR
+    STARTUPINFOA si{};
+    PROCESS_INFORMATION pi{};
+    si.cb = sizeof(si);
+
+    // A derived key goes to the worker through a pipe on its standard
+    // input, so it never shows up in the process list.
+    HANDLE keyRead = NULL, keyWrite = NULL;
+    if (taskKey) {
+        SECURITY_ATTRIBUTES sa{sizeof(sa), NULL, TRUE};
+        if (!CreatePipe(&keyRead, &keyWrite, &sa, 0)) {
+            std::cerr << "CreatePipe failed (" << GetLastError() << ").\n";
+            return false;
+        }
+        SetHandleInformation(keyWrite, HANDLE_FLAG_INHERIT, 0);
+        si.dwFlags |= STARTF_USESTDHANDLES;
+        si.hStdInput = keyRead;
+        si.hStdOutput = GetStdHandle(STD_OUTPUT_HANDLE);
+        si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+    }
+
+    // Sized to the command, which can be long with a journal path
+    std::vector<char> cmdLine(command.begin(), command.end());
+    cmdLine.push_back('\0');
+
+    BOOL started = CreateProcessA(
+        NULL,
+        cmdLine.data(),
+        NULL,
+        NULL,
+        taskKey ? TRUE : FALSE,
+        background ? BELOW_NORMAL_PRIORITY_CLASS : 0,
+        NULL,
+        NULL,
+        &si,
+        &pi);
+    if (taskKey) {
+        CloseHandle(keyRead);
+        if (started) {
+            DWORD written = 0;
+            WriteFile(keyWrite, taskKey->header, KDF_HEADER_LENGTH, &written, NULL);
+            WriteFile(keyWrite, taskKey->key, AES_KEY_LENGTH, &written, NULL);
+        }
+        CloseHandle(keyWrite);
+    }
+    if (!started) {
+        std::cerr << "CreateProcess failed (" << GetLastError() << ").\n";
+        return false;
+    }
+    traceAddWorker(pi.dwProcessId);
+
+    // Wait for child process to finish
+    WaitForSingleObject(pi.hProcess, INFINITE);
+    DWORD exitCode = 1;
+    if (!GetExitCodeProcess(pi.hProcess, &exitCode)) exitCode = 1;
+    exitStatus = (int)exitCode;
+
+    // Close process and thread handles
+    CloseHandle(pi.hProcess);
+    CloseHandle(pi.hThread);
+    return true;
+}
+
+#else
+
+// CreateProcess finds cryption.exe next to encrypt_decrypt (LockFS runs it
+// from its own directory); look there first as well, then in the current
+// directory.
+std::string workerPath() {
+    std::error_code ec;
+    std::filesystem::path self = std::filesystem::read_symlink("/proc/self/exe", ec);
+    if (!ec) {
+        std::filesystem::path beside = self.parent_path() / "cryption.exe";
+        if (std::filesystem::exists(beside, ec)) return beside.string();
+    }
+    return "./cryption.exe";
+}
+
+bool writeAll(int fd, const unsigned char* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+// Same as the Windows version, with posix_spawn; background workers get a
+// nice value of 10, the counterpart of BELOW_NORMAL_PRIORITY_CLASS.
+bool runWorker(const std::vector<std::string>& args, const TaskKey* taskKey, bool background,
+               const std::string& filePath, int& exitStatus) {
+    static const std::string program = workerPath();
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>(program.c_str()));
+    for (const std::string& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+
+    // Covers process startup and teardown as well as the worker's own stages
+    TraceSpan span("spawn", filePath);
+
+    // A derived key goes to the worker through a pipe on its standard
+    // input, so it never shows up in the process list.
+    int keyPipe[2] = {-1, -1};
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (taskKey) {
+        if (pipe(keyPipe) != 0) {
+            std::cerr << "pipe failed (" << strerror(errno) << ").\n";
+            posix_spawn_file_actions_destroy(&actions);
+            return false;
+        }
+        posix_spawn_file_actions_adddup2(&actions, keyPipe[0], STDIN_FILENO);
+        posix_spawn_file_actions_addclose(&actions, keyPipe[0]);
+        posix_spawn_file_actions_addclose(&actions, keyPipe[1]);
+    }
+
+    pid_t pid;
+    int error = posix_spawn(&pid, program.c_str(), &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (taskKey) {
+        close(keyPipe[0]);
+        if (error == 0) {
+            // A worker that exits without reading must not take us down with SIGPIPE
+            signal(SIGPIPE, SIG_IGN);
+            writeAll(keyPipe[1], taskKey->header, KDF_HEADER_LENGTH);
+            writeAll(keyPipe[1], taskKey->key, AES_KEY_LENGTH);
+        }
+        close(keyPipe[1]);
+    }
+    if (error != 0) {
+        std::cerr << "posix_spawn " << program << " failed (" << strerror(error) << ").\n";
+        return false;
+    }
+    if (background) setpriority(PRIO_PROCESS, pid, 10);
+    traceAddWorker((unsigned long)pid);
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    exitStatus = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+    return true;
+}
+
+#endif
+
+}
 
 ProcessManagement::ProcessManagement() {}
 
@@ -12,45 +193,63 @@ bool ProcessManagement::submitToQueue(std::unique_ptr<Task> task) {
     return true;
 }
 
-void ProcessManagement::executeTasks() {
+// Paces background work to the configured rate by the size of the files
+// started, which each worker reads and writes back once.
+void ProcessManagement::throttleBackground(const std::string& filePath) {
+    if (backgroundBytesPerSecond == 0) return;
+    auto now = std::chrono::steady_clock::now();
+    if (backgroundStart == std::chrono::steady_clock::time_point()) backgroundStart = now;
+    auto due = backgroundStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                     std::chrono::duration<double>((double)backgroundBytes / backgroundBytesPerSecond));
+    if (due > now) {
+        TraceSpan span("throttle", filePath);
+        std::this_thread::sleep_until(due);
+    }
+    std::error_code ec;
+    uintmax_t size = std::filesystem::file_size(filePath, ec);
+    if (!ec) backgroundBytes += size;
+}
+
+int ProcessManagement::executeTasks() {
+    int failed = 0;
     while (!taskQueue.empty()) {
         std::unique_ptr<Task> taskToExecute = std::move(taskQueue.front());
         taskQueue.pop();
+        bool background = taskToExecute->priority == TaskPriority::BACKGROUND;
+        if (background) throttleBackground(taskToExecute->filePath);
 
         std::string taskStr = taskToExecute->toString();
         std::cout << "Executing task: " << taskStr << std::endl;
 
-        // Build the command line: cryption.exe "taskDataString"
-        std::string command = "cryption.exe \"" + taskStr + "\"";
-
-        // Convert to LPSTR
-        STARTUPINFOA si{};
-        PROCESS_INFORMATION pi{};
-        si.cb = sizeof(si);
-
-        char cmdLine[1024];
-        strncpy_s(cmdLine, command.c_str(), sizeof(cmdLine) - 1);
-
-        if (!CreateProcessA(
-            NULL,
-            cmdLine,
-            NULL,
-            NULL,
-            FALSE,
-            0,
-            NULL,
-            NULL,
-            &si,
-            &pi)) {
-            std::cerr << "CreateProcess failed (" << GetLastError() << ").\n";
-            continue;
+        const TaskKey* taskKey = taskToExecute->key.get();
+        std::vector<std::string> args = {taskStr};
+        if (taskKey) args.push_back("--key-stdin");
+        if (!journalPath.empty()) {
+            args.push_back("--journal");
+            args.push_back(journalPath);
         }
 
-        // Wait for child process to finish
-        WaitForSingleObject(pi.hProcess, INFINITE);
-
-        // Close process and thread handles
-        CloseHandle(pi.hProcess);
-        CloseHandle(pi.hThread);
+        // Waits here while other encrypt_decrypt processes run their workers
+        // and, for background work, while interactive work is waiting.
+        bool admitted = false;
+        if (intake) {
+            TraceSpan span("intake", taskToExecute->filePath);
+            admitted = intake->join(taskToExecute->priority);
+            if (admitted) intake->waitTurn();
+        }
+        int exitCode = 1;
+        bool started = runWorker(args, taskKey, background, taskToExecute->filePath, exitCode);
+        if (admitted) intake->leave();
+        if (!started) {
+            ++failed;
+            continue;
+        }
+        if (exitCode != 0) {
+            std::cout << "Failed: " << taskToExecute->filePath << " (worker exited with code " << exitCode << ")"
+                      << std::endl;
+            ++failed;
+            if (exitCode == CRYPTION_EXIT_REJECTED) ++rejected;
+        }
     }
+    return failed;
 }
@@ -2,18 +2,46 @@
 #define PROCESS_MANAGEMENT_HPP
 
 #include "Task.hpp"
+#include "Intake.hpp"
 #include <queue>
 #include <memory>
+#include <chrono>
+#include <cstdint>
 
+// Runs queued tasks one worker process at a time, in order. All tasks of a
+// run share one priority; interactive work (LockFS opening or saving a file)
+// comes from separate encrypt_decrypt processes, and with an intake set each
+// worker first waits for its turn there (see Intake.hpp), which puts waiting
+// interactive tasks of any process ahead of background ones. Background
+// workers also run at below-normal CPU priority and, with a background limit
+// set, are started no faster than that many bytes of files per second.
 class ProcessManagement
 {
 public:
     ProcessManagement();
     bool submitToQueue(std::unique_ptr<Task> task);
-    void executeTasks();
+    // Workers record each file they finish in this job journal.
+    void setJournal(const std::string& path) { journalPath = path; }
+    // Workers wait for their turn in the intake in `directory`.
+    void setIntake(const std::string& directory) { intake.reset(new TaskIntake(directory)); }
+    // 0 (the default) leaves background tasks unthrottled.
+    void setBackgroundLimit(uint64_t bytesPerSecond) { backgroundBytesPerSecond = bytesPerSecond; }
+    // Returns the number of tasks whose worker could not be started or
+    // exited with an error.
+    int executeTasks();
+    // How many of those the worker refused (CRYPTION_EXIT_REJECTED).
+    int rejectedTasks() const { return rejected; }
 
 private:
+    void throttleBackground(const std::string& filePath);
+
     std::queue<std::unique_ptr<Task>> taskQueue;
+    std::string journalPath;
+    std::unique_ptr<TaskIntake> intake;
+    uint64_t backgroundBytesPerSecond = 0;
+    uint64_t backgroundBytes = 0;        // started so far, for the pacing
+    int rejected = 0;
+    std::chrono::steady_clock::time_point backgroundStart;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,7 +1,9 @@
 #ifndef TASK_HPP
 #define TASK_HPP
 #include "../fileHandling/IO.hpp"
+#include "../encryptDecrypt/KeyDerivation.hpp"
 #include <fstream>
+#include <memory>
 #include <string>
 #include <sstream>
 
@@ -10,10 +12,20 @@ enum class Action {
     DECRYPT
 };
 
+// Interactive tasks are single files someone is waiting on (LockFS opening or
+// saving a file); background tasks are bulk jobs such as a whole directory.
+// See ProcessManagement for how background workers are held back.
+enum class TaskPriority {
+    INTERACTIVE,
+    BACKGROUND
+};
+
 struct Task {
     std::string filePath;
     std::fstream f_stream;
     Action action;
+    std::shared_ptr<const TaskKey> key;   // set for password-protected files, null for the legacy .env key
+    TaskPriority priority = TaskPriority::INTERACTIVE;
 
     Task(std::fstream&& stream, Action act, std::string filePath) : f_stream(std::move(stream)), action(act), filePath(filePath) {}
 
@@ -0,0 +1,213 @@
+#include "Trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+struct TraceEvent {
+    std::string stage;
+    std::string file;
+    uint64_t start;
+    uint64_t dur;
+    uint64_t bytes;
+    unsigned long pid;
+    unsigned long tid;
+};
+
+std::mutex traceMutex;
+std::vector<TraceEvent> events;
+std::vector<unsigned long> workers;
+
+const char* tracePath() {
+    const char* path = std::getenv("CRYPTION_TRACE");
+    return (path && *path) ? path : nullptr;
+}
+
+std::string partPath(unsigned long pid) {
+    return std::string(tracePath()) + "." + std::to_string(pid) + ".part";
+}
+
+// Small per-process thread number, so the viewer gets one row per thread.
+unsigned long threadTag() {
+    static std::mutex tagMutex;
+    static std::map<std::thread::id, unsigned long> tags;
+    std::lock_guard<std::mutex> lock(tagMutex);
+    auto it = tags.find(std::this_thread::get_id());
+    if (it != tags.end()) return it->second;
+    unsigned long tag = tags.size() + 1;
+    tags[std::this_thread::get_id()] = tag;
+    return tag;
+}
+
+std::string jsonEscape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+// Part files hold one tab-separated event per line.
+void writeEvent(std::ostream& out, const TraceEvent& e) {
+    out << e.stage << '\t' << e.start << '\t' << e.dur << '\t' << e.bytes << '\t'
+        << e.pid << '\t' << e.tid << '\t' << e.file << '\n';
+}
+
+bool readEvent(const std::string& line, TraceEvent& e) {
+    std::istringstream iss(line);
+    if (!std::getline(iss, e.stage, '\t')) return false;
+    if (!(iss >> e.start >> e.dur >> e.bytes >> e.pid >> e.tid)) return false;
+    iss.get();
+    std::getline(iss, e.file);
+    return true;
+}
+
+}
+
+bool traceEnabled() {
+    static const bool enabled = tracePath() != nullptr;
+    return enabled;
+}
+
+uint64_t traceNowUs() {
+    // steady_clock is system-wide, so spans from different processes line up.
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void traceRecord(const std::string& stage, const std::string& file, uint64_t startUs, uint64_t durUs, uint64_t bytes) {
+    if (!traceEnabled()) return;
+    TraceEvent e{stage, file, startUs, durUs, bytes, (unsigned long)getpid(), threadTag()};
+    std::lock_guard<std::mutex> lock(traceMutex);
+    events.push_back(e);
+}
+
+void traceFlushWorker() {
+    if (!traceEnabled()) return;
+    std::lock_guard<std::mutex> lock(traceMutex);
+    std::ofstream part(partPath(getpid()), std::ios::app);
+    for (const TraceEvent& e : events) writeEvent(part, e);
+    events.clear();
+}
+
+void traceAddWorker(unsigned long pid) {
+    if (!traceEnabled()) return;
+    std::lock_guard<std::mutex> lock(traceMutex);
+    workers.push_back(pid);
+}
+
+void traceWriteReport() {
+    if (!traceEnabled()) return;
+    std::lock_guard<std::mutex> lock(traceMutex);
+
+    for (unsigned long pid : workers) {
+        std::string path = partPath(pid);
+        std::ifstream part(path);
+        std::string line;
+        TraceEvent e;
+        while (std::getline(part, line)) {
+            if (readEvent(line, e)) events.push_back(e);
+        }
+        part.close();
+        std::remove(path.c_str());
+    }
+    if (events.empty()) return;
+
+    uint64_t first = events[0].start, last = 0;
+    for (const TraceEvent& e : events) {
+        first = std::min(first, e.start);
+        last = std::max(last, e.start + e.dur);
+    }
+
+    std::ofstream out(tracePath());
+    out << "{\"traceEvents\":[\n";
+    for (size_t i = 0; i < events.size(); ++i) {
+        const TraceEvent& e = events[i];
+        out << "{\"name\":\"" << e.stage << "\",\"cat\":\"cryption\",\"ph\":\"X\",\"ts\":" << e.start - first
+            << ",\"dur\":" << e.dur << ",\"pid\":" << e.pid << ",\"tid\":" << e.tid
+            << ",\"args\":{\"file\":\"" << jsonEscape(e.file) << "\",\"bytes\":" << e.bytes << "}}"
+            << (i + 1 < events.size() ? ",\n" : "\n");
+    }
+    out << "],\"displayTimeUnit\":\"ms\"}\n";
+    out.close();
+
+    // Per-stage totals, in first-seen order.
+    std::vector<std::string> order;
+    std::map<std::string, uint64_t> calls, micros, bytes;
+    for (const TraceEvent& e : events) {
+        if (!calls.count(e.stage)) order.push_back(e.stage);
+        calls[e.stage]++;
+        micros[e.stage] += e.dur;
+        bytes[e.stage] += e.bytes;
+    }
+
+    double wallMs = (last - first) / 1000.0;
+    std::cout << "\nTrace written to " << tracePath() << " (" << events.size() << " spans, "
+              << workers.size() << " worker process(es))" << std::endl;
+    std::cout << std::left << std::setw(10) << "stage" << std::right << std::setw(8) << "calls"
+              << std::setw(12) << "total ms" << std::setw(10) << "% wall" << std::setw(12) << "MB/s" << std::endl;
+    std::ios::fmtflags flags = std::cout.flags();
+    std::streamsize precision = std::cout.precision();
+    std::cout << std::fixed << std::setprecision(2);
+    for (const std::string& stage : order) {
+        double ms = micros[stage] / 1000.0;
+        std::cout << std::left << std::setw(10) << stage << std::right << std::setw(8) << calls[stage]
+                  << std::setw(12) << ms << std::setw(10) << (wallMs > 0 ? 100.0 * ms / wallMs : 0.0);
+        if (bytes[stage] && micros[stage]) {
+            std::cout << std::setw(12) << bytes[stage] / (double)micros[stage];
+        } else {
+            std::cout << std::setw(12) << "-";
+        }
+        std::cout << std::endl;
+    }
+    if (calls.count("spawn")) {
+        // Process start/exit cost: spawn time not accounted for by worker stages.
+        uint64_t workerUs = 0;
+        unsigned long self = getpid();
+        for (const TraceEvent& e : events) {
+            if (e.pid != self) workerUs += e.dur;
+        }
+        double overheadMs = micros["spawn"] > workerUs ? (micros["spawn"] - workerUs) / 1000.0 : 0.0;
+        std::cout << "per-file overhead " << overheadMs << " ms (" << overheadMs / calls["spawn"] << " ms/file)" << std::endl;
+    }
+    std::cout << "wall " << wallMs << " ms";
+    if (bytes.count("read") && wallMs > 0) {
+        std::cout << ", " << bytes["read"] / (wallMs * 1000.0) << " MB/s end to end";
+    }
+    std::cout << std::endl;
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+    events.clear();
+}
+
+TraceSpan::TraceSpan(const char* stage, const std::string& file)
+    : stage(stage), file(traceEnabled() ? file : std::string()), start(traceEnabled() ? traceNowUs() : 0), bytes(0) {}
+
+TraceSpan::~TraceSpan() {
+    if (traceEnabled()) traceRecord(stage, file, start, traceNowUs() - start, bytes);
+}
@@ -0,0 +1,38 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <string>
+#include <cstdint>
+
+// Optional stage tracing, switched on by setting CRYPTION_TRACE to an output
+// path. Each cryption worker process records its spans to
+// "<path>.<pid>.part"; the parent merges those with its own spans into a
+// Chrome/Perfetto trace (chrome://tracing, ui.perfetto.dev) and prints time
+// per stage plus throughput.
+
+bool traceEnabled();
+uint64_t traceNowUs();
+void traceRecord(const std::string& stage, const std::string& file, uint64_t startUs, uint64_t durUs, uint64_t bytes);
+
+// Worker side: write this process's spans to its part file.
+void traceFlushWorker();
+
+// Parent side: remember a spawned worker, then merge everything at the end.
+void traceAddWorker(unsigned long pid);
+void traceWriteReport();
+
+// Records the enclosing scope as one span.
+class TraceSpan {
+public:
+    TraceSpan(const char* stage, const std::string& file);
+    ~TraceSpan();
+    void setBytes(uint64_t n) { bytes = n; }
+
+private:
+    const char* stage;
+    std::string file;
+    uint64_t start;
+    uint64_t bytes;
+};
+
+#endif
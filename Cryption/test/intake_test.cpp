@@ -0,0 +1,91 @@
+// Checks the task intake (src/app/processes/Intake.hpp) with one thread per
+// simulated encrypt_decrypt process, each with its own TaskIntake: waiting
+// interactive tickets go before background tickets that arrived earlier, and
+// a waiting background ticket still goes after INTAKE_INTERACTIVE_BURST
+// interactive ones. Run with make test.
+#include "Intake.hpp"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what) {
+    std::cout << (ok ? "ok      " : "FAILED  ") << what << std::endl;
+    if (!ok) ++failures;
+}
+
+static std::string join(const std::vector<std::string>& names) {
+    std::string out;
+    for (const std::string& name : names) out += (out.empty() ? "" : " ") + name;
+    return out;
+}
+
+// Queues `tickets` (name, priority) in that order while another process holds
+// the slot, then lets them run and returns the order in which they got it.
+static std::vector<std::string> runOrder(const std::string& dir,
+                                         const std::vector<std::pair<std::string, TaskPriority>>& tickets) {
+    TaskIntake holder(dir);
+    holder.join(TaskPriority::INTERACTIVE);
+    holder.waitTurn();
+
+    std::vector<std::unique_ptr<TaskIntake>> intakes;
+    for (const auto& ticket : tickets) {
+        intakes.emplace_back(new TaskIntake(dir));
+        intakes.back()->join(ticket.second);
+    }
+    std::mutex mutex;
+    std::vector<std::string> order;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < tickets.size(); ++i) {
+        threads.emplace_back([&, i] {
+            intakes[i]->waitTurn();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                order.push_back(tickets[i].first);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            intakes[i]->leave();
+        });
+    }
+    // Give every thread time to start waiting before the slot frees up.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    holder.leave();
+    for (std::thread& thread : threads) thread.join();
+    return order;
+}
+
+int main() {
+    fs::path dir = fs::temp_directory_path() / "cryption_intake_test";
+    fs::remove_all(dir);
+    const TaskPriority I = TaskPriority::INTERACTIVE, B = TaskPriority::BACKGROUND;
+
+    std::vector<std::string> order = runOrder(dir.string(), {{"b1", B}, {"b2", B}, {"i1", I}, {"i2", I}});
+    check(join(order) == "i1 i2 b1 b2", "interactive tickets go before earlier background ones: " + join(order));
+
+    order = runOrder(dir.string(), {{"b1", B}, {"b2", B}, {"b3", B}, {"i1", I}, {"i2", I}, {"i3", I},
+                                    {"i4", I}, {"i5", I}, {"i6", I}});
+    check(join(order) == "i1 i2 i3 i4 b1 i5 i6 b2 b3",
+          "a background ticket goes after " + std::to_string(INTAKE_INTERACTIVE_BURST) +
+              " interactive ones: " + join(order));
+
+    // A process that died while waiting leaves its ticket file, unlocked;
+    // it must not hold anybody up.
+    std::ofstream(dir / "00000000000000000000-i.ticket");
+    order = runOrder(dir.string(), {{"b1", B}});
+    check(join(order) == "b1", "an abandoned ticket is skipped: " + join(order));
+
+    check(pickNextEntry({{7, B}}, INTAKE_INTERACTIVE_BURST + 5) == 0, "a lone ticket goes whatever the count");
+
+    fs::remove_all(dir);
+    std::cout << (failures ? "intake_test: FAILED" : "intake_test: all checks passed") << std::endl;
+    return failures ? 1 : 0;
+}
@@ -2,7 +2,7 @@ const { app, BrowserWindow, ipcMain, dialog } = require('electron');
 const path = require('path');
 const fs = require('fs-extra');
 const bcrypt = require('bcryptjs');
-const { exec } = require('child_process');
+const { exec, execFile } = require('child_process');
 const { promisify } = require('util');
 const execAsync = promisify(exec);
 
@@ -90,54 +90,93 @@ async function executeEncryptDecrypt(filename, operation, password = '') {
   }
 }
 
-// Helper function to execute VFS operations (for show only)
-async function executeVFSCommand(command) {
-  const vfsPath = path.join('..', 'VFS', './vfs');
-  const fullCommand = `"${vfsPath}" ${command}`;
-  
-  try {
-    console.log(`Executing VFS: ${fullCommand}`);
-    const { stdout, stderr } = await execAsync(fullCommand, { 
-      cwd: path.join('..', 'VFS'),
-      timeout: 30000 // 30 second timeout
-    });
-    console.log(`VFS output: ${stdout}`);
-    if (stderr) console.log(`VFS stderr: ${stderr}`);
-    return { success: true, output: stdout, error: stderr };
-  } catch (error) {
-    console.error(`VFS command failed: ${error.message}`);
-    return { success: false, error: error.message };
-  }
+// Ordinary files live only in the VFS, which encrypts every block under a
+// per-file key, so saving one is a single VFS write. Password-protected files
+// need a key from their password: Cryption encrypts them into saved/, and
+// they are not kept in the VFS.
+const VFS_DIR = path.join(__dirname, '..', 'VFS');
+const VFS_PROGRAM = path.join(VFS_DIR, 'vfs.exe');
+
+// Every vfs run loads the image, changes it and saves it again, so runs that
+// overlapped would lose each other's changes; they are queued here.
+let vfsQueue = Promise.resolve();
+
+function executeVFSCommand(args, input = '') {
+  const run = () => new Promise((resolve) => {
+    console.log(`Executing VFS: vfs ${args.join(' ')}`);
+    const child = execFile(VFS_PROGRAM, args, { cwd: VFS_DIR, timeout: 30000, maxBuffer: 64 * 1024 * 1024 },
+      (error, stdout, stderr) => {
+        if (stderr) console.log(`VFS stderr: ${stderr}`);
+        // Single commands exit with 0 and print "Error: ..." when they fail;
+        // a failed batch exits with 1 and prints the per-operation results.
+        const failure = stdout.startsWith('Error:') ? stdout.trim() : error ? (stdout.trim() || error.message) : null;
+        if (failure) console.error(`VFS command failed: ${failure}`);
+        resolve({ success: !failure, output: stdout, error: failure || stderr });
+      });
+    // Commands other than batch exit without reading their input
+    child.stdin.on('error', () => {});
+    child.stdin.end(input);
+  });
+  const result = vfsQueue.then(run);
+  vfsQueue = result;
+  return result;
 }
 
-// VFS-specific helper functions (for show only)
-async function vfsCreateFile(filename) {
-  return await executeVFSCommand(`create "${filename}"`);
+// Same quoting as QuoteBatchWord in VFS/vfs_batch.cpp.
+function quoteBatchWord(word) {
+  if (word !== '' && !/[ \t\r\n"\\]/.test(word)) return word;
+  return '"' + word.replace(/["\\]/g, '\\$&').replace(/\n/g, '\\n').replace(/\t/g, '\\t') + '"';
 }
 
-async function vfsWriteFile(filename, content) {
-  // Escape quotes in content for command line
-  const escapedContent = content.replace(/"/g, '\\"').replace(/\n/g, '\\n').replace(/\r/g, '\\r');
-  return await executeVFSCommand(`write "${filename}" "${escapedContent}"`);
+// Replaces the file's content; with `create` the file is created first, in
+// the same all-or-nothing batch. Content goes through standard input, so
+// neither its size nor its characters are limited by the command line.
+async function vfsWriteFile(filename, content, create = false) {
+  let script = '';
+  if (create) script += `create ${quoteBatchWord(filename)}\n`;
+  script += `write ${quoteBatchWord(filename)} ${quoteBatchWord(content)}\n`;
+  return await executeVFSCommand(['batch'], script);
 }
 
 async function vfsReadFile(filename) {
-  return await executeVFSCommand(`read "${filename}"`);
+  const result = await executeVFSCommand(['read', filename]);
+  if (!result.success) return result;
+  // read prints "Content: <content>" and a newline
+  return { success: true, content: result.output.slice('Content: '.length).replace(/\r?\n$/, '') };
 }
 
 async function vfsDeleteFile(filename) {
-  return await executeVFSCommand(`delete "${filename}"`);
+  return await executeVFSCommand(['delete', filename]);
 }
 
 async function vfsListFiles() {
-  return await executeVFSCommand(`ls`);
+  return await executeVFSCommand(['ls']);
+}
+
+function savedPath(filename) {
+  return path.join(__dirname, 'saved', filename);
+}
+
+// Writes an ordinary file to the VFS, creating it there if need be. A copy
+// left in saved/ from before the VFS held the files is removed once the VFS
+// has the content.
+async function storeFile(filename, content) {
+  let result = await vfsWriteFile(filename, content);
+  if (!result.success && /File not found/.test(result.error)) result = await vfsWriteFile(filename, content, true);
+  if (result.success && fs.existsSync(savedPath(filename))) fs.unlinkSync(savedPath(filename));
+  return result;
 }
 
-async function vfsUpdateFile(filename, oldText, newText) {
-  // Escape quotes for command line
-  const escapedOldText = oldText.replace(/"/g, '\\"').replace(/\n/g, '\\n').replace(/\r/g, '\\r');
-  const escapedNewText = newText.replace(/"/g, '\\"').replace(/\n/g, '\\n').replace(/\r/g, '\\r');
-  return await executeVFSCommand(`update "${filename}" "${escapedOldText}" "${escapedNewText}"`);
+// Reads an ordinary file. One still in saved/ (encrypted by Cryption with the
+// .env key; its VFS copy of those days was only for show) is moved into the
+// VFS on the way.
+async function loadFile(filename) {
+  if (!fs.existsSync(savedPath(filename))) return await vfsReadFile(filename);
+  const saved = await decryptAndReadFile(filename, '');
+  if (!saved.success) return saved;
+  const stored = await storeFile(filename, saved.content);
+  if (!stored.success) console.log(`Warning: Could not move ${filename} into the VFS: ${stored.error}`);
+  return saved;
 }
 
 // Helper function to encrypt file content and save to disk
@@ -260,7 +299,7 @@ ipcMain.handle('navigate', (_, page) => {
   win.loadFile(`renderer/${page}`);
 });
 
-// Upload file handler - Store with encryption always
+// Upload file handler - Store in the VFS, which encrypts it
 ipcMain.handle('upload-file', async () => {
   const { canceled, filePaths } = await dialog.showOpenDialog({ properties: ['openFile'] });
   if (canceled || filePaths.length === 0) return { success: false };
@@ -269,21 +308,10 @@ ipcMain.handle('upload-file', async () => {
   const filename = path.basename(file);
   const content = fs.readFileSync(file, 'utf8');
   
-  // Always encrypt files when saving (using default empty password for non-protected)
-  const encryptResult = await encryptAndSaveFile(filename, content, '');
-  if (!encryptResult.success) {
-    return { success: false, msg: 'Error encrypting and saving file: ' + encryptResult.error };
-  }
-  
-  // Store original content in VFS for demonstration (always plain text)
-  const createResult = await vfsCreateFile(filename);
-  if (!createResult.success) {
-    return { success: false, msg: 'Error creating file in VFS: ' + createResult.error };
-  }
-  
-  const writeResult = await vfsWriteFile(filename, content);
+  // The VFS encrypts the file as it stores it
+  const writeResult = await vfsWriteFile(filename, content, true);
   if (!writeResult.success) {
-    console.log('Warning: VFS write failed, but local storage succeeded');
+    return { success: false, msg: 'Error storing file in VFS: ' + writeResult.error };
   }
   
   // Update user files and metadata
@@ -306,25 +334,13 @@ ipcMain.handle('upload-file', async () => {
   return { success: true };
 });
 
-// Create file handler - Store with encryption always
+// Create file handler - Store in the VFS, which encrypts it
 ipcMain.handle('createFile', async (_, filename, content) => {
   try {
-    // Always encrypt files when saving (using default empty password for non-protected)
-    const encryptResult = await encryptAndSaveFile(filename, content, '');
-    if (!encryptResult.success) {
-      return { success: false, msg: 'Error encrypting and saving file: ' + encryptResult.error };
-    }
-    
-    // Create file in VFS for demonstration (always plain text)
-    const createResult = await vfsCreateFile(filename);
-    if (!createResult.success) {
-      return { success: false, msg: 'Error creating file in VFS: ' + createResult.error };
-    }
-    
-    // Write original content to VFS
-    const writeResult = await vfsWriteFile(filename, content);
+    // The VFS encrypts the file as it stores it
+    const writeResult = await vfsWriteFile(filename, content, true);
     if (!writeResult.success) {
-      console.log('Warning: VFS write failed, but local storage succeeded');
+      return { success: false, msg: 'Error storing file in VFS: ' + writeResult.error };
     }
     
     // Update metadata and user files
@@ -350,57 +366,39 @@ ipcMain.handle('createFile', async (_, filename, content) => {
   }
 });
 
-// List files handler with VFS integration
+// List files handler - sizes of ordinary files come from the VFS, protected
+// files are only in saved/
 ipcMain.handle('listFiles', async () => {
   const userFileList = userFiles[currentUser] || [];
   
-  // Get files from VFS (for show)
   const vfsListResult = await vfsListFiles();
   if (!vfsListResult.success) {
     return { success: false, msg: 'Error listing VFS files: ' + vfsListResult.error };
   }
   
-  // Parse VFS output to get file info
-  const vfsFiles = [];
+  // Parse VFS output to get file sizes
+  const vfsSizes = {};
   const lines = vfsListResult.output.split('\n');
   for (const line of lines) {
-    if (line.trim() && line.includes('(size:')) {
-      const match = line.match(/^(.+?)\s+\(size:\s+(\d+),\s+cursor:\s+(\d+)\)$/);
-      if (match) {
-        const [, name, size, cursor] = match;
-        const fileName = name.trim();
-        if (userFileList.includes(fileName)) {
-          vfsFiles.push({
-            name: fileName,
-            size: parseInt(size),
-            protected: fileMetadata[fileName]?.protected || false,
-            date: fileMetadata[fileName]?.uploadedAt || new Date(),
-            createdAt: fileMetadata[fileName]?.createdAt || new Date(),
-            owner: fileMetadata[fileName]?.owner || currentUser,
-            storedInVFS: true
-          });
-        }
-      }
-    }
+    const match = line.match(/^(.+?)\s+\(size:\s+(\d+),\s+cursor:\s+(\d+)\)/);
+    if (match) vfsSizes[match[1].trim()] = parseInt(match[2]);
   }
   
-  // If no files found in VFS output but user has files, return from metadata
-  if (vfsFiles.length === 0 && userFileList.length > 0) {
-    return userFileList.map(filename => ({
+  return userFileList.map(filename => {
+    const isProtected = fileMetadata[filename]?.protected || false;
+    return {
       name: filename,
-      size: fileMetadata[filename]?.size || 0,
-      protected: fileMetadata[filename]?.protected || false,
+      size: !isProtected && filename in vfsSizes ? vfsSizes[filename] : fileMetadata[filename]?.size || 0,
+      protected: isProtected,
       date: fileMetadata[filename]?.uploadedAt || new Date(),
       createdAt: fileMetadata[filename]?.createdAt || new Date(),
       owner: fileMetadata[filename]?.owner || currentUser,
-      storedInVFS: true
-    }));
-  }
-  
-  return vfsFiles;
+      storedInVFS: !isProtected
+    };
+  });
 });
 
-// Delete file handler with VFS integration - Delete from both locations
+// Delete file handler - Delete from the VFS and from saved/
 ipcMain.handle('deleteFile', async (_, filename) => {
   const userFileList = userFiles[currentUser] || [];
   if (!userFileList.includes(filename)) {
@@ -408,16 +406,15 @@ ipcMain.handle('deleteFile', async (_, filename) => {
   }
   
   try {
-    // Delete from local storage
-    const localFilePath = path.join(__dirname, 'saved', filename);
+    // Protected files, and files from before the VFS held them, are in saved/
+    const localFilePath = savedPath(filename);
     if (fs.existsSync(localFilePath)) {
       fs.unlinkSync(localFilePath);
     }
     
-    // Delete from VFS (for show)
     const vfsDeleteResult = await vfsDeleteFile(filename);
-    if (!vfsDeleteResult.success) {
-      console.log('Warning: Failed to delete from VFS, but local deletion succeeded');
+    if (!vfsDeleteResult.success && !/File not found/.test(vfsDeleteResult.error)) {
+      return { success: false, msg: 'Error deleting file from VFS: ' + vfsDeleteResult.error };
     }
     
     // Update user files and metadata
@@ -435,7 +432,8 @@ ipcMain.handle('deleteFile', async (_, filename) => {
   }
 });
 
-// Get file content handler - Always decrypt from saved folder
+// Get file content handler - Ordinary files from the VFS, protected ones
+// decrypted from saved/
 ipcMain.handle('get-file-content', async (_, filename, password = null) => {
   const userFileList = userFiles[currentUser] || [];
   if (!userFileList.includes(filename)) {
@@ -463,20 +461,19 @@ ipcMain.handle('get-file-content', async (_, filename, password = null) => {
       
       return { success: true, content: decryptResult.content, encrypted: false };
     } else {
-      // For non-protected files, decrypt using empty password
-      const decryptResult = await decryptAndReadFile(filename, '');
-      if (!decryptResult.success) {
-        return { success: false, msg: 'Error decrypting file: ' + decryptResult.error };
+      const readResult = await loadFile(filename);
+      if (!readResult.success) {
+        return { success: false, msg: 'Error reading file: ' + readResult.error };
       }
       
-      return { success: true, content: decryptResult.content, encrypted: false };
+      return { success: true, content: readResult.content, encrypted: false };
     }
   } catch (err) {
     return { success: false, msg: 'Error reading file: ' + err.message };
   }
 });
 
-// Save file handler - Always encrypt when saving
+// Save file handler - One VFS write, encrypted by the VFS
 ipcMain.handle('save-file', async (_, filename, content) => {
   const userFileList = userFiles[currentUser] || [];
   if (!userFileList.includes(filename)) {
@@ -489,16 +486,9 @@ ipcMain.handle('save-file', async (_, filename, content) => {
   }
 
   try {
-    // Always encrypt when saving (using empty password for non-protected files)
-    const encryptResult = await encryptAndSaveFile(filename, content, '');
-    if (!encryptResult.success) {
-      return { success: false, msg: 'Error encrypting and saving file: ' + encryptResult.error };
-    }
-    
-    // Also update VFS to keep it in sync (for show)
-    const vfsWriteResult = await vfsWriteFile(filename, content);
-    if (!vfsWriteResult.success) {
-      console.log('Warning: Failed to update VFS, but local save succeeded');
+    const writeResult = await storeFile(filename, content);
+    if (!writeResult.success) {
+      return { success: false, msg: 'Error saving file in VFS: ' + writeResult.error };
     }
     
     // Update metadata
@@ -535,12 +525,6 @@ ipcMain.handle('save-protected-file', async (_, filename, content, password) =>
       return { success: false, msg: 'Error encrypting and saving file: ' + encryptResult.error };
     }
     
-    // Also update VFS to keep it in sync (for show - always plain text)
-    const vfsWriteResult = await vfsWriteFile(filename, content);
-    if (!vfsWriteResult.success) {
-      console.log('Warning: Failed to update VFS, but local save succeeded');
-    }
-    
     // Update file metadata
     if (fileMetadata[filename]) {
       fileMetadata[filename].size = content.length;
@@ -553,8 +537,8 @@ ipcMain.handle('save-protected-file', async (_, filename, content, password) =>
   }
 });
 
-// Protect file handler - Encrypt existing file with password
-// Protect file handler - Encrypt existing file with password
+// Protect file handler - Move the file from the VFS to saved/, encrypted
+// with the password
 ipcMain.handle('protect-file', async (event, filename, password) => {
   const userFileList = userFiles[currentUser] || [];
   if (!userFileList.includes(filename)) {
@@ -567,8 +551,7 @@ ipcMain.handle('protect-file', async (event, filename, password) => {
       return { success: false, msg: 'File is already protected' };
     }
 
-    // First decrypt the file using empty password (since non-protected files use empty password)
-    const decryptResult = await decryptAndReadFile(filename, '');
+    const decryptResult = await loadFile(filename);
     if (!decryptResult.success) {
       return { success: false, msg: 'Error reading file to protect: ' + decryptResult.error };
     }
@@ -579,9 +562,16 @@ ipcMain.handle('protect-file', async (event, filename, password) => {
       return { success: false, msg: 'Error encrypting file: ' + encryptResult.error };
     }
     
+    // The VFS copy is encrypted under the volume key, not the password
+    const vfsDeleteResult = await vfsDeleteFile(filename);
+    if (!vfsDeleteResult.success) {
+      console.log(`Warning: Could not remove ${filename} from the VFS: ${vfsDeleteResult.error}`);
+    }
+    
     // Update metadata to reflect protected status
     if (fileMetadata[filename]) {
       fileMetadata[filename].protected = true;
+      fileMetadata[filename].storedInVFS = false;
       fileMetadata[filename].password = bcrypt.hashSync(password, 10); // Store password hash for verification
       saveFileMetadata(fileMetadata);
     }
@@ -6,22 +6,143 @@
         "vfs_addon.cpp",
         "vfs_disk.cpp",
         "vfs_fileops.cpp",
-        "vfs_utils.cpp"
+        "vfs_utils.cpp",
+        "vfs_crypto.cpp",
+        "vfs_replace.cpp",
+        "vfs_batch.cpp",
+        "vfs_stats.cpp",
+        "vfs_snapshot.cpp",
+        "vfs_compact.cpp",
+        "vfs_checksum.cpp",
+        "vfs_scrub.cpp",
+        "vfs_transfer.cpp",
+        "vfs_xattr.cpp",
+        "vfs_readahead.cpp",
+        "vfs_stripe.cpp",
+        "vfs_index.cpp",
+        "../Cryption/src/app/encryptDecrypt/AES.cpp"
       ],
       "include_dirs": [
         "<!(node -e \"require('nan')\")"
       ],
+      "libraries": ["-lcrypto"],
       "cflags": ["-std=c++11"],
-      "cflags_cc": ["-std=c++11"],
+      "cflags_cc": ["-std=c++17"],
       "conditions": [
         ["OS=='win'", {
+          "include_dirs": ["C:/Program Files/OpenSSL-Win64/include"],
+          "libraries": ["C:/Program Files/OpenSSL-Win64/lib/VC/x64/MD/libcrypto.lib"],
           "msvs_settings": {
             "VCCLCompilerTool": {
-              "AdditionalOptions": ["/std:c++11"]
+              "AdditionalOptions": ["/std:c++17"]
             }
           }
         }]
       ]
+    },
+    {
+      "target_name": "vfs_bench",
+      "type": "executable",
+      "sources": [
+        "vfs_bench.cpp",
+        "vfs_disk.cpp",
+        "vfs_fileops.cpp",
+        "vfs_utils.cpp",
+        "vfs_crypto.cpp",
+        "vfs_replace.cpp",
+        "vfs_batch.cpp",
+        "vfs_stats.cpp",
+        "vfs_snapshot.cpp",
+        "vfs_compact.cpp",
+        "vfs_checksum.cpp",
+        "vfs_scrub.cpp",
+        "vfs_transfer.cpp",
+        "vfs_xattr.cpp",
+        "vfs_readahead.cpp",
+        "vfs_stripe.cpp",
+        "vfs_index.cpp",
+        "vfs_shell.cpp",
+        "../Cryption/src/app/encryptDecrypt/AES.cpp"
+      ],
+      "libraries": ["-lcrypto"],
+      "cflags_cc": ["-std=c++17", "-O2"],
+      "conditions": [
+        ["OS=='win'", {
+          "include_dirs": ["C:/Program Files/OpenSSL-Win64/include"],
+          "libraries": ["C:/Program Files/OpenSSL-Win64/lib/VC/x64/MD/libcrypto.lib"]
+        }]
+      ]
+    },
+    {
+      "target_name": "vfs_test",
+      "type": "executable",
+      "sources": [
+        "vfs_test.cpp",
+        "vfs_disk.cpp",
+        "vfs_fileops.cpp",
+        "vfs_utils.cpp",
+        "vfs_crypto.cpp",
+        "vfs_replace.cpp",
+        "vfs_batch.cpp",
+        "vfs_stats.cpp",
+        "vfs_snapshot.cpp",
+        "vfs_compact.cpp",
+        "vfs_checksum.cpp",
+        "vfs_scrub.cpp",
+        "vfs_transfer.cpp",
+        "vfs_xattr.cpp",
+        "vfs_readahead.cpp",
+        "vfs_stripe.cpp",
+        "vfs_index.cpp",
+        "vfs_shell.cpp",
+        "../Cryption/src/app/encryptDecrypt/AES.cpp"
+      ],
+      "libraries": ["-lcrypto"],
+      "cflags_cc": ["-std=c++17"],
+      "conditions": [
+        ["OS=='win'", {
+          "include_dirs": ["C:/Program Files/OpenSSL-Win64/include"],
+          "libraries": ["C:/Program Files/OpenSSL-Win64/lib/VC/x64/MD/libcrypto.lib"]
+        }]
+      ]
+    },
+    {
+      "target_name": "vfs_load",
+      "type": "executable",
+      "sources": [
+        "vfs_load.cpp",
+        "vfs_disk.cpp",
+        "vfs_fileops.cpp",
+        "vfs_utils.cpp",
+        "vfs_crypto.cpp",
+        "vfs_replace.cpp",
+        "vfs_batch.cpp",
+        "vfs_stats.cpp",
+        "vfs_snapshot.cpp",
+        "vfs_compact.cpp",
+        "vfs_checksum.cpp",
+        "vfs_scrub.cpp",
+        "vfs_transfer.cpp",
+        "vfs_xattr.cpp",
+        "vfs_readahead.cpp",
+        "vfs_stripe.cpp",
+        "vfs_index.cpp",
+        "vfs_shell.cpp",
+        "../Cryption/src/app/encryptDecrypt/AES.cpp",
+        "../Cryption/src/app/encryptDecrypt/Cryption.cpp",
+        "../Cryption/src/app/encryptDecrypt/KeyDerivation.cpp",
+        "../Cryption/src/app/encryptDecrypt/Compression.cpp",
+        "../Cryption/src/app/fileHandling/IO.cpp",
+        "../Cryption/src/app/tracing/Trace.cpp"
+      ],
+      "libraries": ["-lcrypto", "-lz", "-pthread"],
+      "cflags_cc": ["-std=c++17", "-O2"],
+      "conditions": [
+        ["OS=='win'", {
+          "include_dirs": ["C:/Program Files/OpenSSL-Win64/include"],
+          "libraries": ["C:/Program Files/OpenSSL-Win64/lib/VC/x64/MD/libcrypto.lib"]
+        }]
+      ]
     }
   ]
-}
\ No newline at end of file
+}
@@ -2,17 +2,76 @@
 #define INODE_H
 
 #include <string>
+#include <cstdint>
 const int MAX_FILES = 100;
-const int FILE_SIZE = 1024;
-const int DISK_SIZE = MAX_FILES * FILE_SIZE;
+const int BLOCK_SIZE = 1024;
+const int MAX_BLOCKS = 1000;
+const int DISK_SIZE = MAX_BLOCKS * BLOCK_SIZE;
 const std::string DISK_NAME = "vfs_disk.img";
+const std::string KEY_NAME = "vfs.key";
+
+// blockMap entries: index of the next block in a file's chain, or one of these.
+const int BLOCK_END = -1;
+const int BLOCK_FREE = -2;
+const int BLOCK_BAD = -3;       // quarantined by scrub: never used again
+
+// True for the blockMap entry of a block that belongs to a file.
+inline bool InChain(int entry) {
+    return entry >= 0 || entry == BLOCK_END;
+}
+
+const char VFS_MAGIC[8] = "LOCKVFS";
+const int VFS_VERSION = 1;      // 0 is the original layout, without a superblock
+const int XATTR_INLINE = 96;    // bytes of extended attributes kept in the inode itself
+const int INLINE_DATA = 128;    // files up to this size are stored in the inode, not in blocks
+const int MAX_SNAPSHOTS = 8;
+const int MAX_STRIPES = 8;          // files the data blocks can be spread over, the image included
+const int STRIPE_PATH_LENGTH = 240;
+
+// Written at the start of the image so LoadDisk can reject images with a
+// different layout instead of reading them as raw inodes.
+struct SuperBlock {
+    char magic[8];
+    int version;
+    int maxFiles;
+    int blockSize;
+    int maxBlocks;
+};
+
+// Follows the superblock: how the data blocks are spread over the image and
+// further stripe files (see vfs_stripe.h).
+struct StripeLayout {
+    int count;          // 1: every block is in the image
+    int unit;           // consecutive blocks kept in one stripe before moving to the next
+    char paths[MAX_STRIPES][STRIPE_PATH_LENGTH];  // stripe files 1.., absolute or relative to the image
+};
 
 struct Inode {
     char fileName[100];
-    int startBlock;
+    int startBlock;               // first block of the chain, BLOCK_END while empty
     int size;
     int cursor;
     bool used;
+    bool encrypted;
+    unsigned char wrappedKey[40]; // per-file AES-256 key, wrapped by the volume key
+    unsigned char nonce[16];      // AES-CTR nonce for this file's blocks (see vfs_crypto.h)
+    int xattrBlock;               // chain of attributes that did not fit inline, BLOCK_END if none
+    int xattrSize;                // bytes used in that chain
+    unsigned char xattrs[XATTR_INLINE];  // packed attribute records, see vfs_xattr.h
+    bool dataInline;              // contents are in inlineData and startBlock is BLOCK_END
+    unsigned char inlineData[INLINE_DATA];  // encrypted by file offset, like block data
+    uint64_t inlineGeneration;              // write generation inlineData is encrypted under
+};
+
+// A point-in-time copy of the inode table and block map. The data blocks
+// themselves are shared with the live volume; a block referenced by any
+// snapshot is never modified or reused, the live file gets a copy instead.
+struct Snapshot {
+    char name[32];
+    bool used;
+    long long created;            // seconds since the epoch
+    Inode inodes[MAX_FILES];
+    int blockMap[MAX_BLOCKS];
 };
 
 #endif
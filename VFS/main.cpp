@@ -1,8 +1,36 @@
 #include "vfs_shell.h"
 #include "vfs_disk.h"
+#include "vfs_snapshot.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    // Load existing disk data and inodes; an image that cannot be read is
+    // never replaced
+    if (!LoadDisk()) return 1;
+
+    // `vfs --snapshot <name> ...` works on a snapshot, read-only
+    int first = 1;
+    if (argc > 2 && std::string(argv[1]) == "--snapshot") {
+        if (!MountSnapshot(argv[2])) {
+            std::cout << "Error: Snapshot not found.\n";
+            return 1;
+        }
+        first = 3;
+    }
+
+    // With arguments, run a single command (e.g. `vfs readat notes.txt 0 16`)
+    if (argc > first) {
+        std::vector<std::string> args(argv + first, argv + argc);
+        if (args[0] == "stats") {
+            std::cerr << "Note: stats only cover this process; run them in the shell for session totals.\n";
+        }
+        bool ok = RunCommand(args, "");
+        SaveDisk();
+        return ok ? 0 : 1;
+    }
 
-int main() {
-    LoadDisk();     // Load existing disk data and inodes
     Shell();        // Start the shell for user interaction
     SaveDisk();     // Save any final changes before exiting
     return 0;
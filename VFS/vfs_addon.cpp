@@ -4,21 +4,65 @@
 #include "vfs_disk.h"
 #include "vfs_fileops.h"
 #include "vfs_utils.h"
+#include "vfs_replace.h"
+#include "vfs_batch.h"
+#include "vfs_stats.h"
+#include "vfs_snapshot.h"
+#include "vfs_compact.h"
+#include "vfs_scrub.h"
+#include "vfs_transfer.h"
+#include "vfs_xattr.h"
+#include "vfs_readahead.h"
 #include <iostream>
 #include <sstream>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
 
 using namespace v8;
 
-// Initialize VFS
+// Copies a Buffer or string argument into `out`; false for any other type.
+static bool GetBytes(Isolate* isolate, Local<Value> value, std::string& out) {
+    if (node::Buffer::HasInstance(value)) {
+        out.assign(node::Buffer::Data(value), node::Buffer::Length(value));
+        return true;
+    }
+    if (value->IsString()) {
+        String::Utf8Value content(isolate, value);
+        out.assign(*content, content.length());
+        return true;
+    }
+    return false;
+}
+
+static void StopReadaheadHook(void*) {
+    StopReadahead();
+}
+
+// Initialize VFS; read-ahead windows are filled on a background thread from here on
 void InitVFS(const FunctionCallbackInfo<Value>& args) {
     Isolate* isolate = args.GetIsolate();
-    LoadDisk();
+    static bool cleanupRegistered = false;
+    std::lock_guard<std::mutex> lock(vfsMutex);
+    if (!LoadDisk()) {
+        args.GetReturnValue().Set(Boolean::New(isolate, false));
+        return;
+    }
+    if (!cleanupRegistered) {
+        node::AddEnvironmentCleanupHook(isolate, StopReadaheadHook, nullptr);
+        cleanupRegistered = true;
+    }
+    StartReadahead();
     args.GetReturnValue().Set(Boolean::New(isolate, true));
 }
 
 // Save VFS to disk
 void SaveVFS(const FunctionCallbackInfo<Value>& args) {
     Isolate* isolate = args.GetIsolate();
+    std::lock_guard<std::mutex> lock(vfsMutex);
     SaveDisk();
     args.GetReturnValue().Set(Boolean::New(isolate, true));
 }
@@ -26,6 +70,7 @@ void SaveVFS(const FunctionCallbackInfo<Value>& args) {
 // Create file in VFS
 void VFSCreateFile(const FunctionCallbackInfo<Value>& args) {
     Isolate* isolate = args.GetIsolate();
+    std::lock_guard<std::mutex> lock(vfsMutex);
     
     if (args.Length() < 1 || !args[0]->IsString()) {
         isolate->ThrowException(Exception::TypeError(
@@ -42,18 +87,11 @@ void VFSCreateFile(const FunctionCallbackInfo<Value>& args) {
         return;
     }
     
-    int idx = FindFreeInode();
-    int block = FindFreeBlock();
-    if (idx == -1 || block == -1) {
+    int idx = AllocateFile(name);
+    if (idx == -1) {
         args.GetReturnValue().Set(Boolean::New(isolate, false));
         return;
     }
-    
-    strncpy(inodeTable[idx].fileName, name.c_str(), 100);
-    inodeTable[idx].startBlock = block;
-    inodeTable[idx].size = 0;
-    inodeTable[idx].cursor = 0;
-    inodeTable[idx].used = true;
     SaveDisk();
     
     args.GetReturnValue().Set(Boolean::New(isolate, true));
@@ -62,6 +100,7 @@ void VFSCreateFile(const FunctionCallbackInfo<Value>& args) {
 // Write data to VFS file
 void VFSWriteFile(const FunctionCallbackInfo<Value>& args) {
     Isolate* isolate = args.GetIsolate();
+    std::lock_guard<std::mutex> lock(vfsMutex);
     
     if (args.Length() < 2 || !args[0]->IsString()) {
         isolate->ThrowException(Exception::TypeError(
@@ -83,14 +122,10 @@ void VFSWriteFile(const FunctionCallbackInfo<Value>& args) {
         char* data = node::Buffer::Data(args[1]);
         size_t length = node::Buffer::Length(args[1]);
         
-        if (length > FILE_SIZE) {
+        if (!WriteData(idx, 0, data, length) || !TruncateData(idx, length)) {
             args.GetReturnValue().Set(Boolean::New(isolate, false));
             return;
         }
-        
-        int start = inodeTable[idx].startBlock;
-        memcpy(&diskData[start], data, length);
-        inodeTable[idx].size = length;
         inodeTable[idx].cursor = length;
         SaveDisk();
         args.GetReturnValue().Set(Boolean::New(isolate, true));
@@ -100,14 +135,10 @@ void VFSWriteFile(const FunctionCallbackInfo<Value>& args) {
         String::Utf8Value content(isolate, args[1]);
         std::string data(*content);
         
-        if (data.size() > FILE_SIZE) {
+        if (!WriteData(idx, 0, data.c_str(), data.size()) || !TruncateData(idx, data.size())) {
             args.GetReturnValue().Set(Boolean::New(isolate, false));
             return;
         }
-        
-        int start = inodeTable[idx].startBlock;
-        memcpy(&diskData[start], data.c_str(), data.size());
-        inodeTable[idx].size = data.size();
         inodeTable[idx].cursor = data.size();
         SaveDisk();
         args.GetReturnValue().Set(Boolean::New(isolate, true));
@@ -120,6 +151,7 @@ void VFSWriteFile(const FunctionCallbackInfo<Value>& args) {
 // Read file from VFS
 void VFSReadFile(const FunctionCallbackInfo<Value>& args) {
     Isolate* isolate = args.GetIsolate();
+    std::lock_guard<std::mutex> lock(vfsMutex);
     
     if (args.Length() < 1 || !args[0]->IsString()) {
         isolate->ThrowException(Exception::TypeError(
@@ -136,18 +168,170 @@ void VFSReadFile(const FunctionCallbackInfo<Value>& args) {
         return;
     }
     
-    int start = inodeTable[idx].startBlock;
     int size = inodeTable[idx].size;
     
-    // Return as Buffer to preserve binary data
-    Local<Object> buffer = node::Buffer::Copy(isolate, 
-        reinterpret_cast<const char*>(&diskData[start]), size).ToLocalChecked();
+    // Return as Buffer to preserve binary data; decrypt straight into it
+    Local<Object> buffer = node::Buffer::New(isolate, size).ToLocalChecked();
+    if (!ReadData(idx, 0, node::Buffer::Data(buffer), size)) {
+        args.GetReturnValue().Set(Null(isolate));
+        return;
+    }
     args.GetReturnValue().Set(buffer);
 }
 
+// Read `length` bytes at `offset` without touching the rest of the file
+void VFSReadAt(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    std::lock_guard<std::mutex> lock(vfsMutex);
+    
+    if (args.Length() < 3 || !args[0]->IsString() || !args[1]->IsNumber() || !args[2]->IsNumber()) {
+        isolate->ThrowException(Exception::TypeError(
+            String::NewFromUtf8(isolate, "Filename, offset and length required").ToLocalChecked()));
+        return;
+    }
+    
+    String::Utf8Value filename(isolate, args[0]);
+    std::string name(*filename);
+    int offset = args[1]->Int32Value(isolate->GetCurrentContext()).FromJust();
+    int length = args[2]->Int32Value(isolate->GetCurrentContext()).FromJust();
+    
+    int idx = FindFile(name);
+    if (idx == -1 || offset < 0 || length < 0) {
+        args.GetReturnValue().Set(Null(isolate));
+        return;
+    }
+    
+    int size = inodeTable[idx].size;
+    int toRead = offset >= size ? 0 : std::min(length, size - offset);
+    Local<Object> buffer = node::Buffer::New(isolate, toRead).ToLocalChecked();
+    if (!ReadData(idx, offset, node::Buffer::Data(buffer), toRead)) {
+        args.GetReturnValue().Set(Null(isolate));
+        return;
+    }
+    args.GetReturnValue().Set(buffer);
+}
+
+// Write data at `offset`, growing the file if needed; only the covered blocks are rewritten
+void VFSWriteAt(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    std::lock_guard<std::mutex> lock(vfsMutex);
+    
+    if (args.Length() < 3 || !args[0]->IsString() || !args[1]->IsNumber()) {
+        isolate->ThrowException(Exception::TypeError(
+            String::NewFromUtf8(isolate, "Filename, offset and data required").ToLocalChecked()));
+        return;
+    }
+    
+    String::Utf8Value filename(isolate, args[0]);
+    std::string name(*filename);
+    int offset = args[1]->Int32Value(isolate->GetCurrentContext()).FromJust();
+    std::string data;
+    
+    int idx = FindFile(name);
+    if (idx == -1 || offset < 0 || !GetBytes(isolate, args[2], data) ||
+        !WriteData(idx, offset, data.data(), data.size())) {
+        args.GetReturnValue().Set(Boolean::New(isolate, false));
+        return;
+    }
+    SaveDisk();
+    args.GetReturnValue().Set(Boolean::New(isolate, true));
+}
+
+// Append data to the end of a file
+void VFSAppend(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    std::lock_guard<std::mutex> lock(vfsMutex);
+    
+    if (args.Length() < 2 || !args[0]->IsString()) {
+        isolate->ThrowException(Exception::TypeError(
+            String::NewFromUtf8(isolate, "Filename and data required").ToLocalChecked()));
+        return;
+    }
+    
+    String::Utf8Value filename(isolate, args[0]);
+    std::string name(*filename);
+    std::string data;
+    
+    int idx = FindFile(name);
+    if (idx == -1 || !GetBytes(isolate, args[1], data) ||
+        !WriteData(idx, inodeTable[idx].size, data.data(), data.size())) {
+        args.GetReturnValue().Set(Boolean::New(isolate, false));
+        return;
+    }
+    SaveDisk();
+    args.GetReturnValue().Set(Boolean::New(isolate, true));
+}
+
+// Shrink or zero-extend a file to `size` bytes
+void VFSTruncate(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    std::lock_guard<std::mutex> lock(vfsMutex);
+    
+    if (args.Length() < 2 || !args[0]->IsString() || !args[1]->IsNumber()) {
+        isolate->ThrowException(Exception::TypeError(
+            String::NewFromUtf8(isolate, "Filename and size required").ToLocalChecked()));
+        return;
+    }
+    
+    String::Utf8Value filename(isolate, args[0]);
+    std::string name(*filename);
+    int size = args[1]->Int32Value(isolate->GetCurrentContext()).FromJust();
+    
+    int idx = FindFile(name);
+    if (idx == -1 || !TruncateData(idx, size)) {
+        args.GetReturnValue().Set(Boolean::New(isolate, false));
+        return;
+    }
+    SaveDisk();
+    args.GetReturnValue().Set(Boolean::New(isolate, true));
+}
+
+// Replace text in a file: every occurrence when nth is 0, otherwise the nth (default 1).
+// Returns the number of replacements, or false on error
+void VFSUpdateFile(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    std::lock_guard<std::mutex> lock(vfsMutex);
+    
+    if (args.Length() < 3 || !args[0]->IsString()) {
+        isolate->ThrowException(Exception::TypeError(
+            String::NewFromUtf8(isolate, "Filename, old text and new text required").ToLocalChecked()));
+        return;
+    }
+    
+    String::Utf8Value filename(isolate, args[0]);
+    std::string name(*filename);
+    std::string oldText, newText;
+    int nth = 1;
+    if (args.Length() > 3 && args[3]->IsNumber()) {
+        nth = args[3]->Int32Value(isolate->GetCurrentContext()).FromJust();
+    }
+    
+    int idx = FindFile(name);
+    if (idx == -1 || !GetBytes(isolate, args[1], oldText) || !GetBytes(isolate, args[2], newText)) {
+        args.GetReturnValue().Set(Boolean::New(isolate, false));
+        return;
+    }
+    
+    BeginTransaction();
+    int replaced = ReplaceInData(idx, oldText, newText, nth);
+    if (replaced <= 0) {
+        RollbackTransaction();
+        if (replaced < 0) {
+            args.GetReturnValue().Set(Boolean::New(isolate, false));
+            return;
+        }
+    }
+    else {
+        inodeTable[idx].cursor = inodeTable[idx].size;
+        CommitTransaction();
+    }
+    args.GetReturnValue().Set(Number::New(isolate, replaced));
+}
+
 // Delete file from VFS
 void VFSDeleteFile(const FunctionCallbackInfo<Value>& args) {
     Isolate* isolate = args.GetIsolate();
+    std::lock_guard<std::mutex> lock(vfsMutex);
     
     if (args.Length() < 1 || !args[0]->IsString()) {
         isolate->ThrowException(Exception::TypeError(
@@ -164,23 +348,41 @@ void VFSDeleteFile(const FunctionCallbackInfo<Value>& args) {
         return;
     }
     
-    inodeTable[idx].used = false;
-    inodeTable[idx].size = 0;
-    inodeTable[idx].cursor = 0;
-    memset(&diskData[inodeTable[idx].startBlock], 0, FILE_SIZE);
+    ReleaseFile(idx);
     SaveDisk();
     
     args.GetReturnValue().Set(Boolean::New(isolate, true));
 }
 
-// List files in VFS
+// An extended attribute as a JS string, number or boolean
+static Local<Value> XattrValue(Isolate* isolate, const Xattr& attr) {
+    if (attr.type == XATTR_STRING) {
+        return String::NewFromUtf8(isolate, attr.text.data(), NewStringType::kNormal, attr.text.size()).ToLocalChecked();
+    }
+    if (attr.type == XATTR_BOOL) return Boolean::New(isolate, attr.number != 0);
+    return Number::New(isolate, (double)attr.number);
+}
+
+// List files in VFS. With an array of attribute names, each entry also gets
+// an `attrs` object holding those of the named attributes the file has
 void VFSListFiles(const FunctionCallbackInfo<Value>& args) {
     Isolate* isolate = args.GetIsolate();
+    std::lock_guard<std::mutex> lock(vfsMutex);
     Local<Context> context = isolate->GetCurrentContext();
     
     Local<Array> files = Array::New(isolate);
     int fileCount = 0;
     
+    std::vector<std::string> attrNames;
+    if (args.Length() > 0 && args[0]->IsArray()) {
+        Local<Array> names = Local<Array>::Cast(args[0]);
+        for (uint32_t n = 0; n < names->Length(); ++n) {
+            String::Utf8Value name(isolate, names->Get(context, n).ToLocalChecked());
+            attrNames.push_back(*name);
+        }
+    }
+    std::vector<Xattr> attrs;
+    
     for (int i = 0; i < MAX_FILES; ++i) {
         if (inodeTable[i].used) {
             Local<Object> fileInfo = Object::New(isolate);
@@ -193,6 +395,18 @@ void VFSListFiles(const FunctionCallbackInfo<Value>& args) {
             fileInfo->Set(context,
                 String::NewFromUtf8(isolate, "cursor").ToLocalChecked(),
                 Number::New(isolate, inodeTable[i].cursor));
+            if (!attrNames.empty()) {
+                Local<Object> selected = Object::New(isolate);
+                if (GetXattrs(i, attrs)) {
+                    for (const Xattr& attr : attrs) {
+                        if (std::find(attrNames.begin(), attrNames.end(), attr.name) == attrNames.end()) continue;
+                        selected->Set(context,
+                            String::NewFromUtf8(isolate, attr.name.c_str()).ToLocalChecked(),
+                            XattrValue(isolate, attr)).Check();
+                    }
+                }
+                fileInfo->Set(context, String::NewFromUtf8(isolate, "attrs").ToLocalChecked(), selected).Check();
+            }
             
             files->Set(context, fileCount++, fileInfo);
         }
@@ -201,9 +415,96 @@ void VFSListFiles(const FunctionCallbackInfo<Value>& args) {
     args.GetReturnValue().Set(files);
 }
 
+// Set an extended attribute: setAttr(file, name, value). Strings, numbers
+// (stored as 64-bit integers) and booleans keep their type
+void VFSSetAttr(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    Local<Context> context = isolate->GetCurrentContext();
+    std::lock_guard<std::mutex> lock(vfsMutex);
+    
+    if (args.Length() < 3 || !args[0]->IsString() || !args[1]->IsString()) {
+        isolate->ThrowException(Exception::TypeError(
+            String::NewFromUtf8(isolate, "File name, attribute name and value required").ToLocalChecked()));
+        return;
+    }
+    
+    String::Utf8Value filename(isolate, args[0]);
+    String::Utf8Value attrName(isolate, args[1]);
+    Xattr attr;
+    attr.name = *attrName;
+    if (args[2]->IsBoolean()) {
+        attr.type = XATTR_BOOL;
+        attr.number = args[2]->IsTrue();
+    } else if (args[2]->IsNumber()) {
+        attr.type = XATTR_INT;
+        attr.number = args[2]->IntegerValue(context).FromJust();
+    } else if (!GetBytes(isolate, args[2], attr.text)) {
+        isolate->ThrowException(Exception::TypeError(
+            String::NewFromUtf8(isolate, "Value must be a string, number or boolean").ToLocalChecked()));
+        return;
+    }
+    
+    int idx = FindFile(*filename);
+    if (idx == -1 || mountedSnapshot != -1 || !SetXattr(idx, attr)) {
+        args.GetReturnValue().Set(Boolean::New(isolate, false));
+        return;
+    }
+    SaveDisk();
+    args.GetReturnValue().Set(Boolean::New(isolate, true));
+}
+
+// All extended attributes of a file as an object, or null if the file does
+// not exist or its inode is damaged
+void VFSGetAttrs(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    Local<Context> context = isolate->GetCurrentContext();
+    std::lock_guard<std::mutex> lock(vfsMutex);
+    
+    if (args.Length() < 1 || !args[0]->IsString()) {
+        args.GetReturnValue().Set(Null(isolate));
+        return;
+    }
+    
+    String::Utf8Value filename(isolate, args[0]);
+    int idx = FindFile(*filename);
+    std::vector<Xattr> attrs;
+    if (idx == -1 || !GetXattrs(idx, attrs)) {
+        args.GetReturnValue().Set(Null(isolate));
+        return;
+    }
+    Local<Object> result = Object::New(isolate);
+    for (const Xattr& attr : attrs) {
+        result->Set(context, String::NewFromUtf8(isolate, attr.name.c_str()).ToLocalChecked(),
+            XattrValue(isolate, attr)).Check();
+    }
+    args.GetReturnValue().Set(result);
+}
+
+// Remove an extended attribute: removeAttr(file, name)
+void VFSRemoveAttr(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    std::lock_guard<std::mutex> lock(vfsMutex);
+    
+    if (args.Length() < 2 || !args[0]->IsString() || !args[1]->IsString()) {
+        args.GetReturnValue().Set(Boolean::New(isolate, false));
+        return;
+    }
+    
+    String::Utf8Value filename(isolate, args[0]);
+    String::Utf8Value attrName(isolate, args[1]);
+    int idx = FindFile(*filename);
+    if (idx == -1 || mountedSnapshot != -1 || !RemoveXattr(idx, *attrName)) {
+        args.GetReturnValue().Set(Boolean::New(isolate, false));
+        return;
+    }
+    SaveDisk();
+    args.GetReturnValue().Set(Boolean::New(isolate, true));
+}
+
 // Check if file exists in VFS
 void VFSFileExists(const FunctionCallbackInfo<Value>& args) {
     Isolate* isolate = args.GetIsolate();
+    std::lock_guard<std::mutex> lock(vfsMutex);
     
     if (args.Length() < 1 || !args[0]->IsString()) {
         args.GetReturnValue().Set(Boolean::New(isolate, false));
@@ -217,6 +518,430 @@ void VFSFileExists(const FunctionCallbackInfo<Value>& args) {
     args.GetReturnValue().Set(Boolean::New(isolate, idx != -1));
 }
 
+// Apply a list of operations atomically with one lock acquisition and one save.
+// Each op is an object {op, name, data, offset, size, oldText, newText, nth};
+// returns one {ok, value} or {ok, error} result per op. If any op fails,
+// none of them take effect.
+void VFSBatch(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    Local<Context> context = isolate->GetCurrentContext();
+    
+    if (args.Length() < 1 || !args[0]->IsArray()) {
+        isolate->ThrowException(Exception::TypeError(
+            String::NewFromUtf8(isolate, "Array of operations required").ToLocalChecked()));
+        return;
+    }
+    
+    Local<Array> list = Local<Array>::Cast(args[0]);
+    std::vector<BatchOp> ops(list->Length());
+    for (uint32_t i = 0; i < list->Length(); ++i) {
+        Local<Value> item = list->Get(context, i).ToLocalChecked();
+        if (!item->IsObject()) {
+            isolate->ThrowException(Exception::TypeError(
+                String::NewFromUtf8(isolate, "Each operation must be an object").ToLocalChecked()));
+            return;
+        }
+        Local<Object> obj = item.As<Object>();
+        auto field = [&](const char* key) {
+            return obj->Get(context, String::NewFromUtf8(isolate, key).ToLocalChecked()).ToLocalChecked();
+        };
+        GetBytes(isolate, field("op"), ops[i].op);
+        GetBytes(isolate, field("name"), ops[i].name);
+        GetBytes(isolate, field("data"), ops[i].data);
+        GetBytes(isolate, field("oldText"), ops[i].oldText);
+        GetBytes(isolate, field("newText"), ops[i].newText);
+        Local<Value> offset = field(ops[i].op == "truncate" ? "size" : "offset");
+        if (offset->IsNumber()) ops[i].offset = offset->Int32Value(context).FromJust();
+        Local<Value> nth = field("nth");
+        if (nth->IsNumber()) ops[i].nth = nth->Int32Value(context).FromJust();
+    }
+    
+    std::vector<BatchResult> results;
+    RunBatch(ops, results);
+    
+    Local<Array> out = Array::New(isolate, results.size());
+    for (size_t i = 0; i < results.size(); ++i) {
+        Local<Object> result = Object::New(isolate);
+        result->Set(context,
+            String::NewFromUtf8(isolate, "ok").ToLocalChecked(),
+            Boolean::New(isolate, results[i].ok)).Check();
+        if (results[i].ok) {
+            result->Set(context,
+                String::NewFromUtf8(isolate, "value").ToLocalChecked(),
+                Number::New(isolate, results[i].value)).Check();
+        } else {
+            result->Set(context,
+                String::NewFromUtf8(isolate, "error").ToLocalChecked(),
+                String::NewFromUtf8(isolate, results[i].error.c_str()).ToLocalChecked()).Check();
+        }
+        out->Set(context, i, result).Check();
+    }
+    args.GetReturnValue().Set(out);
+}
+
+// Take a point-in-time snapshot; blocks are shared until the live file changes
+void VFSCreateSnapshot(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    std::lock_guard<std::mutex> lock(vfsMutex);
+    
+    if (args.Length() < 1 || !args[0]->IsString()) {
+        isolate->ThrowException(Exception::TypeError(
+            String::NewFromUtf8(isolate, "Snapshot name required").ToLocalChecked()));
+        return;
+    }
+    
+    String::Utf8Value snapName(isolate, args[0]);
+    std::string name(*snapName);
+    
+    if (name.empty() || name.size() >= sizeof(Snapshot::name) || FindSnapshot(name) != -1 ||
+        CreateSnapshot(name) == -1) {
+        args.GetReturnValue().Set(Boolean::New(isolate, false));
+        return;
+    }
+    SaveDisk();
+    args.GetReturnValue().Set(Boolean::New(isolate, true));
+}
+
+// Delete a snapshot, releasing the blocks only it was holding
+void VFSDeleteSnapshot(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    std::lock_guard<std::mutex> lock(vfsMutex);
+    
+    if (args.Length() < 1 || !args[0]->IsString()) {
+        isolate->ThrowException(Exception::TypeError(
+            String::NewFromUtf8(isolate, "Snapshot name required").ToLocalChecked()));
+        return;
+    }
+    
+    String::Utf8Value snapName(isolate, args[0]);
+    if (!DeleteSnapshot(*snapName)) {
+        args.GetReturnValue().Set(Boolean::New(isolate, false));
+        return;
+    }
+    SaveDisk();
+    args.GetReturnValue().Set(Boolean::New(isolate, true));
+}
+
+// List snapshots as {name, created, files}
+void VFSListSnapshots(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    std::lock_guard<std::mutex> lock(vfsMutex);
+    Local<Context> context = isolate->GetCurrentContext();
+    
+    Local<Array> list = Array::New(isolate);
+    int count = 0;
+    for (const Snapshot& snap : snapshots) {
+        if (!snap.used) continue;
+        int files = 0;
+        for (const Inode& node : snap.inodes) files += node.used;
+        Local<Object> info = Object::New(isolate);
+        info->Set(context, String::NewFromUtf8(isolate, "name").ToLocalChecked(),
+            String::NewFromUtf8(isolate, snap.name).ToLocalChecked()).Check();
+        info->Set(context, String::NewFromUtf8(isolate, "created").ToLocalChecked(),
+            Number::New(isolate, (double)snap.created)).Check();
+        info->Set(context, String::NewFromUtf8(isolate, "files").ToLocalChecked(),
+            Number::New(isolate, files)).Check();
+        list->Set(context, count++, info).Check();
+    }
+    args.GetReturnValue().Set(list);
+}
+
+// List the files of a snapshot as {name, size}, or null if it does not exist
+void VFSListSnapshotFiles(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    std::lock_guard<std::mutex> lock(vfsMutex);
+    Local<Context> context = isolate->GetCurrentContext();
+    
+    if (args.Length() < 1 || !args[0]->IsString()) {
+        isolate->ThrowException(Exception::TypeError(
+            String::NewFromUtf8(isolate, "Snapshot name required").ToLocalChecked()));
+        return;
+    }
+    
+    String::Utf8Value snapName(isolate, args[0]);
+    int slot = FindSnapshot(*snapName);
+    if (slot == -1) {
+        args.GetReturnValue().Set(Null(isolate));
+        return;
+    }
+    
+    Local<Array> files = Array::New(isolate);
+    int count = 0;
+    for (const Inode& node : snapshots[slot].inodes) {
+        if (!node.used) continue;
+        Local<Object> info = Object::New(isolate);
+        info->Set(context, String::NewFromUtf8(isolate, "name").ToLocalChecked(),
+            String::NewFromUtf8(isolate, node.fileName).ToLocalChecked()).Check();
+        info->Set(context, String::NewFromUtf8(isolate, "size").ToLocalChecked(),
+            Number::New(isolate, node.size)).Check();
+        files->Set(context, count++, info).Check();
+    }
+    args.GetReturnValue().Set(files);
+}
+
+// Read a file as it was when the snapshot was taken; null if either is missing
+void VFSReadSnapshotFile(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    std::lock_guard<std::mutex> lock(vfsMutex);
+    
+    if (args.Length() < 2 || !args[0]->IsString() || !args[1]->IsString()) {
+        isolate->ThrowException(Exception::TypeError(
+            String::NewFromUtf8(isolate, "Snapshot name and filename required").ToLocalChecked()));
+        return;
+    }
+    
+    String::Utf8Value snapName(isolate, args[0]);
+    String::Utf8Value filename(isolate, args[1]);
+    if (!MountSnapshot(*snapName)) {
+        args.GetReturnValue().Set(Null(isolate));
+        return;
+    }
+    
+    int idx = FindFile(*filename);
+    Local<Object> buffer;
+    bool ok = idx != -1;
+    if (ok) {
+        int size = inodeTable[idx].size;
+        buffer = node::Buffer::New(isolate, size).ToLocalChecked();
+        ok = ReadData(idx, 0, node::Buffer::Data(buffer), size);
+    }
+    UnmountSnapshot();
+    
+    if (!ok) {
+        args.GetReturnValue().Set(Null(isolate));
+        return;
+    }
+    args.GetReturnValue().Set(buffer);
+}
+
+// Verify every inode and in-use block of the image against its checksum;
+// with quarantine true, damaged blocks are moved aside (repaired from memory
+// when possible). Returns {inodes, blocks, bytes, seconds, threads, problems}
+void VFSScrub(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    Local<Context> context = isolate->GetCurrentContext();
+    std::lock_guard<std::mutex> lock(vfsMutex);
+    auto key = [&](const char* name) { return String::NewFromUtf8(isolate, name).ToLocalChecked(); };
+    
+    bool quarantine = args.Length() > 0 && args[0]->IsTrue();
+    ScrubResult result;
+    if (!ScrubVolume(quarantine, result)) {
+        args.GetReturnValue().Set(Null(isolate));
+        return;
+    }
+    
+    Local<Array> problems = Array::New(isolate);
+    for (size_t i = 0; i < result.problems.size(); ++i) {
+        const ScrubProblem& p = result.problems[i];
+        Local<Object> entry = Object::New(isolate);
+        entry->Set(context, key("type"), key(p.block == -1 ? "inode" : "block")).Check();
+        entry->Set(context, key("inode"), Number::New(isolate, p.inode)).Check();
+        entry->Set(context, key("block"), Number::New(isolate, p.block)).Check();
+        entry->Set(context, key("owner"), String::NewFromUtf8(isolate, p.owner.c_str()).ToLocalChecked()).Check();
+        entry->Set(context, key("offset"), Number::New(isolate, p.offset)).Check();
+        entry->Set(context, key("repairable"), Boolean::New(isolate, p.repairable)).Check();
+        entry->Set(context, key("fixed"), Boolean::New(isolate, p.fixed)).Check();
+        problems->Set(context, (uint32_t)i, entry).Check();
+    }
+    
+    Local<Object> report = Object::New(isolate);
+    report->Set(context, key("inodes"), Number::New(isolate, result.inodesChecked)).Check();
+    report->Set(context, key("blocks"), Number::New(isolate, result.blocksChecked)).Check();
+    report->Set(context, key("bytes"), Number::New(isolate, (double)result.bytes)).Check();
+    report->Set(context, key("seconds"), Number::New(isolate, result.seconds)).Check();
+    report->Set(context, key("threads"), Number::New(isolate, result.threads)).Check();
+    report->Set(context, key("problems"), problems).Check();
+    args.GetReturnValue().Set(report);
+}
+
+// Shared by importTree and exportTree: {files, bytes, seconds, threads}, or
+// throws with the reason
+static void ReturnTransfer(const FunctionCallbackInfo<Value>& args, bool ok, const TransferResult& result) {
+    Isolate* isolate = args.GetIsolate();
+    Local<Context> context = isolate->GetCurrentContext();
+    if (!ok) {
+        isolate->ThrowException(Exception::Error(
+            String::NewFromUtf8(isolate, result.error.c_str()).ToLocalChecked()));
+        return;
+    }
+    Local<Object> report = Object::New(isolate);
+    auto set = [&](const char* key, double value) {
+        report->Set(context, String::NewFromUtf8(isolate, key).ToLocalChecked(), Number::New(isolate, value)).Check();
+    };
+    set("files", result.files);
+    set("bytes", (double)result.bytes);
+    set("seconds", result.seconds);
+    set("threads", result.threads);
+    args.GetReturnValue().Set(report);
+}
+
+// Copy a host directory tree into the volume in one transaction. Host files
+// are read in parallel before vfsMutex is taken, so no lock here
+void VFSImportTree(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    if (args.Length() < 1 || !args[0]->IsString()) {
+        isolate->ThrowException(Exception::TypeError(
+            String::NewFromUtf8(isolate, "Directory path required").ToLocalChecked()));
+        return;
+    }
+    String::Utf8Value dir(isolate, args[0]);
+    TransferResult result;
+    bool ok = ImportTree(*dir, result);
+    ReturnTransfer(args, ok, result);
+}
+
+// Write every file of the volume below a host directory; vfsMutex is only
+// held while the contents are copied out
+void VFSExportTree(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    if (args.Length() < 1 || !args[0]->IsString()) {
+        isolate->ThrowException(Exception::TypeError(
+            String::NewFromUtf8(isolate, "Directory path required").ToLocalChecked()));
+        return;
+    }
+    String::Utf8Value dir(isolate, args[0]);
+    TransferResult result;
+    bool ok = ExportTree(*dir, result);
+    ReturnTransfer(args, ok, result);
+}
+
+// Fragmentation numbers as {files, usedBlocks, fragments, fragmentedFiles, inlineFiles, holes, extentBlocks, pinnedBlocks, imageBytes, allocatedBytes}
+static Local<Object> FragStatsObject(Isolate* isolate, const FragStats& stats) {
+    Local<Context> context = isolate->GetCurrentContext();
+    Local<Object> obj = Object::New(isolate);
+    auto set = [&](const char* key, double value) {
+        obj->Set(context, String::NewFromUtf8(isolate, key).ToLocalChecked(), Number::New(isolate, value)).Check();
+    };
+    set("files", stats.files);
+    set("usedBlocks", stats.usedBlocks);
+    set("fragments", stats.fragments);
+    set("fragmentedFiles", stats.fragmentedFiles);
+    set("inlineFiles", stats.inlineFiles);
+    set("holes", stats.holes);
+    set("extentBlocks", stats.extentBlocks);
+    set("pinnedBlocks", stats.pinnedBlocks);
+    set("imageBytes", (double)stats.imageBytes);
+    set("allocatedBytes", (double)stats.allocatedBytes);
+    return obj;
+}
+
+void VFSFragStats(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    std::lock_guard<std::mutex> lock(vfsMutex);
+    args.GetReturnValue().Set(FragStatsObject(isolate, GetFragStats()));
+}
+
+// Run one compaction slice of at most `sliceMs` (default 2) and save.
+// Returns {done, moved}; the image file is trimmed once done is true
+void VFSCompact(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    Local<Context> context = isolate->GetCurrentContext();
+    std::lock_guard<std::mutex> lock(vfsMutex);
+    
+    double sliceMs = args.Length() > 0 && args[0]->IsNumber() ? args[0].As<Number>()->Value() : 2;
+    int moved;
+    bool done = CompactStep((long)(sliceMs * 1000), moved);
+    if (moved) SaveDisk();
+    if (done) TrimImage();
+    
+    Local<Object> result = Object::New(isolate);
+    result->Set(context, String::NewFromUtf8(isolate, "done").ToLocalChecked(), Boolean::New(isolate, done)).Check();
+    result->Set(context, String::NewFromUtf8(isolate, "moved").ToLocalChecked(), Number::New(isolate, moved)).Check();
+    args.GetReturnValue().Set(result);
+}
+
+// Background compaction: one bounded slice at a time under the lock, with a
+// pause in between, so a foreground call never waits longer than one slice.
+static std::thread compactorThread;
+static std::atomic<bool> compactorStop(false);
+static std::atomic<bool> compactorRunning(false);
+
+static void CompactorLoop(long sliceMicros, long pauseMicros) {
+    while (!compactorStop) {
+        bool done;
+        {
+            std::lock_guard<std::mutex> lock(vfsMutex);
+            int moved;
+            done = CompactStep(sliceMicros, moved);
+            if (moved) SaveDisk();
+            if (done) TrimImage();
+        }
+        if (done) break;
+        std::this_thread::sleep_for(std::chrono::microseconds(pauseMicros));
+    }
+    compactorRunning = false;
+}
+
+static void StopCompactor(void*) {
+    compactorStop = true;
+    if (compactorThread.joinable()) compactorThread.join();
+}
+
+// Start compacting in the background: slices of `sliceMs` (default 2) every
+// `pauseMs` (default 20). Returns false if a compactor is already running
+void VFSStartCompactor(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    static bool cleanupRegistered = false;
+    
+    if (compactorRunning) {
+        args.GetReturnValue().Set(Boolean::New(isolate, false));
+        return;
+    }
+    if (!cleanupRegistered) {
+        node::AddEnvironmentCleanupHook(isolate, StopCompactor, nullptr);
+        cleanupRegistered = true;
+    }
+    StopCompactor(nullptr);
+    
+    double sliceMs = args.Length() > 0 && args[0]->IsNumber() ? args[0].As<Number>()->Value() : 2;
+    double pauseMs = args.Length() > 1 && args[1]->IsNumber() ? args[1].As<Number>()->Value() : 20;
+    compactorStop = false;
+    compactorRunning = true;
+    compactorThread = std::thread(CompactorLoop, (long)(sliceMs * 1000), (long)(pauseMs * 1000));
+    args.GetReturnValue().Set(Boolean::New(isolate, true));
+}
+
+// Stop the background compactor after its current slice
+void VFSStopCompactor(const FunctionCallbackInfo<Value>& args) {
+    StopCompactor(nullptr);
+    args.GetReturnValue().Set(Boolean::New(args.GetIsolate(), true));
+}
+
+// Per-stage call counts and latency percentiles plus byte/cache counters
+void VFSGetStats(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    Local<Context> context = isolate->GetCurrentContext();
+    auto key = [&](const char* name) { return String::NewFromUtf8(isolate, name).ToLocalChecked(); };
+    
+    Local<Object> ops = Object::New(isolate);
+    for (int op = 0; op < STAT_OP_COUNT; ++op) {
+        StatSummary s = GetStatSummary((StatOp)op);
+        Local<Object> entry = Object::New(isolate);
+        entry->Set(context, key("count"), Number::New(isolate, s.count)).Check();
+        entry->Set(context, key("sampled"), Number::New(isolate, s.sampled)).Check();
+        entry->Set(context, key("totalNs"), Number::New(isolate, s.totalNs)).Check();
+        entry->Set(context, key("p50Ns"), Number::New(isolate, s.p50Ns)).Check();
+        entry->Set(context, key("p90Ns"), Number::New(isolate, s.p90Ns)).Check();
+        entry->Set(context, key("p99Ns"), Number::New(isolate, s.p99Ns)).Check();
+        entry->Set(context, key("p999Ns"), Number::New(isolate, s.p999Ns)).Check();
+        entry->Set(context, key("maxNs"), Number::New(isolate, s.maxNs)).Check();
+        ops->Set(context, key(STAT_OP_NAMES[op]), entry).Check();
+    }
+    
+    Local<Object> stats = Object::New(isolate);
+    stats->Set(context, key("ops"), ops).Check();
+    for (int c = 0; c < STAT_COUNTER_COUNT; ++c) {
+        stats->Set(context, key(STAT_COUNTER_NAMES[c]), Number::New(isolate, GetStatCounter((StatCounter)c))).Check();
+    }
+    args.GetReturnValue().Set(stats);
+}
+
+// Clear all statistics
+void VFSResetStats(const FunctionCallbackInfo<Value>& args) {
+    ResetStats();
+    args.GetReturnValue().Set(Boolean::New(args.GetIsolate(), true));
+}
+
 // Initialize the addon
 void Initialize(Local<Object> exports) {
     NODE_SET_METHOD(exports, "initVFS", InitVFS);
@@ -224,9 +949,32 @@ void Initialize(Local<Object> exports) {
     NODE_SET_METHOD(exports, "createFile", VFSCreateFile);
     NODE_SET_METHOD(exports, "writeFile", VFSWriteFile);
     NODE_SET_METHOD(exports, "readFile", VFSReadFile);
+    NODE_SET_METHOD(exports, "readAt", VFSReadAt);
+    NODE_SET_METHOD(exports, "writeAt", VFSWriteAt);
+    NODE_SET_METHOD(exports, "append", VFSAppend);
+    NODE_SET_METHOD(exports, "truncate", VFSTruncate);
+    NODE_SET_METHOD(exports, "updateFile", VFSUpdateFile);
     NODE_SET_METHOD(exports, "deleteFile", VFSDeleteFile);
     NODE_SET_METHOD(exports, "listFiles", VFSListFiles);
     NODE_SET_METHOD(exports, "fileExists", VFSFileExists);
+    NODE_SET_METHOD(exports, "setAttr", VFSSetAttr);
+    NODE_SET_METHOD(exports, "getAttrs", VFSGetAttrs);
+    NODE_SET_METHOD(exports, "removeAttr", VFSRemoveAttr);
+    NODE_SET_METHOD(exports, "batch", VFSBatch);
+    NODE_SET_METHOD(exports, "createSnapshot", VFSCreateSnapshot);
+    NODE_SET_METHOD(exports, "deleteSnapshot", VFSDeleteSnapshot);
+    NODE_SET_METHOD(exports, "listSnapshots", VFSListSnapshots);
+    NODE_SET_METHOD(exports, "listSnapshotFiles", VFSListSnapshotFiles);
+    NODE_SET_METHOD(exports, "readSnapshotFile", VFSReadSnapshotFile);
+    NODE_SET_METHOD(exports, "scrub", VFSScrub);
+    NODE_SET_METHOD(exports, "importTree", VFSImportTree);
+    NODE_SET_METHOD(exports, "exportTree", VFSExportTree);
+    NODE_SET_METHOD(exports, "fragStats", VFSFragStats);
+    NODE_SET_METHOD(exports, "compact", VFSCompact);
+    NODE_SET_METHOD(exports, "startCompactor", VFSStartCompactor);
+    NODE_SET_METHOD(exports, "stopCompactor", VFSStopCompactor);
+    NODE_SET_METHOD(exports, "getStats", VFSGetStats);
+    NODE_SET_METHOD(exports, "resetStats", VFSResetStats);
 }
 
 NODE_MODULE(vfs_addon, Initialize)
\ No newline at end of file
@@ -0,0 +1,223 @@
+#include "vfs_batch.h"
+#include "vfs_disk.h"
+#include "vfs_utils.h"
+#include "vfs_replace.h"
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <cstdio>
+
+using namespace std;
+
+static bool Fail(BatchResult& result, const string& error) {
+    result.error = error;
+    return false;
+}
+
+static bool ApplyOp(const BatchOp& op, BatchResult& result) {
+    if (op.name.empty()) return Fail(result, "Filename required");
+
+    if (op.op == "create") {
+        if (FindFile(op.name) != -1) return Fail(result, "File already exists");
+        if (AllocateFile(op.name) == -1) return Fail(result, "Inode table full");
+        return result.ok = true;
+    }
+
+    int idx = FindFile(op.name);
+    if (idx == -1) return Fail(result, "File not found");
+    Inode& node = inodeTable[idx];
+
+    if (op.op == "write") {
+        // Replaces the whole content, like the addon's writeFile.
+        if (!WriteData(idx, 0, op.data.data(), op.data.size()) || !TruncateData(idx, op.data.size())) {
+            return Fail(result, WriteFailureReason());
+        }
+        node.cursor = node.size;
+        result.value = op.data.size();
+    }
+    else if (op.op == "append" || op.op == "writeat") {
+        int offset = op.op == "append" ? node.size : op.offset;
+        if (!WriteData(idx, offset, op.data.data(), op.data.size())) return Fail(result, WriteFailureReason());
+        result.value = op.data.size();
+    }
+    else if (op.op == "truncate") {
+        if (!TruncateData(idx, op.offset)) return Fail(result, WriteFailureReason());
+        result.value = node.size;
+    }
+    else if (op.op == "update") {
+        int replaced = ReplaceInData(idx, op.oldText, op.newText, op.nth);
+        if (replaced == 0) return Fail(result, "Text to replace not found");
+        if (replaced < 0) return Fail(result, ReplaceFailureReason(replaced));
+        node.cursor = node.size;
+        result.value = replaced;
+    }
+    else if (op.op == "delete") {
+        ReleaseFile(idx);
+    }
+    else {
+        return Fail(result, "Unknown operation '" + op.op + "'");
+    }
+    return result.ok = true;
+}
+
+// Applies all operations under one lock and persists them with one SaveDisk.
+// If any operation fails the whole batch is rolled back; its result carries
+// the error and the operations after it are reported as not run.
+bool RunBatch(const vector<BatchOp>& ops, vector<BatchResult>& results) {
+    lock_guard<mutex> lock(vfsMutex);
+    results.assign(ops.size(), BatchResult());
+
+    BeginTransaction();
+    for (size_t i = 0; i < ops.size(); ++i) {
+        if (!ApplyOp(ops[i], results[i])) {
+            RollbackTransaction();
+            for (size_t j = 0; j < i; ++j) {
+                results[j].ok = false;
+                results[j].error = "Rolled back";
+            }
+            for (size_t j = i + 1; j < ops.size(); ++j) results[j].error = "Not run";
+            return false;
+        }
+    }
+    CommitTransaction();
+    return true;
+}
+
+// Splits a batch line into words. Double quotes group words and accept the
+// escapes \" \\ \n and \t, so contents with spaces or newlines fit on one line.
+vector<string> SplitBatchLine(const string& line) {
+    vector<string> words;
+    string word;
+    bool inWord = false, quoted = false;
+    for (size_t i = 0; i < line.size(); ++i) {
+        char c = line[i];
+        if (quoted) {
+            if (c == '"') quoted = false;
+            else if (c == '\\' && i + 1 < line.size()) {
+                char e = line[++i];
+                word += e == 'n' ? '\n' : e == 't' ? '\t' : e;
+            }
+            else word += c;
+        }
+        else if (c == '"') quoted = inWord = true;
+        else if (c == ' ' || c == '\t' || c == '\r') {
+            if (inWord) words.push_back(word);
+            word.clear();
+            inWord = false;
+        }
+        else {
+            word += c;
+            inWord = true;
+        }
+    }
+    if (quoted) throw invalid_argument("unterminated quote");
+    if (inWord) words.push_back(word);
+    return words;
+}
+
+// Inverse of SplitBatchLine for one word: quotes it only when needed.
+string QuoteBatchWord(const string& word) {
+    if (!word.empty() && word.find_first_of(" \t\r\n\"\\") == string::npos) return word;
+    string out = "\"";
+    for (size_t i = 0; i < word.size(); ++i) {
+        char c = word[i];
+        if (c == '"' || c == '\\') { out += '\\'; out += c; }
+        else if (c == '\n') out += "\\n";
+        else if (c == '\t') out += "\\t";
+        else out += c;
+    }
+    return out + "\"";
+}
+
+static string Join(const vector<string>& words, size_t first) {
+    string text;
+    for (size_t i = first; i < words.size(); ++i) {
+        if (i > first) text += " ";
+        text += words[i];
+    }
+    return text;
+}
+
+static bool ParseOp(const string& line, BatchOp& op) {
+    vector<string> w = SplitBatchLine(line);
+    if (w.size() < 2) return false;
+    op.op = w[0];
+    op.name = w[1];
+    if ((op.op == "create" || op.op == "delete") && w.size() == 2) return true;
+    if ((op.op == "write" || op.op == "append") && w.size() >= 3) {
+        op.data = Join(w, 2);
+        return true;
+    }
+    if (op.op == "writeat" && w.size() >= 4) {
+        op.offset = stoi(w[2]);
+        op.data = Join(w, 3);
+        return true;
+    }
+    if (op.op == "truncate" && w.size() == 3) {
+        op.offset = stoi(w[2]);
+        return true;
+    }
+    if (op.op == "update" && (w.size() == 4 || w.size() == 5)) {
+        op.oldText = w[2];
+        op.newText = w[3];
+        op.nth = w.size() == 4 ? 1 : (w[4] == "all" ? 0 : stoi(w[4]));
+        return true;
+    }
+    return false;
+}
+
+static string JsonString(const string& text) {
+    string out = "\"";
+    for (size_t i = 0; i < text.size(); ++i) {
+        unsigned char c = text[i];
+        if (c == '"' || c == '\\') { out += '\\'; out += c; }
+        else if (c == '\n') out += "\\n";
+        else if (c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        }
+        else out += c;
+    }
+    return out + "\"";
+}
+
+// CLI batch mode: reads one operation per line (same syntax as the single
+// commands, blank lines and lines starting with # ignored), runs them as one
+// batch and prints the per-operation results as a JSON array.
+bool RunBatchScript(istream& in) {
+    vector<BatchOp> ops;
+    string line;
+    int lineNo = 0;
+    while (getline(in, line)) {
+        ++lineNo;
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == string::npos || line[start] == '#') continue;
+        BatchOp op;
+        bool parsed;
+        try {
+            parsed = ParseOp(line, op);
+        } catch (const logic_error&) {
+            parsed = false;
+        }
+        if (!parsed) {
+            cout << "Error: Invalid batch operation on line " << lineNo << ".\n";
+            return false;
+        }
+        ops.push_back(op);
+    }
+
+    vector<BatchResult> results;
+    bool ok = RunBatch(ops, results);
+
+    cout << "[";
+    for (size_t i = 0; i < ops.size(); ++i) {
+        cout << (i ? ",\n " : "") << "{\"op\":" << JsonString(ops[i].op) << ",\"name\":" << JsonString(ops[i].name)
+             << ",\"ok\":" << (results[i].ok ? "true" : "false");
+        if (results[i].ok) cout << ",\"value\":" << results[i].value;
+        else cout << ",\"error\":" << JsonString(results[i].error);
+        cout << "}";
+    }
+    cout << "]\n";
+    return ok;
+}
@@ -0,0 +1,34 @@
+#ifndef VFS_BATCH_H
+#define VFS_BATCH_H
+
+#include <string>
+#include <vector>
+#include <istream>
+
+// One operation of a batch. Which fields are used depends on `op`:
+//   create <name> | write <name> <data> | append <name> <data>
+//   writeat <name> <offset> <data> | truncate <name> <size>
+//   update <name> <oldText> <newText> [nth] | delete <name>
+struct BatchOp {
+    std::string op;
+    std::string name;
+    std::string data;
+    std::string oldText;
+    std::string newText;
+    int offset = 0;
+    int nth = 1;
+};
+
+struct BatchResult {
+    bool ok = false;
+    std::string error;
+    int value = 0;  // bytes written, new size or number of replacements
+};
+
+bool RunBatch(const std::vector<BatchOp>& ops, std::vector<BatchResult>& results);
+bool RunBatchScript(std::istream& in);
+
+std::vector<std::string> SplitBatchLine(const std::string& line);
+std::string QuoteBatchWord(const std::string& word);
+
+#endif
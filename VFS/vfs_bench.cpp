@@ -0,0 +1,376 @@
+#include "vfs_disk.h"
+#include "vfs_utils.h"
+#include "vfs_crypto.h"
+#include "vfs_replace.h"
+#include "vfs_fileops.h"
+#include "vfs_shell.h"
+#include "vfs_batch.h"
+#include "vfs_readahead.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <map>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <mutex>
+
+using namespace std;
+
+// VFS benchmark suite. Every result is one line, or one JSON object per line
+// with --json, keyed by bench/op/params so runs of different versions can be
+// compared directly.
+//
+// crypto:  plain vs encrypted throughput on the block data path
+//          (WriteData/ReadData), without the SaveDisk cost both share.
+// replace: substring search on a multi-MB buffer (FindPattern vs
+//          std::string::find) and ReplaceInData on a near-full-disk file.
+// stream:  one large encrypted file read front to back in 4 KB pieces, with
+//          read-ahead off, filled inline, and filled by its thread.
+// ops:     create/write/read/update/list/delete through the same functions
+//          the CLI runs, at several file counts and sizes, SaveDisk included.
+// replay:  re-runs a trace recorded with VFS_TRACE=<file> (one CLI command
+//          per line) and reports per-command latency.
+
+const string BENCH_IMAGE = "vfs_bench.img";
+
+static bool jsonOutput = false;
+
+struct Sample {
+    vector<double> micros;
+    double bytes = 0;
+};
+
+// Discards output of the fileops functions while they are being timed.
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    streamsize xsputn(const char*, streamsize n) override { return n; }
+};
+
+class QuietCout {
+public:
+    QuietCout() : saved(cout.rdbuf(&sink)) {}
+    ~QuietCout() { cout.rdbuf(saved); }
+private:
+    NullBuffer sink;
+    streambuf* saved;
+};
+
+template <class F>
+static void Timed(Sample& sample, F operation) {
+    auto start = chrono::steady_clock::now();
+    operation();
+    chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+    sample.micros.push_back(elapsed.count());
+}
+
+static double Percentile(const vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t rank = (size_t)(p * sorted.size() + 0.999999);
+    return sorted[min(sorted.size() - 1, rank ? rank - 1 : 0)];
+}
+
+static void Report(const string& bench, const string& op, const string& params, Sample& sample) {
+    vector<double> sorted = sample.micros;
+    sort(sorted.begin(), sorted.end());
+    double total = 0;
+    for (double us : sorted) total += us;
+    double seconds = total / 1e6;
+    double opsPerSec = seconds > 0 ? sorted.size() / seconds : 0;
+    double mbPerSec = seconds > 0 ? sample.bytes / (1024.0 * 1024.0) / seconds : 0;
+
+    if (jsonOutput) {
+        cout << fixed << setprecision(3)
+             << "{\"bench\":\"" << bench << "\",\"op\":\"" << op << "\",\"params\":\"" << params << "\""
+             << ",\"count\":" << sorted.size() << ",\"seconds\":" << setprecision(6) << seconds << setprecision(3)
+             << ",\"ops_per_sec\":" << opsPerSec << ",\"mb_per_sec\":" << mbPerSec
+             << ",\"p50_us\":" << Percentile(sorted, 0.50) << ",\"p99_us\":" << Percentile(sorted, 0.99)
+             << ",\"p999_us\":" << Percentile(sorted, 0.999) << "}\n";
+        return;
+    }
+    cout << fixed << setprecision(1) << left
+         << setw(8) << bench << setw(13) << op << setw(24) << params << right
+         << setw(11) << opsPerSec << " ops/s" << setw(10) << mbPerSec << " MB/s"
+         << "   p50 " << setw(8) << Percentile(sorted, 0.50) << "us"
+         << "  p99 " << setw(8) << Percentile(sorted, 0.99) << "us"
+         << "  p999 " << setw(8) << Percentile(sorted, 0.999) << "us\n";
+}
+
+static void ResetVolume() {
+    for (int i = 0; i < MAX_FILES; ++i) {
+        if (inodeTable[i].used) ReleaseFile(i);
+    }
+}
+
+static bool RunCrypto(bool encrypted, int rounds) {
+    encryptNewFiles = encrypted;
+    ResetVolume();
+    for (int i = 0; i < MAX_FILES; ++i) {
+        if (AllocateFile("bench" + to_string(i)) == -1) {
+            cout << "Error: could not allocate benchmark files.\n";
+            return false;
+        }
+    }
+
+    vector<char> payload(BLOCK_SIZE);
+    for (int i = 0; i < BLOCK_SIZE; ++i) payload[i] = 'a' + i % 26;
+    vector<char> readBack(BLOCK_SIZE);
+
+    Sample writes, reads;
+    for (int r = 0; r < rounds; ++r) {
+        for (int i = 0; i < MAX_FILES; ++i) Timed(writes, [&] { WriteData(i, 0, payload.data(), BLOCK_SIZE); });
+    }
+    for (int r = 0; r < rounds; ++r) {
+        for (int i = 0; i < MAX_FILES; ++i) Timed(reads, [&] { ReadData(i, 0, readBack.data(), BLOCK_SIZE); });
+    }
+    writes.bytes = reads.bytes = (double)rounds * MAX_FILES * BLOCK_SIZE;
+
+    if (memcmp(payload.data(), readBack.data(), BLOCK_SIZE) != 0) {
+        cout << "Error: read back data does not match.\n";
+        return false;
+    }
+    string params = encrypted ? "mode=encrypted" : "mode=plain";
+    Report("crypto", "write", params, writes);
+    Report("crypto", "read", params, reads);
+    return true;
+}
+
+static bool RunReplace(int megabytes) {
+    // Random lower-case text with the needle planted every 64 KB.
+    const string needle = "lockfs-marker";
+    size_t n = (size_t)megabytes * 1024 * 1024;
+    string text(n, ' ');
+    unsigned int seed = 12345;
+    for (size_t i = 0; i < n; ++i) {
+        seed = seed * 1103515245 + 12345;
+        text[i] = 'a' + (seed >> 16) % 26;
+    }
+    for (size_t at = 0; at + needle.size() < n; at += 64 * 1024) text.replace(at, needle.size(), needle);
+
+    Sample fast, std;
+    int fastHits = 0, stdHits = 0;
+    Timed(fast, [&] {
+        for (const char* p = text.data(); (p = FindPattern(p, text.data() + n - p, needle.data(), needle.size())); p += needle.size()) ++fastHits;
+    });
+    Timed(std, [&] {
+        for (size_t p = 0; (p = text.find(needle, p)) != string::npos; p += needle.size()) ++stdHits;
+    });
+    if (fastHits != stdHits) {
+        cout << "Error: FindPattern found " << fastHits << " matches, std::string::find " << stdHits << ".\n";
+        return false;
+    }
+    fast.bytes = std.bytes = n;
+    string params = "size=" + to_string(megabytes) + "MB";
+    Report("replace", "FindPattern", params, fast);
+    Report("replace", "string::find", params, std);
+
+    // Replace-all through the VFS on a file using most of the disk.
+    for (int pass = 0; pass < 2; ++pass) {
+        bool encrypted = pass == 1;
+        encryptNewFiles = encrypted;
+        ResetVolume();
+        int size = DISK_SIZE - 64 * BLOCK_SIZE;
+        int idx = AllocateFile("replace");
+        if (idx == -1 || !WriteData(idx, 0, text.data(), size)) {
+            cout << "Error: could not create the replace file.\n";
+            return false;
+        }
+        Sample same, grow;
+        int sameCount = 0, growCount = 0;
+        Timed(same, [&] { sameCount = ReplaceInData(idx, needle, "LOCKFS-MARKER", 0); });
+        Timed(grow, [&] { growCount = ReplaceInData(idx, "LOCKFS-MARKER", "lockfs-marker-v2", 0); });
+        if (sameCount <= 0 || growCount != sameCount) {
+            cout << "Error: replace returned " << sameCount << " and " << growCount << ".\n";
+            return false;
+        }
+        same.bytes = grow.bytes = size;
+        params = string(encrypted ? "mode=encrypted" : "mode=plain") + " size=" + to_string(size / 1024) + "KB";
+        Report("replace", "same-length", params, same);
+        Report("replace", "longer-text", params, grow);
+    }
+    encryptNewFiles = true;
+    return true;
+}
+
+static bool RunStream(int rounds) {
+    const int fileSize = 768 * BLOCK_SIZE;
+    const int chunk = 4096;
+    encryptNewFiles = true;
+    ResetVolume();
+    int idx = AllocateFile("stream");
+    vector<char> payload(fileSize);
+    for (int i = 0; i < fileSize; ++i) payload[i] = (char)(i * 7 + i / 4096);
+    if (idx == -1 || !WriteData(idx, 0, payload.data(), fileSize)) {
+        cout << "Error: could not write the benchmark file.\n";
+        return false;
+    }
+
+    const char* modes[] = {"off", "inline", "thread"};
+    vector<char> readBack(fileSize);
+    for (const char* mode : modes) {
+        readaheadEnabled = string(mode) != "off";
+        if (string(mode) == "thread") StartReadahead();
+        ReadaheadReset();
+        Sample reads;
+        for (int r = 0; r < rounds; ++r) {
+            for (int offset = 0; offset < fileSize; offset += chunk) {
+                Timed(reads, [&] {
+                    lock_guard<mutex> lock(vfsMutex);
+                    ReadData(idx, offset, &readBack[offset], min(chunk, fileSize - offset));
+                });
+            }
+        }
+        StopReadahead();
+        reads.bytes = (double)rounds * fileSize;
+        if (readBack != payload) {
+            cout << "Error: read back data does not match (readahead " << mode << ").\n";
+            return false;
+        }
+        Report("stream", "read", string("readahead=") + mode, reads);
+    }
+    readaheadEnabled = true;
+    return true;
+}
+
+static bool RunOps(int iterations) {
+    const int fileCounts[] = {10, 100};
+    const int fileSizes[] = {64, 1024, 8192};
+
+    for (int files : fileCounts) {
+        for (int size : fileSizes) {
+            if ((long)files * ((size + BLOCK_SIZE - 1) / BLOCK_SIZE) > MAX_BLOCKS || files > MAX_FILES) continue;
+
+            string payload(size, 'x');
+            payload.replace(size / 2 - 3, 6, "marker");
+            Sample creates, writes, reads, updates, lists, deletes;
+
+            for (int it = 0; it < iterations; ++it) {
+                ResetVolume();
+                SaveDisk();
+                QuietCout quiet;
+                for (int i = 0; i < files; ++i) Timed(creates, [&] { CreateFile("f" + to_string(i)); });
+                for (int i = 0; i < files; ++i) Timed(writes, [&] { WriteFile("f" + to_string(i), payload); });
+                for (int i = 0; i < files; ++i) Timed(reads, [&] { ReadFile("f" + to_string(i)); });
+                for (int i = 0; i < files; ++i) Timed(updates, [&] { UpdateFile("f" + to_string(i), "marker", "MARKER", 1); });
+                for (int i = 0; i < files; ++i) Timed(lists, [&] { ListFiles(); });
+                for (int i = 0; i < files; ++i) Timed(deletes, [&] { DeleteFile("f" + to_string(i)); });
+            }
+            writes.bytes = reads.bytes = updates.bytes = (double)iterations * files * size;
+
+            string params = "files=" + to_string(files) + " size=" + to_string(size);
+            Report("ops", "create", params, creates);
+            Report("ops", "write", params, writes);
+            Report("ops", "read", params, reads);
+            Report("ops", "update", params, updates);
+            Report("ops", "list", params, lists);
+            Report("ops", "delete", params, deletes);
+        }
+    }
+    return true;
+}
+
+static bool RunReplay(const string& tracePath, const string& fromImage) {
+    ifstream trace(tracePath);
+    if (!trace) {
+        cout << "Error: Cannot open trace " << tracePath << ".\n";
+        return false;
+    }
+    if (!fromImage.empty()) {
+        ifstream src(fromImage, ios::binary);
+        ofstream dst(BENCH_IMAGE, ios::binary);
+        if (!src || !(dst << src.rdbuf())) {
+            cout << "Error: Cannot copy " << fromImage << ".\n";
+            return false;
+        }
+        dst.close();
+        if (!LoadDisk()) return false;
+    }
+
+    map<string, Sample> perCommand;
+    Sample all;
+    string line;
+    int lineNo = 0;
+    while (getline(trace, line)) {
+        ++lineNo;
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == string::npos || line[start] == '#') continue;
+        vector<string> args;
+        try {
+            args = SplitBatchLine(line);
+        } catch (const logic_error&) {
+            cout << "Error: Invalid trace line " << lineNo << ".\n";
+            return false;
+        }
+
+        Sample& sample = perCommand[args[0]];
+        {
+            QuietCout quiet;
+            Timed(sample, [&] { RunCommand(args, ""); });
+        }
+        all.micros.push_back(sample.micros.back());
+        size_t first = args[0] == "writeat" ? 3 : 2;
+        if (args[0] == "write" || args[0] == "append" || args[0] == "writeat") {
+            for (size_t i = first; i < args.size(); ++i) sample.bytes += args[i].size() + (i > first ? 1 : 0);
+        }
+    }
+
+    string params = "trace=" + tracePath.substr(tracePath.find_last_of("/\\") + 1);
+    for (auto& entry : perCommand) Report("replay", entry.first, params, entry.second);
+    for (auto& entry : perCommand) all.bytes += entry.second.bytes;
+    Report("replay", "all", params, all);
+    return true;
+}
+
+static void Usage() {
+    cout << "Usage: vfs_bench [--json] [crypto [rounds] | replace [megabytes] | ops [iterations] |\n"
+         << "                            stream [rounds] | replay <trace> [--from <image>]]\n"
+         << "With no mode, runs crypto, replace, stream and ops.\n";
+}
+
+int main(int argc, char* argv[]) {
+    vector<string> args(argv + 1, argv + argc);
+    if (!args.empty() && args[0] == "--json") {
+        jsonOutput = true;
+        args.erase(args.begin());
+    }
+    string mode = args.empty() ? "all" : args[0];
+    int count = 0;
+    if (mode != "replay" && args.size() > 1) count = atoi(args[1].c_str());
+    if ((mode != "all" && mode != "crypto" && mode != "replace" && mode != "ops" && mode != "stream" &&
+         mode != "replay") ||
+        count < 0 || (mode == "replay" && args.size() != 2 && !(args.size() == 4 && args[2] == "--from"))) {
+        Usage();
+        return 1;
+    }
+    // Never touch the real image, nor a trace being recorded: replay would
+    // otherwise append every command to the trace it is reading.
+    diskPath = BENCH_IMAGE;
+#ifdef _WIN32
+    _putenv_s("VFS_TRACE", "");
+#else
+    unsetenv("VFS_TRACE");
+#endif
+    if (!LoadVolumeKey()) {
+        cout << "Error: volume key unavailable.\n";
+        return 1;
+    }
+    bool ok = true;
+    if (mode == "all" || mode == "crypto") {
+        int rounds = count ? count : 200;
+        ok = RunCrypto(false, rounds) && RunCrypto(true, rounds);
+    }
+    if (ok && (mode == "all" || mode == "replace")) ok = RunReplace(count ? count : 8);
+    if (ok && (mode == "all" || mode == "stream")) ok = RunStream(count ? count : 20);
+    if (ok && (mode == "all" || mode == "ops")) ok = RunOps(count ? count : 3);
+    if (ok && mode == "replay") ok = RunReplay(args[1], args.size() == 4 ? args[3] : "");
+
+    ResetVolume();
+    remove(BENCH_IMAGE.c_str());
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+#include "vfs_checksum.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <nmmintrin.h>
+#define VFS_CRC_X86 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define VFS_CRC_ARM 1
+#endif
+
+static uint32_t crcTable[256];
+
+static bool BuildTable() {
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k) c = (c >> 1) ^ (0x82F63B78 & (0 - (c & 1)));
+        crcTable[i] = c;
+    }
+    return true;
+}
+
+static uint32_t SoftwareCrc(const unsigned char* p, size_t n, uint32_t crc) {
+    static const bool built = BuildTable();
+    (void)built;
+    while (n--) crc = crcTable[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+#ifdef VFS_CRC_X86
+// Compiled for SSE4.2 on its own, so the rest of the build does not need
+// -msse4.2; only called after the CPU check below.
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((target("sse4.2")))
+#endif
+static uint32_t HardwareCrc(const unsigned char* p, size_t n, uint32_t crc) {
+    uint64_t c = crc;
+    for (; n >= 8; n -= 8, p += 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        c = _mm_crc32_u64(c, word);
+    }
+    uint32_t c32 = (uint32_t)c;
+    for (; n; --n) c32 = _mm_crc32_u8(c32, *p++);
+    return c32;
+}
+
+static bool CpuHasCrc() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 20)) != 0;
+#else
+    return __builtin_cpu_supports("sse4.2");
+#endif
+}
+#elif defined(VFS_CRC_ARM)
+static uint32_t HardwareCrc(const unsigned char* p, size_t n, uint32_t crc) {
+    for (; n >= 8; n -= 8, p += 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        crc = __crc32cd(crc, word);
+    }
+    for (; n; --n) crc = __crc32cb(crc, *p++);
+    return crc;
+}
+
+static bool CpuHasCrc() {
+    return true;  // __ARM_FEATURE_CRC32 means the target guarantees it
+}
+#endif
+
+static bool UseHardware() {
+#if defined(VFS_CRC_X86) || defined(VFS_CRC_ARM)
+    static const bool hardware = CpuHasCrc();
+    return hardware;
+#else
+    return false;
+#endif
+}
+
+uint32_t Crc32c(const void* data, size_t length) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+#if defined(VFS_CRC_X86) || defined(VFS_CRC_ARM)
+    if (UseHardware()) return ~HardwareCrc(p, length, 0xFFFFFFFF);
+#endif
+    return ~SoftwareCrc(p, length, 0xFFFFFFFF);
+}
+
+const char* Crc32cImplementation() {
+#if defined(VFS_CRC_X86)
+    if (UseHardware()) return "sse4.2";
+#elif defined(VFS_CRC_ARM)
+    if (UseHardware()) return "armv8-crc";
+#endif
+    return "table";
+}
@@ -0,0 +1,12 @@
+#ifndef VFS_CHECKSUM_H
+#define VFS_CHECKSUM_H
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC32C (Castagnoli), using the SSE4.2 or ARMv8 CRC instructions when the
+// CPU has them and a lookup table otherwise.
+uint32_t Crc32c(const void* data, size_t length);
+const char* Crc32cImplementation();
+
+#endif
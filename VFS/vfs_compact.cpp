@@ -0,0 +1,148 @@
+#include "vfs_compact.h"
+#include "vfs_disk.h"
+#include "vfs_readahead.h"
+#include "vfs_stripe.h"
+#include "vfs_index.h"
+#include <iostream>
+#include <cstring>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+
+using namespace std;
+
+// The compacted layout packs files from block 0 in inode order, each file's
+// data blocks in chain order followed by its spilled attribute blocks.
+// Blocks a snapshot references cannot move (the snapshot's block map points
+// at them), so they and their slots are stepped over, as are blocks
+// quarantined by scrub.
+static bool Movable(int block) {
+    return blockPins[block] == 0 && blockMap[block] != BLOCK_BAD;
+}
+
+// Finds the first block that is not in its slot of the compacted layout.
+// Returns false when every movable block is in place.
+static bool NextMisplaced(int& block, int& target) {
+    int t = 0;
+    auto misplaced = [&](int first) {
+        for (int b = first; b != BLOCK_END; b = blockMap[b]) {
+            if (!Movable(b)) continue;
+            while (t < MAX_BLOCKS && !Movable(t)) ++t;
+            if (b != t) {
+                block = b;
+                target = t;
+                return true;
+            }
+            ++t;
+        }
+        return false;
+    };
+    for (int i = 0; i < MAX_FILES; ++i) {
+        if (!inodeTable[i].used) continue;
+        if (misplaced(inodeTable[i].startBlock) || misplaced(inodeTable[i].xattrBlock)) return true;
+    }
+    return false;
+}
+
+// Exchanges two movable blocks: their data, their block map entries and
+// every chain link or inode that points at either of them. Free blocks hold
+// zeros, so swapping with one moves the data and leaves a clean free block.
+// Encryption is by file offset and write generation, so moved data needs no
+// re-encryption.
+static void SwapBlocks(int x, int y) {
+    MarkBlockDirty(x);
+    MarkBlockDirty(y);
+    auto relabel = [x, y](int b) { return b == x ? y : (b == y ? x : b); };
+    for (int b = 0; b < MAX_BLOCKS; ++b) {
+        if (blockMap[b] >= 0) blockMap[b] = relabel(blockMap[b]);
+    }
+    swap(blockMap[x], blockMap[y]);
+    for (Inode& node : inodeTable) {
+        if (node.used && node.startBlock >= 0) node.startBlock = relabel(node.startBlock);
+        if (node.used && node.xattrBlock >= 0) node.xattrBlock = relabel(node.xattrBlock);
+    }
+    swap_ranges(diskData.begin() + (long)BLOCK_SIZE * x, diskData.begin() + (long)BLOCK_SIZE * (x + 1),
+                diskData.begin() + (long)BLOCK_SIZE * y);
+    // Damage flags, the checksums they are judged by and the write
+    // generations move with the data.
+    swap(blockCrc[x], blockCrc[y]);
+    swap(blockGeneration[x], blockGeneration[y]);
+    bool badX = badBlocks[x];
+    badBlocks[x] = badBlocks[y];
+    badBlocks[y] = badX;
+    IndexBlock(x);
+    IndexBlock(y);
+}
+
+bool CompactStep(long budgetMicros, int& moved) {
+    moved = 0;
+    if (mountedSnapshot != -1) return true;  // a mounted snapshot is read-only: nothing to do
+    auto deadline = chrono::steady_clock::now() + chrono::microseconds(budgetMicros);
+    int block, target;
+    while (NextMisplaced(block, target)) {
+        if (moved == 0) ReadaheadReset();
+        SwapBlocks(block, target);
+        ++moved;
+        if (chrono::steady_clock::now() >= deadline) return false;
+    }
+    return true;
+}
+
+FragStats GetFragStats() {
+    FragStats stats = {};
+    for (const Inode& node : inodeTable) {
+        if (node.used && node.dataInline) ++stats.inlineFiles;
+        if (!node.used || node.startBlock == BLOCK_END) continue;
+        ++stats.files;
+        int runs = 0;
+        int prev = -2;
+        for (int b = node.startBlock; b != BLOCK_END; b = blockMap[b]) {
+            ++stats.usedBlocks;
+            if (b != prev + 1) ++runs;
+            prev = b;
+        }
+        stats.fragments += runs;
+        if (runs > 1) ++stats.fragmentedFiles;
+    }
+
+    stats.extentBlocks = UsedBlockExtent();
+    for (int b = 0; b < MAX_BLOCKS; ++b) {
+        if (blockPins[b] > 0) ++stats.pinnedBlocks;
+        if (b < stats.extentBlocks && blockMap[b] == BLOCK_FREE && blockPins[b] == 0) ++stats.holes;
+    }
+    stats.imageBytes = VolumeFileBytes();
+    stats.allocatedBytes = VolumeAllocatedBytes();
+    return stats;
+}
+
+void PrintFragStats(ostream& out, const FragStats& stats) {
+    out << "files: " << stats.files << ", blocks: " << stats.usedBlocks
+        << ", fragments: " << stats.fragments << " (" << stats.fragmentedFiles << " fragmented file"
+        << (stats.fragmentedFiles == 1 ? "" : "s") << "), inline: " << stats.inlineFiles << ", holes: " << stats.holes
+        << ", pinned: " << stats.pinnedBlocks << ", image: " << stats.imageBytes << " bytes ("
+        << stats.allocatedBytes << " allocated)\n";
+}
+
+// Compacts the whole volume in slices of `sliceMicros`, saving after each
+// slice, then cuts the image file down to the blocks still in use.
+void DefragVolume(long sliceMicros) {
+    cout << "Before: ";
+    PrintFragStats(cout, GetFragStats());
+
+    int total = 0;
+    int slices = 0;
+    bool done = false;
+    while (!done) {
+        int moved;
+        done = CompactStep(sliceMicros, moved);
+        total += moved;
+        ++slices;
+        SaveDisk();
+    }
+    TrimImage();
+
+    cout << "After:  ";
+    PrintFragStats(cout, GetFragStats());
+    cout << "Moved " << total << " block" << (total == 1 ? "" : "s") << " in " << slices << " slice"
+         << (slices == 1 ? "" : "s") << ".\n";
+}
@@ -0,0 +1,30 @@
+#ifndef VFS_COMPACT_H
+#define VFS_COMPACT_H
+
+#include <ostream>
+
+struct FragStats {
+    int files;           // files with at least one block
+    int usedBlocks;      // blocks held by live files
+    int fragments;       // runs of consecutive blocks summed over all files
+    int fragmentedFiles; // files made of more than one run
+    int inlineFiles;     // files stored in their inode, without blocks
+    int holes;           // unused blocks below the end of the image
+    int extentBlocks;    // blocks the image has to store
+    int pinnedBlocks;    // blocks kept in place by snapshots
+    long imageBytes;     // current size of the image (and stripe) files
+    long allocatedBytes; // disk space they take up, free blocks being holes
+};
+
+FragStats GetFragStats();
+void PrintFragStats(std::ostream& out, const FragStats& stats);
+
+// Moves blocks toward their compacted position for at most `budgetMicros`
+// and reports how many were moved. Each step leaves the volume consistent,
+// so callers can save, unlock and resume later. Returns true once the volume
+// is fully compacted.
+bool CompactStep(long budgetMicros, int& moved);
+
+void DefragVolume(long sliceMicros);
+
+#endif
@@ -0,0 +1,146 @@
+#include "vfs_crypto.h"
+#include "vfs_disk.h"
+#include "vfs_stats.h"
+#include "../Cryption/src/app/encryptDecrypt/AES.hpp"
+#include <openssl/rand.h>
+#include <openssl/crypto.h>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+bool encryptNewFiles = true;
+
+static unsigned char volumeKey[AES_KEY_LENGTH];
+static bool volumeKeyLoaded = false;
+
+// Unwrapped per-file keys, so the key unwrap is paid once per file rather
+// than once per block operation. The wrapped key they came from is kept
+// alongside, so a reloaded or reused inode never picks up a stale entry.
+static vector<unsigned char> fileKeys(MAX_FILES * AES_KEY_LENGTH);
+static vector<unsigned char> cachedWrappedKeys(MAX_FILES * AES_WRAPPED_KEY_LENGTH);
+static vector<bool> fileKeyLoaded(MAX_FILES, false);
+
+// Whether the live volume or a snapshot holds files encrypted under the
+// volume key, i.e. whether a new key would make them unreadable.
+static bool VolumeHasEncryptedFiles() {
+    for (const Inode& node : inodeTable) {
+        if (node.used && node.encrypted) return true;
+    }
+    for (const Snapshot& snap : snapshots) {
+        if (!snap.used) continue;
+        for (const Inode& node : snap.inodes) {
+            if (node.used && node.encrypted) return true;
+        }
+    }
+    return false;
+}
+
+// KEY_NAME in the image's directory, so the image and its key stay
+// together whatever directory vfs runs in.
+static string KeyPath() {
+    return (filesystem::path(diskPath).parent_path() / KEY_NAME).string();
+}
+
+// The volume key comes from $VFS_KEY, otherwise from KEY_NAME next to the
+// image. A random one is generated on first use, but never for a volume
+// that already has encrypted files: their key is missing, not new.
+bool LoadVolumeKey() {
+    if (volumeKeyLoaded) return true;
+
+    const char* envKey = getenv("VFS_KEY");
+    if (envKey && strlen(envKey) >= (size_t)AES_KEY_LENGTH) {
+        memcpy(volumeKey, envKey, AES_KEY_LENGTH);
+        volumeKeyLoaded = true;
+        return true;
+    }
+
+    string path = KeyPath();
+    ifstream fin(path, ios::binary);
+    if (fin) {
+        fin.read(reinterpret_cast<char*>(volumeKey), AES_KEY_LENGTH);
+        volumeKeyLoaded = fin.gcount() == AES_KEY_LENGTH;
+        return volumeKeyLoaded;
+    }
+
+    if (VolumeHasEncryptedFiles()) {
+        static bool reported = false;
+        if (!reported) {
+            cerr << "Error: " << diskPath << " has encrypted files but " << path
+                 << " is missing; set VFS_KEY or put the key file back.\n";
+            reported = true;
+        }
+        return false;
+    }
+    if (RAND_bytes(volumeKey, AES_KEY_LENGTH) != 1) return false;
+    ofstream fout(path, ios::binary);
+    fout.write(reinterpret_cast<const char*>(volumeKey), AES_KEY_LENGTH);
+    volumeKeyLoaded = fout.good();
+    return volumeKeyLoaded;
+}
+
+bool InitFileKey(Inode& node) {
+    node.encrypted = false;
+    if (!encryptNewFiles) return true;
+    // Without a key new files are stored in plain text, unless the volume's
+    // key has gone missing.
+    if (!LoadVolumeKey()) return !VolumeHasEncryptedFiles();
+
+    unsigned char key[AES_KEY_LENGTH];
+    if (RAND_bytes(key, AES_KEY_LENGTH) != 1 || RAND_bytes(node.nonce, sizeof(node.nonce)) != 1) return false;
+    bool ok = aesWrapKey(volumeKey, key, node.wrappedKey);
+    OPENSSL_cleanse(key, AES_KEY_LENGTH);
+    node.encrypted = ok;
+    return ok;
+}
+
+static const unsigned char* FileKey(int idx) {
+    unsigned char* key = &fileKeys[idx * AES_KEY_LENGTH];
+    unsigned char* wrapped = &cachedWrappedKeys[idx * AES_WRAPPED_KEY_LENGTH];
+    if (!fileKeyLoaded[idx] || memcmp(wrapped, inodeTable[idx].wrappedKey, AES_WRAPPED_KEY_LENGTH) != 0) {
+        StatAdd(STAT_KEY_CACHE_MISSES, 1);
+        fileKeyLoaded[idx] = false;
+        if (!LoadVolumeKey() || !aesUnwrapKey(volumeKey, inodeTable[idx].wrappedKey, key)) return nullptr;
+        memcpy(wrapped, inodeTable[idx].wrappedKey, AES_WRAPPED_KEY_LENGTH);
+        fileKeyLoaded[idx] = true;
+    }
+    else {
+        StatAdd(STAT_KEY_CACHE_HITS, 1);
+    }
+    return key;
+}
+
+uint64_t NextWriteGeneration() {
+    return ++writeGeneration;
+}
+
+// The generation goes into the high half of the counter block and the file
+// offset counts up in the low half, so no two (generation, offset) pairs
+// share keystream.
+static void GenerationNonce(const unsigned char* nonce, uint64_t generation, unsigned char* out) {
+    memcpy(out, nonce, AES_BLOCK_SIZE);
+    for (int i = 0; i < 8; ++i) out[i] ^= (unsigned char)(generation >> (56 - 8 * i));
+    memset(out + 8, 0, 8);
+}
+
+// Encrypts or decrypts (AES-CTR is symmetric) `len` bytes in place that sit
+// at byte `offset` of file `idx` and were written under `generation`.
+// Plain-text files are left untouched.
+bool CryptRange(int idx, int offset, char* data, int len, uint64_t generation) {
+    if (!inodeTable[idx].encrypted || len <= 0) return true;
+    const unsigned char* key = FileKey(idx);
+    if (!key) return false;
+    unsigned char nonce[AES_BLOCK_SIZE];
+    GenerationNonce(inodeTable[idx].nonce, generation, nonce);
+    unsigned char* buf = reinterpret_cast<unsigned char*>(data);
+    return aesCtrCrypt(buf, buf, len, key, nonce, offset);
+}
+
+void ForgetFileKey(int idx) {
+    OPENSSL_cleanse(&fileKeys[idx * AES_KEY_LENGTH], AES_KEY_LENGTH);
+    fileKeyLoaded[idx] = false;
+}
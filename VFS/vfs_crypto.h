@@ -0,0 +1,22 @@
+#ifndef VFS_CRYPTO_H
+#define VFS_CRYPTO_H
+
+#include <cstdint>
+#include "inode.h"
+
+// When false, new files are stored in plain text (existing files keep the
+// mode they were created with).
+extern bool encryptNewFiles;
+
+// File data is AES-CTR encrypted under a per-file key. The counter block is
+// the file's nonce combined with a write generation, plus the file offset.
+// Every write of a block (or of inline data) re-encrypts it under a fresh
+// generation from a volume-wide counter, so rewriting an offset never reuses
+// keystream, even while a snapshot keeps the old ciphertext.
+bool LoadVolumeKey();
+bool InitFileKey(Inode& node);
+uint64_t NextWriteGeneration();
+bool CryptRange(int idx, int offset, char* data, int len, uint64_t generation);
+void ForgetFileKey(int idx);
+
+#endif
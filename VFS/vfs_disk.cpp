@@ -1,20 +1,538 @@
 #include "vfs_disk.h"
 #include <fstream>
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+#include "vfs_stats.h"
+#include "vfs_checksum.h"
+#include "vfs_readahead.h"
+#include "vfs_stripe.h"
+#include "vfs_index.h"
+#include "vfs_utils.h"
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
 std::vector<Inode> inodeTable(MAX_FILES);
+std::vector<int> blockMap(MAX_BLOCKS, BLOCK_FREE);
 std::vector<char> diskData(DISK_SIZE, 0);
+std::string diskPath = DISK_NAME;
+std::mutex vfsMutex;
+std::vector<Snapshot> snapshots(MAX_SNAPSHOTS);
+std::vector<int> blockPins(MAX_BLOCKS, 0);
+int mountedSnapshot = -1;
+std::vector<uint32_t> inodeCrc(MAX_FILES, 0);
+std::vector<uint32_t> blockCrc(MAX_BLOCKS, 0);
+std::vector<bool> badInodes(MAX_FILES, false);
+std::vector<bool> badBlocks(MAX_BLOCKS, false);
+std::vector<uint64_t> blockGeneration(MAX_BLOCKS, 0);
+uint64_t writeGeneration = 0;
 
-void LoadDisk() {
-    std::ifstream fin(DISK_NAME, std::ios::binary);
+// Image layout: superblock, stripe layout, inode table, block map, inode and
+// block checksums, the write generation counter and block generations,
+// snapshot slots, then the data blocks (those of stripe 0 when the volume is
+// striped). The data area only extends to the last block in use, so the file
+// shrinks when the volume is compacted. The original layout (0) had no
+// superblock: raw inodes whose startBlock was a byte offset into a fixed
+// data area.
+const long INODES_OFFSET = sizeof(SuperBlock) + sizeof(StripeLayout);
+const long MAP_OFFSET = INODES_OFFSET + sizeof(Inode) * MAX_FILES;
+const long INODE_CRC_OFFSET = MAP_OFFSET + sizeof(int) * MAX_BLOCKS;
+const long BLOCK_CRC_OFFSET = INODE_CRC_OFFSET + sizeof(uint32_t) * MAX_FILES;
+const long GENERATIONS_OFFSET = BLOCK_CRC_OFFSET + sizeof(uint32_t) * MAX_BLOCKS;
+const long SNAPSHOTS_OFFSET = GENERATIONS_OFFSET + sizeof(uint64_t) * (1 + MAX_BLOCKS);
+const long DATA_OFFSET = SNAPSHOTS_OFFSET + sizeof(Snapshot) * MAX_SNAPSHOTS;
+
+// Inodes of the original layout. `used` is read as a byte so a file that is
+// not such an image cannot produce an invalid bool.
+struct InodeV0 {
+    char fileName[100];
+    int startBlock;
+    int size;
+    int cursor;
+    unsigned char used;
+};
+
+// Lock on <image>.lock while the image is read (shared) or written
+// (exclusive), so `vfs --snapshot` never loads an image another process is
+// halfway through saving. The lock file rather than the image is locked
+// because Windows locks are mandatory: they would also block our own writes
+// through the ofstream. Without a usable lock file the image is used unlocked.
+class ImageLock {
+public:
+    explicit ImageLock(bool exclusive) {
+        std::string path = diskPath + ".lock";
+#ifdef _WIN32
+        handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_ALWAYS,
+                             FILE_ATTRIBUTE_NORMAL, NULL);
+        if (handle == INVALID_HANDLE_VALUE) return;
+        OVERLAPPED at{};
+        if (!LockFileEx(handle, exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0, 0, 1, 0, &at)) {
+            CloseHandle(handle);
+            handle = INVALID_HANDLE_VALUE;
+        }
+#else
+        fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+        if (fd < 0) return;
+        int result;
+        while ((result = flock(fd, exclusive ? LOCK_EX : LOCK_SH)) != 0 && errno == EINTR) {
+        }
+        if (result != 0) {
+            close(fd);
+            fd = -1;
+        }
+#endif
+    }
+    ~ImageLock() {
+#ifdef _WIN32
+        if (handle == INVALID_HANDLE_VALUE) return;
+        OVERLAPPED at{};
+        UnlockFileEx(handle, 0, 1, 0, &at);
+        CloseHandle(handle);
+#else
+        if (fd < 0) return;
+        flock(fd, LOCK_UN);
+        close(fd);
+#endif
+    }
+    ImageLock(const ImageLock&) = delete;
+    ImageLock& operator=(const ImageLock&) = delete;
+
+private:
+#ifdef _WIN32
+    HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
+};
+
+// What the image on disk holds as of the last load or save. SaveDisk only
+// writes back the inodes, block map entries and blocks that differ from it.
+static std::vector<Inode> savedInodes;
+static std::vector<int> savedBlockMap;
+static std::vector<bool> dirtyBlocks(MAX_BLOCKS, false);
+static std::vector<bool> dirtySnapshots(MAX_SNAPSHOTS, false);
+static bool imageInSync = false;
+// Set when the image exists but could not be read; SaveDisk then leaves it
+// alone rather than replacing it with the empty tables.
+static bool imageUnreadable = false;
+
+// Undo information for the open transaction: the tables as they were at
+// BeginTransaction (with the checksums and damage flags, and the snapshots
+// and their pins), and the original contents of each block the first time
+// it is modified.
+static bool inTransaction = false;
+static std::vector<Inode> txInodes;
+static std::vector<int> txBlockMap;
+static std::vector<bool> txDirtyBlocks;
+static std::vector<bool> txBadInodes;
+static std::vector<uint32_t> txInodeCrc;
+static std::vector<bool> txBadBlocks;
+static std::vector<uint32_t> txBlockCrc;
+static std::vector<uint64_t> txBlockGeneration;
+static std::vector<Snapshot> txSnapshots;
+static std::vector<int> txBlockPins;
+static std::vector<bool> txDirtySnapshots;
+static std::vector<int> txUndoSlot(MAX_BLOCKS, -1);
+static std::vector<char> txUndoData;
+
+static void MarkInSync() {
+    savedInodes = inodeTable;
+    savedBlockMap = blockMap;
+    dirtyBlocks.assign(MAX_BLOCKS, false);
+    dirtySnapshots.assign(MAX_SNAPSHOTS, false);
+    imageInSync = true;
+}
+
+void RecountBlockPins() {
+    blockPins.assign(MAX_BLOCKS, 0);
+    for (const Snapshot& snap : snapshots) {
+        if (!snap.used) continue;
+        for (int b = 0; b < MAX_BLOCKS; ++b) {
+            if (InChain(snap.blockMap[b])) ++blockPins[b];
+        }
+    }
+}
+
+static uint32_t BlockChecksum(int block) {
+    return Crc32c(&diskData[(long)BLOCK_SIZE * block], BLOCK_SIZE);
+}
+
+// Recomputes the checksums of all entries not known to be damaged.
+static void RefreshAllChecksums() {
+    for (int i = 0; i < MAX_FILES; ++i) {
+        if (!badInodes[i]) inodeCrc[i] = Crc32c(&inodeTable[i], sizeof(Inode));
+    }
+    for (int b = 0; b < MAX_BLOCKS; ++b) {
+        if (!badBlocks[b]) blockCrc[b] = BlockChecksum(b);
+    }
+}
+
+// Flags every inode and in-use block whose data does not match its checksum.
+static void VerifyChecksums() {
+    int inodes = 0, blocks = 0;
+    for (int i = 0; i < MAX_FILES; ++i) {
+        badInodes[i] = Crc32c(&inodeTable[i], sizeof(Inode)) != inodeCrc[i];
+        inodes += badInodes[i];
+    }
+    for (int b = 0; b < MAX_BLOCKS; ++b) {
+        badBlocks[b] = BlockInUse(b) && BlockChecksum(b) != blockCrc[b];
+        blocks += badBlocks[b];
+    }
+    if (inodes || blocks) {
+        std::cerr << "Warning: " << inodes << " inode(s) and " << blocks << " block(s) in " << diskPath
+                  << " failed their checksum; reads of them will fail. Run scrub for details.\n";
+    }
+}
+
+// Empties the tables, as for a new disk.
+static void ClearTables() {
+    inodeTable.assign(MAX_FILES, Inode());
+    blockMap.assign(MAX_BLOCKS, BLOCK_FREE);
+    diskData.assign(DISK_SIZE, 0);
+    snapshots.assign(MAX_SNAPSHOTS, Snapshot());
+    blockPins.assign(MAX_BLOCKS, 0);
+    inodeCrc.assign(MAX_FILES, 0);
+    blockCrc.assign(MAX_BLOCKS, 0);
+    badInodes.assign(MAX_FILES, false);
+    badBlocks.assign(MAX_BLOCKS, false);
+    blockGeneration.assign(MAX_BLOCKS, 0);
+    writeGeneration = 0;
+}
+
+// Reads an image in the original layout and stores its files through the
+// normal write path (so they get blocks, keys and checksums). False, with
+// the tables left empty, if the file is not such an image.
+static bool UpgradeV0Image(std::istream& in) {
+    in.clear();
+    in.seekg(0);
+    std::vector<InodeV0> old(MAX_FILES);
+    in.read(reinterpret_cast<char*>(&old[0]), sizeof(InodeV0) * MAX_FILES);
+    if (!in) return false;
+    std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    for (const InodeV0& node : old) {
+        if (node.used > 1) return false;
+        if (!node.used) continue;
+        if (memchr(node.fileName, '\0', sizeof(node.fileName)) == nullptr || node.fileName[0] == '\0' ||
+            node.startBlock < 0 || node.size < 0 || (long)node.startBlock + node.size > (long)data.size()) {
+            return false;
+        }
+    }
+
+    ClearTables();
+    RebuildIndex();
+    for (const InodeV0& node : old) {
+        if (!node.used) continue;
+        int idx = AllocateFile(node.fileName);
+        if (idx == -1 || !WriteData(idx, 0, &data[node.startBlock], node.size)) {
+            ClearTables();
+            return false;
+        }
+        // seek accepted any position in the file's fixed 1 KB slot, also
+        // past its end; one outside the disk can only be damage.
+        inodeTable[idx].cursor = node.cursor >= 0 && node.cursor < DISK_SIZE ? node.cursor : node.size;
+    }
+    return true;
+}
+
+// Moves the counter past every generation still in use, in case the image
+// was last saved by a process that died before writing the counter.
+static void SkipUsedGenerations() {
+    for (uint64_t generation : blockGeneration) writeGeneration = std::max(writeGeneration, generation);
+    for (const Inode& node : inodeTable) writeGeneration = std::max(writeGeneration, node.inlineGeneration);
+    for (const Snapshot& snap : snapshots) {
+        for (const Inode& node : snap.inodes) writeGeneration = std::max(writeGeneration, node.inlineGeneration);
+    }
+}
+
+static bool ValidStripeLayout(StripeLayout& layout) {
+    for (auto& path : layout.paths) path[STRIPE_PATH_LENGTH - 1] = '\0';
+    return layout.count >= 1 && layout.count <= MAX_STRIPES && layout.unit >= 1 && layout.unit <= MAX_BLOCKS;
+}
+
+// Leaves the tables empty and the image untouched.
+static bool RefuseImage(const std::string& reason) {
+    std::cerr << "Error: " << diskPath << " " << reason << "; it is left untouched.\n";
+    ClearTables();
+    imageInSync = false;
+    imageUnreadable = true;
+    RebuildIndex();
+    return false;
+}
+
+bool LoadDisk() {
+    StatTimer timer(STAT_LOAD);
+    stripeLayout = StripeLayout{1, 1, {}};
+    imageUnreadable = false;
+    ImageLock lock(false);
+    std::ifstream fin(diskPath, std::ios::binary);
     if (fin) {
+        SuperBlock sb{};
+        fin.read(reinterpret_cast<char*>(&sb), sizeof(SuperBlock));
+        if (!fin || memcmp(sb.magic, VFS_MAGIC, sizeof(VFS_MAGIC)) != 0) {
+            if (!UpgradeV0Image(fin)) return RefuseImage("is not a VFS image or is damaged");
+            // Rewritten in the current layout on the next save; the original is kept.
+            std::error_code ec;
+            std::filesystem::copy_file(diskPath, diskPath + ".v0.bak",
+                                       std::filesystem::copy_options::skip_existing, ec);
+            std::cerr << "Note: upgraded " << diskPath << " from the original layout"
+                      << (ec ? "" : " (the old image is kept as " + diskPath + ".v0.bak)") << ".\n";
+            imageInSync = false;
+            RefreshAllChecksums();
+            ReadaheadReset();
+            return true;
+        }
+        StripeLayout layout{1, 1, {}};
+        fin.read(reinterpret_cast<char*>(&layout), sizeof(StripeLayout));
+        if (!fin || sb.version != VFS_VERSION || sb.maxFiles != MAX_FILES || sb.blockSize != BLOCK_SIZE ||
+            sb.maxBlocks != MAX_BLOCKS || !ValidStripeLayout(layout)) {
+            return RefuseImage("has an unsupported layout");
+        }
+        stripeLayout = layout;
         fin.read(reinterpret_cast<char*>(&inodeTable[0]), sizeof(Inode) * MAX_FILES);
-        fin.read(&diskData[0], DISK_SIZE);
+        fin.read(reinterpret_cast<char*>(&blockMap[0]), sizeof(int) * MAX_BLOCKS);
+        fin.read(reinterpret_cast<char*>(&inodeCrc[0]), sizeof(uint32_t) * MAX_FILES);
+        fin.read(reinterpret_cast<char*>(&blockCrc[0]), sizeof(uint32_t) * MAX_BLOCKS);
+        fin.read(reinterpret_cast<char*>(&writeGeneration), sizeof(uint64_t));
+        fin.read(reinterpret_cast<char*>(&blockGeneration[0]), sizeof(uint64_t) * MAX_BLOCKS);
+        fin.read(reinterpret_cast<char*>(&snapshots[0]), sizeof(Snapshot) * MAX_SNAPSHOTS);
+        if (!fin) return RefuseImage("is truncated");
+
+        // Blocks past the end of the files were never used.
+        ReadStripeData(fin);
+        RecountBlockPins();
+        SkipUsedGenerations();
+        VerifyChecksums();
+        MarkInSync();
         fin.close();
     }
+    RebuildIndex();
+    ReadaheadReset();
+    return true;
 }
 
-void SaveDisk() {
-    std::ofstream fout(DISK_NAME, std::ios::binary);
+// Blocks holding data of a live file or of a snapshot.
+bool BlockInUse(int block) {
+    return InChain(blockMap[block]) || blockPins[block] > 0;
+}
+
+// Number of blocks the image has to hold: up to the last block used by the
+// live volume or by a snapshot.
+int UsedBlockExtent() {
+    for (int b = MAX_BLOCKS - 1; b >= 0; --b) {
+        if (blockMap[b] != BLOCK_FREE || blockPins[b] > 0) return b + 1;
+    }
+    return 0;
+}
+
+// Makes the next SaveDisk write the whole image, e.g. to repair damaged
+// metadata from the in-memory copy.
+void RewriteImage() {
+    imageInSync = false;
+}
+
+long DataOffset() {
+    return DATA_OFFSET;
+}
+
+bool ImageInSync() {
+    return imageInSync;
+}
+
+// Reads the inode table and its checksums as stored in the image file.
+bool ReadImageInodes(std::vector<Inode>& inodes, std::vector<uint32_t>& crcs) {
+    ImageLock lock(false);
+    std::ifstream fin(diskPath, std::ios::binary);
+    inodes.resize(MAX_FILES);
+    crcs.resize(MAX_FILES);
+    fin.seekg(INODES_OFFSET);
+    fin.read(reinterpret_cast<char*>(&inodes[0]), sizeof(Inode) * MAX_FILES);
+    fin.seekg(INODE_CRC_OFFSET);
+    fin.read(reinterpret_cast<char*>(&crcs[0]), sizeof(uint32_t) * MAX_FILES);
+    return static_cast<bool>(fin);
+}
+
+// Cuts the image and stripe files back to the blocks in use. Call after SaveDisk.
+bool TrimImage() {
+    if (mountedSnapshot != -1 || !imageInSync) return false;
+    ImageLock lock(true);
+    return TrimStripes(DATA_OFFSET, UsedBlockExtent());
+}
+
+static void SaveFullDisk() {
+    SuperBlock sb{};
+    memcpy(sb.magic, VFS_MAGIC, sizeof(VFS_MAGIC));
+    sb.version = VFS_VERSION;
+    sb.maxFiles = MAX_FILES;
+    sb.blockSize = BLOCK_SIZE;
+    sb.maxBlocks = MAX_BLOCKS;
+
+    StatAdd(STAT_FULL_SAVES, 1);
+    RefreshAllChecksums();
+    long dataBytes = (long)BLOCK_SIZE * UsedBlockExtent();
+    StatAdd(STAT_PERSIST_BYTES, DATA_OFFSET + dataBytes);
+    std::ofstream fout(diskPath, std::ios::binary);
+    fout.write(reinterpret_cast<const char*>(&sb), sizeof(SuperBlock));
+    fout.write(reinterpret_cast<const char*>(&stripeLayout), sizeof(StripeLayout));
     fout.write(reinterpret_cast<const char*>(&inodeTable[0]), sizeof(Inode) * MAX_FILES);
-    fout.write(&diskData[0], DISK_SIZE);
+    fout.write(reinterpret_cast<const char*>(&blockMap[0]), sizeof(int) * MAX_BLOCKS);
+    fout.write(reinterpret_cast<const char*>(&inodeCrc[0]), sizeof(uint32_t) * MAX_FILES);
+    fout.write(reinterpret_cast<const char*>(&blockCrc[0]), sizeof(uint32_t) * MAX_BLOCKS);
+    fout.write(reinterpret_cast<const char*>(&writeGeneration), sizeof(uint64_t));
+    fout.write(reinterpret_cast<const char*>(&blockGeneration[0]), sizeof(uint64_t) * MAX_BLOCKS);
+    // Unused snapshot slots are all zeros; like free blocks they are left as
+    // holes, and the file is extended to the data area below if need be.
+    for (int i = 0; i < MAX_SNAPSHOTS; ++i) {
+        fout.seekp(SNAPSHOTS_OFFSET + sizeof(Snapshot) * i);
+        if (snapshots[i].used) fout.write(reinterpret_cast<const char*>(&snapshots[i]), sizeof(Snapshot));
+    }
+    fout.seekp(DATA_OFFSET);
+    bool dataWritten = WriteStripeData(fout, UsedBlockExtent());
     fout.close();
+    std::error_code ec;
+    uintmax_t fileBytes = std::filesystem::file_size(diskPath, ec);
+    if (!ec && fileBytes < (uintmax_t)DATA_OFFSET) std::filesystem::resize_file(diskPath, DATA_OFFSET, ec);
+    if (fout && dataWritten && !ec) MarkInSync();
+    else imageInSync = false;
+}
+
+void SaveDisk() {
+    // A mounted snapshot is read-only, and its tables must not be written
+    // over the live ones.
+    if (mountedSnapshot != -1 || imageUnreadable) return;
+    StatTimer timer(STAT_PERSIST);
+    ImageLock lock(true);
+    if (!imageInSync) {
+        SaveFullDisk();
+        return;
+    }
+
+    std::fstream fout(diskPath, std::ios::in | std::ios::out | std::ios::binary);
+    if (!fout) {
+        SaveFullDisk();
+        return;
+    }
+
+    for (int i = 0; i < MAX_FILES; ++i) {
+        if (memcmp(&inodeTable[i], &savedInodes[i], sizeof(Inode)) != 0) {
+            fout.seekp(INODES_OFFSET + sizeof(Inode) * i);
+            fout.write(reinterpret_cast<const char*>(&inodeTable[i]), sizeof(Inode));
+            if (!badInodes[i]) inodeCrc[i] = Crc32c(&inodeTable[i], sizeof(Inode));
+            fout.seekp(INODE_CRC_OFFSET + sizeof(uint32_t) * i);
+            fout.write(reinterpret_cast<const char*>(&inodeCrc[i]), sizeof(uint32_t));
+            StatAdd(STAT_PERSIST_BYTES, sizeof(Inode) + sizeof(uint32_t));
+        }
+    }
+
+    // Block map entries and data blocks are written in contiguous runs.
+    for (int b = 0; b < MAX_BLOCKS; ) {
+        if (blockMap[b] == savedBlockMap[b]) { ++b; continue; }
+        int end = b;
+        while (end < MAX_BLOCKS && blockMap[end] != savedBlockMap[end]) ++end;
+        fout.seekp(MAP_OFFSET + sizeof(int) * b);
+        fout.write(reinterpret_cast<const char*>(&blockMap[b]), sizeof(int) * (end - b));
+        StatAdd(STAT_PERSIST_BYTES, sizeof(int) * (end - b));
+        b = end;
+    }
+    // Data blocks go to their stripes in parallel; their checksums are in
+    // the image.
+    bool dataWritten = WriteDirtyStripes(fout, DATA_OFFSET, dirtyBlocks);
+    for (int b = 0; b < MAX_BLOCKS; ) {
+        if (!dirtyBlocks[b]) { ++b; continue; }
+        int end = b;
+        while (end < MAX_BLOCKS && dirtyBlocks[end]) ++end;
+        for (int d = b; d < end; ++d) {
+            if (!badBlocks[d]) blockCrc[d] = BlockChecksum(d);
+        }
+        fout.seekp(BLOCK_CRC_OFFSET + sizeof(uint32_t) * b);
+        fout.write(reinterpret_cast<const char*>(&blockCrc[b]), sizeof(uint32_t) * (end - b));
+        fout.seekp(GENERATIONS_OFFSET + sizeof(uint64_t) * (1 + b));
+        fout.write(reinterpret_cast<const char*>(&blockGeneration[b]), sizeof(uint64_t) * (end - b));
+        StatAdd(STAT_PERSIST_BYTES, (long)(BLOCK_SIZE + sizeof(uint32_t) + sizeof(uint64_t)) * (end - b));
+        b = end;
+    }
+    fout.seekp(GENERATIONS_OFFSET);
+    fout.write(reinterpret_cast<const char*>(&writeGeneration), sizeof(uint64_t));
+    for (int i = 0; i < MAX_SNAPSHOTS; ++i) {
+        if (!dirtySnapshots[i]) continue;
+        if (!snapshots[i].used && PunchHole(diskPath, SNAPSHOTS_OFFSET + sizeof(Snapshot) * i, sizeof(Snapshot))) continue;
+        fout.seekp(SNAPSHOTS_OFFSET + sizeof(Snapshot) * i);
+        fout.write(reinterpret_cast<const char*>(&snapshots[i]), sizeof(Snapshot));
+        StatAdd(STAT_PERSIST_BYTES, sizeof(Snapshot));
+    }
+
+    fout.close();
+    if (fout && dataWritten) MarkInSync();
+    else imageInSync = false;
+}
+
+// Must be called before a block's data is modified.
+void MarkBlockDirty(int block) {
+    if (inTransaction && txUndoSlot[block] == -1) {
+        txUndoSlot[block] = txUndoData.size() / BLOCK_SIZE;
+        const char* data = &diskData[(long)BLOCK_SIZE * block];
+        txUndoData.insert(txUndoData.end(), data, data + BLOCK_SIZE);
+    }
+    dirtyBlocks[block] = true;
+}
+
+void MarkSnapshotDirty(int slot) {
+    dirtySnapshots[slot] = true;
+}
+
+// Groups several operations so they are persisted with a single SaveDisk,
+// or undone together.
+void BeginTransaction() {
+    txInodes = inodeTable;
+    txBlockMap = blockMap;
+    txDirtyBlocks = dirtyBlocks;
+    txBadInodes = badInodes;
+    txInodeCrc = inodeCrc;
+    txBadBlocks = badBlocks;
+    txBlockCrc = blockCrc;
+    txBlockGeneration = blockGeneration;
+    txSnapshots = snapshots;
+    txBlockPins = blockPins;
+    txDirtySnapshots = dirtySnapshots;
+    txUndoSlot.assign(MAX_BLOCKS, -1);
+    txUndoData.clear();
+    inTransaction = true;
+}
+
+void CommitTransaction() {
+    inTransaction = false;
+    txUndoData.clear();
+    txSnapshots.clear();
+    SaveDisk();
+}
+
+void RollbackTransaction() {
+    for (int b = 0; b < MAX_BLOCKS; ++b) {
+        if (txUndoSlot[b] != -1) {
+            memcpy(&diskData[(long)BLOCK_SIZE * b], &txUndoData[(long)BLOCK_SIZE * txUndoSlot[b]], BLOCK_SIZE);
+        }
+    }
+    inodeTable = txInodes;
+    blockMap = txBlockMap;
+    dirtyBlocks = txDirtyBlocks;
+    badInodes = txBadInodes;
+    inodeCrc = txInodeCrc;
+    badBlocks = txBadBlocks;
+    blockCrc = txBlockCrc;
+    blockGeneration = txBlockGeneration;
+    snapshots = txSnapshots;
+    blockPins = txBlockPins;
+    dirtySnapshots = txDirtySnapshots;
+    inTransaction = false;
+    txUndoData.clear();
+    txSnapshots.clear();
+    RebuildIndex();
+    ReadaheadReset();
 }
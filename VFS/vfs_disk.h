@@ -2,12 +2,56 @@
 #define VFS_DISK_H
 
 #include <vector>
+#include <string>
+#include <mutex>
+#include <cstdint>
 #include "inode.h"
 
 extern std::vector<Inode> inodeTable;
+extern std::vector<int> blockMap;
 extern std::vector<char> diskData;
+extern std::string diskPath;
+extern std::mutex vfsMutex;
 
-void LoadDisk();
+// Snapshot slots, how many snapshots reference each block, and the slot
+// mounted read-only in place of the live tables (-1 for the live volume).
+extern std::vector<Snapshot> snapshots;
+extern std::vector<int> blockPins;
+extern int mountedSnapshot;
+
+// CRC32C of each inode and block as last written to the image, and the
+// entries whose stored data failed that check. Checksums are brought up to
+// date by SaveDisk; a flagged entry keeps its old checksum until it is fully
+// rewritten, so the damage stays detectable.
+extern std::vector<uint32_t> inodeCrc;
+extern std::vector<uint32_t> blockCrc;
+extern std::vector<bool> badInodes;
+extern std::vector<bool> badBlocks;
+
+// Write generation each block's data is encrypted under, and the last
+// generation handed out (see vfs_crypto.h). The counter only grows, also
+// across a rolled back transaction.
+extern std::vector<uint64_t> blockGeneration;
+extern uint64_t writeGeneration;
+
+// False if the image exists but cannot be read. The disk then starts empty
+// and SaveDisk will not write over the image.
+bool LoadDisk();
 void SaveDisk();
+void MarkBlockDirty(int block);
+void MarkSnapshotDirty(int slot);
+void RecountBlockPins();
+int UsedBlockExtent();
+bool BlockInUse(int block);
+bool TrimImage();
+void RewriteImage();
+long DataOffset();
+// True if the image matches the tables in memory, i.e. the last save worked.
+bool ImageInSync();
+bool ReadImageInodes(std::vector<Inode>& inodes, std::vector<uint32_t>& crcs);
+
+void BeginTransaction();
+void CommitTransaction();
+void RollbackTransaction();
 
 #endif
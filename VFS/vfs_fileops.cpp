@@ -1,9 +1,13 @@
 #include "vfs_fileops.h"
 #include "vfs_utils.h"
 #include "vfs_disk.h"
+#include "vfs_replace.h"
+#include "vfs_xattr.h"
+#include "vfs_index.h"
 #include <iostream>
 #include <cstring>
 #include <algorithm>
+#include <vector>
 
 using namespace std;
 
@@ -12,17 +16,11 @@ void CreateFile(const string& name) {
         cout << "Error: File already exists.\n";
         return;
     }
-    int idx = FindFreeInode();
-    int block = FindFreeBlock();
-    if (idx == -1 || block == -1) {
+    int idx = AllocateFile(name);
+    if (idx == -1) {
         cout << "Error: Disk full or inode table full.\n";
         return;
     }
-    strncpy(inodeTable[idx].fileName, name.c_str(), 100);
-    inodeTable[idx].startBlock = block;
-    inodeTable[idx].size = 0;
-    inodeTable[idx].cursor = 0;
-    inodeTable[idx].used = true;
     SaveDisk();
     cout << "File created.\n";
 }
@@ -33,16 +31,15 @@ void WriteFile(const string& name, const string& content) {
         cout << "Error: File not found.\n";
         return;
     }
-    if (content.size() > FILE_SIZE) {
+    if (content.size() > DISK_SIZE) {
         cout << "Error: Content too large.\n";
         return;
     }
-    int start = inodeTable[idx].startBlock + inodeTable[idx].cursor;
-    int remaining = FILE_SIZE - inodeTable[idx].cursor;
-    int toWrite = min((int)content.size(), remaining);
-    memcpy(&diskData[start], content.c_str(), toWrite);
-    inodeTable[idx].cursor += toWrite;
-    inodeTable[idx].size = max(inodeTable[idx].size, inodeTable[idx].cursor);
+    if (!WriteData(idx, inodeTable[idx].cursor, content.c_str(), content.size())) {
+        cout << "Error: " << WriteFailureReason() << ".\n";
+        return;
+    }
+    inodeTable[idx].cursor += content.size();
     SaveDisk();
     cout << "Write complete.\n";
 }
@@ -53,9 +50,11 @@ void ReadFile(const string& name) {
         cout << "Error: File not found.\n";
         return;
     }
-    int start = inodeTable[idx].startBlock;
-    int size = inodeTable[idx].size;
-    string content(diskData.begin() + start, diskData.begin() + start + size);
+    string content(inodeTable[idx].size, '\0');
+    if (!ReadData(idx, 0, &content[0], content.size())) {
+        cout << "Error: Read failed (checksum mismatch or decryption error).\n";
+        return;
+    }
     cout << "Content: " << content << "\n";
 }
 
@@ -65,7 +64,7 @@ void SeekFile(const string& name, int position) {
         cout << "Error: File not found.\n";
         return;
     }
-    if (position < 0 || position >= FILE_SIZE) {
+    if (position < 0 || position >= DISK_SIZE) {
         cout << "Error: Invalid seek position.\n";
         return;
     }
@@ -81,17 +80,18 @@ void UpdateFile(const string& name) {
         return;
     }
 
-    int start = inodeTable[idx].startBlock;
-    int size = inodeTable[idx].size;
-
-    string currentContent(diskData.begin() + start, diskData.begin() + start + size);
+    string currentContent(inodeTable[idx].size, '\0');
+    if (!ReadData(idx, 0, &currentContent[0], currentContent.size())) {
+        cout << "Error: Read failed (checksum mismatch or decryption error).\n";
+        return;
+    }
     cout << "Current content: \n" << currentContent << "\n";
 
     cout << "Enter the text to replace: ";
     string oldText;
     getline(cin, oldText);
 
-    if (currentContent.find(oldText) == string::npos) {
+    if (oldText.empty() || !FindPattern(currentContent.data(), currentContent.size(), oldText.data(), oldText.size())) {
         cout << "Error: Text to replace not found.\n";
         return;
     }
@@ -100,20 +100,102 @@ void UpdateFile(const string& name) {
     string newText;
     getline(cin, newText);
 
-    if (currentContent.size() - oldText.size() + newText.size() > FILE_SIZE) {
-        cout << "Error: New content exceeds file size.\n";
+    UpdateFile(name, oldText, newText, 1);
+}
+
+void UpdateFile(const string& name, const string& oldText, const string& newText, int nth) {
+    int idx = FindFile(name);
+    if (idx == -1) {
+        cout << "Error: File not found.\n";
+        return;
+    }
+    if (oldText.empty() || nth < 0) {
+        cout << "Error: Invalid replacement.\n";
+        return;
+    }
+
+    // A replacement that fails halfway leaves the file as it was.
+    BeginTransaction();
+    int replaced = ReplaceInData(idx, oldText, newText, nth);
+    if (replaced <= 0) {
+        RollbackTransaction();
+        if (replaced == 0) cout << "Error: Text to replace not found.\n";
+        else cout << "Error: " << ReplaceFailureReason(replaced) << ".\n";
+        return;
+    }
+    inodeTable[idx].cursor = inodeTable[idx].size;
+    CommitTransaction();
+    cout << "File updated successfully (" << replaced << " replacement" << (replaced == 1 ? "" : "s") << ").\n";
+}
+
+void ReadFileAt(const string& name, int offset, int length) {
+    int idx = FindFile(name);
+    if (idx == -1) {
+        cout << "Error: File not found.\n";
+        return;
+    }
+    if (offset < 0 || length < 0) {
+        cout << "Error: Invalid range.\n";
+        return;
+    }
+    int size = inodeTable[idx].size;
+    int toRead = offset >= size ? 0 : min(length, size - offset);
+    string content(toRead, '\0');
+    if (!ReadData(idx, offset, &content[0], toRead)) {
+        cout << "Error: Read failed (checksum mismatch or decryption error).\n";
+        return;
+    }
+    cout << "Content: " << content << "\n";
+}
+
+void WriteFileAt(const string& name, int offset, const string& data) {
+    int idx = FindFile(name);
+    if (idx == -1) {
+        cout << "Error: File not found.\n";
         return;
     }
+    if (offset < 0) {
+        cout << "Error: Invalid offset.\n";
+        return;
+    }
+    if (!WriteData(idx, offset, data.c_str(), data.size())) {
+        cout << "Error: " << WriteFailureReason() << ".\n";
+        return;
+    }
+    SaveDisk();
+    cout << "Wrote " << data.size() << " bytes at offset " << offset << ".\n";
+}
 
-    size_t pos = currentContent.find(oldText);
-    currentContent.replace(pos, oldText.size(), newText);
+void AppendFile(const string& name, const string& data) {
+    int idx = FindFile(name);
+    if (idx == -1) {
+        cout << "Error: File not found.\n";
+        return;
+    }
+    if (!WriteData(idx, inodeTable[idx].size, data.c_str(), data.size())) {
+        cout << "Error: " << WriteFailureReason() << ".\n";
+        return;
+    }
+    SaveDisk();
+    cout << "Appended " << data.size() << " bytes.\n";
+}
 
-    memset(&diskData[start], 0, FILE_SIZE);
-    memcpy(&diskData[start], currentContent.c_str(), currentContent.size());
-    inodeTable[idx].size = currentContent.size();
-    inodeTable[idx].cursor = currentContent.size();
+void TruncateFile(const string& name, int size) {
+    int idx = FindFile(name);
+    if (idx == -1) {
+        cout << "Error: File not found.\n";
+        return;
+    }
+    if (size < 0) {
+        cout << "Error: Invalid size.\n";
+        return;
+    }
+    if (!TruncateData(idx, size)) {
+        cout << "Error: " << WriteFailureReason() << ".\n";
+        return;
+    }
     SaveDisk();
-    cout << "File updated successfully.\n";
+    cout << "File truncated to " << size << " bytes.\n";
 }
 
 void DeleteFile(const string& name) {
@@ -122,19 +204,24 @@ void DeleteFile(const string& name) {
         cout << "Error: File not found.\n";
         return;
     }
-    inodeTable[idx].used = false;
-    inodeTable[idx].size = 0;
-    inodeTable[idx].cursor = 0;
-    memset(&diskData[inodeTable[idx].startBlock], 0, FILE_SIZE);
+    ReleaseFile(idx);
     SaveDisk();
     cout << "File deleted.\n";
 }
 
-void ListFiles() {
-    for (int i = 0; i < MAX_FILES; ++i) {
-        if (inodeTable[i].used) {
-            cout << inodeTable[i].fileName << " (size: " << inodeTable[i].size
-                 << ", cursor: " << inodeTable[i].cursor << ")\n";
+// Lists the files, each with the requested attributes that it has.
+void ListFiles(const vector<string>& attrNames) {
+    vector<Xattr> attrs;
+    for (int i = NextUsedInode(0); i < MAX_FILES; i = NextUsedInode(i + 1)) {
+        cout << inodeTable[i].fileName << " (size: " << inodeTable[i].size
+             << ", cursor: " << inodeTable[i].cursor << ")";
+        if (!attrNames.empty() && GetXattrs(i, attrs)) {
+            for (const string& name : attrNames) {
+                for (const Xattr& attr : attrs) {
+                    if (attr.name == name) cout << " " << name << "=" << FormatXattr(attr);
+                }
+            }
         }
+        cout << "\n";
     }
 }
@@ -2,13 +2,19 @@
 #define VFS_FILEOPS_H
 
 #include <string>
+#include <vector>
 
 void CreateFile(const std::string& name);
 void WriteFile(const std::string& name, const std::string& content);
 void ReadFile(const std::string& name);
 void SeekFile(const std::string& name, int position);
 void UpdateFile(const std::string& name);
+void UpdateFile(const std::string& name, const std::string& oldText, const std::string& newText, int nth = 1);
+void ReadFileAt(const std::string& name, int offset, int length);
+void WriteFileAt(const std::string& name, int offset, const std::string& data);
+void AppendFile(const std::string& name, const std::string& data);
+void TruncateFile(const std::string& name, int size);
 void DeleteFile(const std::string& name);
-void ListFiles();
+void ListFiles(const std::vector<std::string>& attrNames = {});
 
 #endif
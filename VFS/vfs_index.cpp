@@ -0,0 +1,170 @@
+#include "vfs_index.h"
+#include "vfs_disk.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+const int WORD_BITS = 64;
+const int INODE_WORDS = (MAX_FILES + WORD_BITS - 1) / WORD_BITS;
+const int BLOCK_WORDS = (MAX_BLOCKS + WORD_BITS - 1) / WORD_BITS;
+
+// Smallest power of two with at least two buckets per inode.
+int BucketCount() {
+    int n = 1;
+    while (n < MAX_FILES * 2) n <<= 1;
+    return n;
+}
+
+const int BUCKETS = BucketCount();
+
+vector<uint64_t> usedInodes(INODE_WORDS, 0);   // bit set: inode in use
+vector<uint64_t> freeBlocks(BLOCK_WORDS, 0);   // bit set: block free and unpinned
+vector<uint32_t> nameHashes(MAX_FILES, 0);     // of each used inode's name
+vector<int> bucketHeads(BUCKETS, -1);          // first inode in each hash bucket
+vector<int> nextInBucket(MAX_FILES, -1);
+bool built = false;
+
+int CountTrailingZeros(uint64_t word) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return (int)index;
+#else
+    return __builtin_ctzll(word);
+#endif
+}
+
+int PopCount(uint64_t word) {
+#ifdef _MSC_VER
+    return (int)__popcnt64(word);
+#else
+    return __builtin_popcountll(word);
+#endif
+}
+
+bool TestBit(const vector<uint64_t>& bits, int i) {
+    return (bits[i / WORD_BITS] >> (i % WORD_BITS)) & 1;
+}
+
+void SetBit(vector<uint64_t>& bits, int i, bool value) {
+    uint64_t mask = uint64_t(1) << (i % WORD_BITS);
+    if (value) bits[i / WORD_BITS] |= mask;
+    else bits[i / WORD_BITS] &= ~mask;
+}
+
+// FNV-1a.
+uint32_t HashName(const char* name, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i) hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+    return hash;
+}
+
+void Unlink(int idx) {
+    int* link = &bucketHeads[nameHashes[idx] & (BUCKETS - 1)];
+    while (*link != idx) link = &nextInBucket[*link];
+    *link = nextInBucket[idx];
+    nextInBucket[idx] = -1;
+}
+
+void Link(int idx) {
+    const char* name = inodeTable[idx].fileName;
+    nameHashes[idx] = HashName(name, strnlen(name, sizeof(Inode::fileName)));
+    int& head = bucketHeads[nameHashes[idx] & (BUCKETS - 1)];
+    nextInBucket[idx] = head;
+    head = idx;
+}
+
+bool BlockFree(int block) {
+    return blockMap[block] == BLOCK_FREE && blockPins[block] == 0;
+}
+
+// The tables are usable before the first LoadDisk, so the index is built on
+// first use.
+void EnsureBuilt() {
+    if (!built) RebuildIndex();
+}
+
+}
+
+void RebuildIndex() {
+    built = true;
+    usedInodes.assign(INODE_WORDS, 0);
+    bucketHeads.assign(BUCKETS, -1);
+    nextInBucket.assign(MAX_FILES, -1);
+    for (int i = 0; i < MAX_FILES; ++i) {
+        if (!inodeTable[i].used) continue;
+        SetBit(usedInodes, i, true);
+        Link(i);
+    }
+    freeBlocks.assign(BLOCK_WORDS, 0);
+    for (int b = 0; b < MAX_BLOCKS; ++b) {
+        if (BlockFree(b)) SetBit(freeBlocks, b, true);
+    }
+}
+
+void IndexInode(int idx) {
+    EnsureBuilt();
+    if (TestBit(usedInodes, idx)) Unlink(idx);
+    SetBit(usedInodes, idx, inodeTable[idx].used);
+    if (inodeTable[idx].used) Link(idx);
+}
+
+void IndexBlock(int block) {
+    EnsureBuilt();
+    SetBit(freeBlocks, block, BlockFree(block));
+}
+
+int IndexFreeInode() {
+    EnsureBuilt();
+    for (int w = 0; w < INODE_WORDS; ++w) {
+        uint64_t unused = ~usedInodes[w];
+        if (unused == 0) continue;
+        int i = w * WORD_BITS + CountTrailingZeros(unused);
+        return i < MAX_FILES ? i : -1;
+    }
+    return -1;
+}
+
+int IndexFreeBlock() {
+    EnsureBuilt();
+    for (int w = 0; w < BLOCK_WORDS; ++w) {
+        if (freeBlocks[w]) return w * WORD_BITS + CountTrailingZeros(freeBlocks[w]);
+    }
+    return -1;
+}
+
+int IndexCountFreeBlocks(int limit) {
+    EnsureBuilt();
+    int count = 0;
+    for (int w = 0; w < BLOCK_WORDS && count < limit; ++w) count += PopCount(freeBlocks[w]);
+    return count;
+}
+
+int IndexFindFile(const string& name) {
+    EnsureBuilt();
+    uint32_t hash = HashName(name.data(), name.size());
+    for (int i = bucketHeads[hash & (BUCKETS - 1)]; i != -1; i = nextInBucket[i]) {
+        if (nameHashes[i] == hash && name == inodeTable[i].fileName) return i;
+    }
+    return -1;
+}
+
+int NextUsedInode(int from) {
+    EnsureBuilt();
+    if (from >= MAX_FILES) return MAX_FILES;
+    int w = from / WORD_BITS;
+    uint64_t word = usedInodes[w] & (~uint64_t(0) << (from % WORD_BITS));
+    while (true) {
+        if (word) return min(MAX_FILES, w * WORD_BITS + CountTrailingZeros(word));
+        if (++w == INODE_WORDS) return MAX_FILES;
+        word = usedInodes[w];
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef VFS_INDEX_H
+#define VFS_INDEX_H
+
+#include <string>
+
+// Packed in-memory companions of the inode table and block map, so the hot
+// scans do not walk whole Inode records (about 400 bytes each) to test one
+// field: a bitmap of used inodes and one of free blocks, scanned 64 entries
+// at a time with count-trailing-zeros, and a hash index from file name to
+// inode. The image still stores Inode records; the index is derived from the
+// tables and kept up to date by the functions in vfs_utils.cpp.
+
+// Rebuilds everything from inodeTable, blockMap and blockPins, after they
+// were replaced as a whole (load, rollback, snapshot mount and unmount).
+void RebuildIndex();
+// Call after inode `idx` was claimed or released.
+void IndexInode(int idx);
+// Call after a block's map entry or pin count changed.
+void IndexBlock(int block);
+
+// First unused inode, or -1.
+int IndexFreeInode();
+// First block that is free and not held by a snapshot, or -1.
+int IndexFreeBlock();
+// Number of such blocks, counting no further than `limit`.
+int IndexCountFreeBlocks(int limit);
+// Inode of the live file called `name`, or -1.
+int IndexFindFile(const std::string& name);
+// First used inode at or after `from`, or MAX_FILES.
+int NextUsedInode(int from);
+
+#endif
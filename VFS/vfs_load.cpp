@@ -0,0 +1,448 @@
+#include "vfs_disk.h"
+#include "vfs_utils.h"
+#include "vfs_crypto.h"
+#include "vfs_fileops.h"
+#include "../Cryption/src/app/encryptDecrypt/Cryption.hpp"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+using namespace std;
+namespace fs = std::filesystem;
+
+// LockFS load generator. Replays the mix of operations LockFS/main.js issues
+// against Cryption and the VFS, from several threads and optionally at a fixed
+// arrival rate, and reports throughput and p50/p99 latency per operation:
+//
+// upload:  write saved/<name>, encrypt it in place, vfs create + vfs write
+// save:    write saved/<name>, encrypt it in place, vfs write
+// open:    decrypt saved/<name> in place, read it, encrypt it again
+//          (decryptAndReadFile, used to open protected files)
+// list:    vfs ls
+//
+// The exec backend runs the encrypt_decrypt and vfs programs once per step,
+// as main.js does. The inproc backend calls the same functions from this
+// process, with the VFS held in memory and derived keys cached, the way the
+// addon would. Everything happens in a scratch directory (vfs_load_data by
+// default) with its own saved/, image and volume key.
+
+struct LoadOptions {
+    string backend = "inproc";
+    int threads = 4;
+    double rate = 0;          // arrivals per second, 0 = as fast as the threads go
+    int requests = 400;
+    int files = 32;
+    int size = 1024;
+    int mix[4] = {1, 3, 5, 1};
+    string password = "LockBox";
+    string dir = "vfs_load_data";
+    string vfsProgram = "./vfs";
+    string cryptionProgram = "../Cryption/encrypt_decrypt";
+    unsigned seed = 1;
+    bool json = false;
+};
+
+enum LoadOp { OP_UPLOAD, OP_SAVE, OP_OPEN, OP_LIST, OP_COUNT };
+const char* const LOAD_OP_NAMES[OP_COUNT] = {"upload", "save", "open", "list"};
+
+struct Request {
+    LoadOp op;
+    int file;                 // pool file for save/open, upload slot for upload
+    double due;               // seconds after the start, when rate-limited
+};
+
+struct OpStats {
+    mutex lock;
+    vector<double> micros;
+    int errors = 0;
+};
+
+static LoadOptions options;
+static OpStats stats[OP_COUNT];
+static vector<mutex> fileLocks;       // one per pool file and upload slot
+static vector<char> slotUsed;         // upload slots holding a file from an earlier lap
+static mutex vfsExecMutex;
+static string payload;
+static bool execBackend = false;    // set once the pool is in place
+
+// The encryption side of the inproc backend: one KDF salt for the run, like
+// a batch job, so the password is stretched once instead of once per step.
+static KdfParams sessionParams;
+static DerivedKeyCache keyCache;
+
+static string PoolName(int file) {
+    return file < options.files ? "f" + to_string(file) : "upload" + to_string(file - options.files);
+}
+
+static string SavedPath(const string& name) {
+    return "saved/" + name;
+}
+
+// The VFS reports failures as "Error: ..." lines rather than exit codes.
+static bool VfsFailed(const string& output) {
+    return output.find("Error:") != string::npos;
+}
+
+static bool RunProgram(const string& command, string& output) {
+    FILE* pipe = popen((command + " 2>&1").c_str(), "r");
+    if (!pipe) return false;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), pipe)) > 0) output.append(buffer, n);
+    return pclose(pipe) == 0;
+}
+
+static bool ExecCryption(const string& name, const char* action) {
+    string output;
+    return RunProgram("\"" + options.cryptionProgram + "\" \"" + SavedPath(name) + "\" " + action + " " +
+                      options.password, output);
+}
+
+// Each vfs process loads the image and saves it back, and nothing locks the
+// image between processes, so the calls are run one at a time.
+static bool ExecVfs(const string& args) {
+    lock_guard<mutex> lock(vfsExecMutex);
+    string output;
+    return RunProgram("\"" + options.vfsProgram + "\" " + args, output) && !VfsFailed(output);
+}
+
+static bool CryptInProcess(const string& name, Action action) {
+    string path = SavedPath(name);
+    ifstream in(path, ios::binary);
+    if (!in) return false;
+    vector<unsigned char> contents((istreambuf_iterator<char>(in)), {});
+    in.close();
+
+    KdfParams params = sessionParams;
+    if (action == Action::DECRYPT && !readKdfHeader(path, params)) return false;
+    TaskKey key;
+    encodeKdfHeader(params, key.header);
+    if (!keyCache.get(options.password, params, key.key)) return false;
+
+    string error;
+    return transformContents(action, &key, nullptr, contents, error) && replaceFile(path, contents, nullptr, error);
+}
+
+// Runs a VFS function and SaveDisk like the CLI does, with cout captured so
+// failures can be told apart. Nothing else prints while vfsMutex is held.
+template <class F>
+static bool VfsInProcess(F operation) {
+    lock_guard<mutex> lock(vfsMutex);
+    ostringstream output;
+    streambuf* saved = cout.rdbuf(output.rdbuf());
+    operation();
+    SaveDisk();
+    cout.rdbuf(saved);
+    return !VfsFailed(output.str());
+}
+
+static bool Crypt(const string& name, Action action) {
+    if (execBackend) return ExecCryption(name, action == Action::ENCRYPT ? "e" : "d");
+    return CryptInProcess(name, action);
+}
+
+static bool VfsCreate(const string& name) {
+    if (execBackend) return ExecVfs("create \"" + name + "\"");
+    return VfsInProcess([&] { CreateFile(name); });
+}
+
+static bool VfsWrite(const string& name, const string& content) {
+    if (execBackend) return ExecVfs("write \"" + name + "\" \"" + content + "\"");
+    return VfsInProcess([&] { WriteFile(name, content); });
+}
+
+static bool VfsDelete(const string& name) {
+    if (execBackend) return ExecVfs("delete \"" + name + "\"");
+    return VfsInProcess([&] { DeleteFile(name); });
+}
+
+static bool VfsList() {
+    if (execBackend) return ExecVfs("ls");
+    return VfsInProcess([] { ListFiles(); });
+}
+
+// encryptAndSaveFile in main.js.
+static bool EncryptAndSave(const string& name) {
+    {
+        ofstream out(SavedPath(name), ios::binary | ios::trunc);
+        if (!(out << payload)) return false;
+    }
+    return Crypt(name, Action::ENCRYPT);
+}
+
+// decryptAndReadFile in main.js.
+static bool DecryptAndRead(const string& name) {
+    if (!Crypt(name, Action::DECRYPT)) return false;
+    ifstream in(SavedPath(name), ios::binary);
+    string content((istreambuf_iterator<char>(in)), {});
+    in.close();
+    bool reencrypted = Crypt(name, Action::ENCRYPT);
+    return reencrypted && content == payload;
+}
+
+static bool RunOp(const Request& request) {
+    string name = PoolName(request.file);
+    switch (request.op) {
+        case OP_UPLOAD: return EncryptAndSave(name) && VfsCreate(name) && VfsWrite(name, payload);
+        case OP_SAVE: return EncryptAndSave(name) && VfsWrite(name, payload);
+        case OP_OPEN: return DecryptAndRead(name);
+        case OP_LIST: return VfsList();
+        default: return false;
+    }
+}
+
+static vector<Request> Schedule() {
+    mt19937 rng(options.seed);
+    int totalWeight = 0;
+    for (int weight : options.mix) totalWeight += weight;
+    uniform_int_distribution<int> pickWeight(0, totalWeight - 1);
+    uniform_int_distribution<int> pickFile(0, options.files - 1);
+    exponential_distribution<double> gap(options.rate > 0 ? options.rate : 1);
+    int uploadSlots = (int)slotUsed.size();
+
+    vector<Request> requests;
+    double due = 0;
+    int uploads = 0;
+    for (int i = 0; i < options.requests; ++i) {
+        int w = pickWeight(rng);
+        int op = 0;
+        while (w >= options.mix[op]) w -= options.mix[op++];
+        Request request{(LoadOp)op, 0, 0};
+        if (request.op == OP_UPLOAD) request.file = options.files + uploads++ % uploadSlots;
+        else if (request.op != OP_LIST) request.file = pickFile(rng);
+        if (options.rate > 0) {
+            request.due = due;
+            due += gap(rng);
+        }
+        requests.push_back(request);
+    }
+    return requests;
+}
+
+static void Worker(const vector<Request>& requests, atomic<size_t>& next, chrono::steady_clock::time_point start) {
+    while (true) {
+        size_t i = next++;
+        if (i >= requests.size()) return;
+        const Request& request = requests[i];
+
+        // With a rate, latency counts from when the request was due, so a
+        // backlog shows up in the percentiles instead of slowing the arrivals.
+        auto begin = chrono::steady_clock::now();
+        if (options.rate > 0) {
+            begin = start + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(request.due));
+            this_thread::sleep_until(begin);
+        }
+
+        bool ok = true;
+        if (request.op == OP_LIST) {
+            ok = RunOp(request);
+        } else {
+            unique_lock<mutex> fileLock(fileLocks[request.file]);
+            int slot = request.file - options.files;
+            if (request.op == OP_UPLOAD && slotUsed[slot]) {
+                // The slot's file from the previous lap is deleted first, untimed.
+                auto cleanupStart = chrono::steady_clock::now();
+                remove(SavedPath(PoolName(request.file)).c_str());
+                VfsDelete(PoolName(request.file));
+                begin += chrono::steady_clock::now() - cleanupStart;
+            }
+            ok = RunOp(request);
+            if (request.op == OP_UPLOAD) slotUsed[slot] = true;
+        }
+        chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - begin;
+
+        OpStats& op = stats[request.op];
+        lock_guard<mutex> lock(op.lock);
+        op.micros.push_back(elapsed.count());
+        if (!ok) ++op.errors;
+    }
+}
+
+static double Percentile(const vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t rank = (size_t)(p * sorted.size() + 0.999999);
+    return sorted[min(sorted.size() - 1, rank ? rank - 1 : 0)];
+}
+
+static void Report(const string& op, vector<double> micros, int errors, double wallSeconds) {
+    sort(micros.begin(), micros.end());
+    double opsPerSec = wallSeconds > 0 ? micros.size() / wallSeconds : 0;
+    ostringstream params;
+    params << "backend=" << options.backend << " threads=" << options.threads << " rate=" << options.rate
+           << " size=" << options.size;
+
+    if (options.json) {
+        cout << fixed << setprecision(3)
+             << "{\"bench\":\"load\",\"op\":\"" << op << "\",\"params\":\"" << params.str() << "\""
+             << ",\"count\":" << micros.size() << ",\"errors\":" << errors << ",\"seconds\":" << setprecision(6)
+             << wallSeconds << setprecision(3) << ",\"ops_per_sec\":" << opsPerSec
+             << ",\"p50_us\":" << Percentile(micros, 0.50) << ",\"p99_us\":" << Percentile(micros, 0.99) << "}\n";
+        return;
+    }
+    cout << fixed << setprecision(1) << left << setw(8) << op << right << setw(7) << micros.size() << " ops"
+         << setw(5) << errors << " err" << setw(10) << opsPerSec << " ops/s"
+         << "   p50 " << setw(10) << Percentile(micros, 0.50) / 1000 << "ms"
+         << "  p99 " << setw(10) << Percentile(micros, 0.99) / 1000 << "ms\n";
+}
+
+
+// Starts from an empty image and creates the pool files through the inproc
+// path, whatever the backend; the image and saved/ look the same either way.
+static bool Populate() {
+    error_code ec;
+    fs::remove_all("saved", ec);
+    fs::create_directories("saved", ec);
+    if (ec) {
+        cout << "Error: Cannot create " << options.dir << "/saved.\n";
+        return false;
+    }
+    remove(DISK_NAME.c_str());
+    LoadDisk();
+    if (!LoadVolumeKey()) {
+        cout << "Error: volume key unavailable.\n";
+        return false;
+    }
+    for (int i = 0; i < options.files; ++i) {
+        string name = PoolName(i);
+        if (!EncryptAndSave(name) || !VfsCreate(name) || !VfsWrite(name, payload)) {
+            cout << "Error: Cannot set up " << name << ".\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool ParseMix(const string& text) {
+    int mix[OP_COUNT] = {};
+    int total = 0;
+    stringstream ss(text);
+    string item;
+    while (getline(ss, item, ',')) {
+        size_t eq = item.find('=');
+        if (eq == string::npos) return false;
+        string name = item.substr(0, eq);
+        int op = 0;
+        while (op < OP_COUNT && name != LOAD_OP_NAMES[op]) ++op;
+        int weight = atoi(item.c_str() + eq + 1);
+        if (op == OP_COUNT || weight < 0) return false;
+        mix[op] = weight;
+        total += weight;
+    }
+    if (total == 0) return false;
+    copy(mix, mix + OP_COUNT, options.mix);
+    return true;
+}
+
+static void Usage() {
+    cout << "Usage: vfs_load [--json] [--backend exec|inproc] [--threads N] [--rate ops/s] [--requests N]\n"
+         << "                [--files N] [--size bytes] [--mix upload=1,save=3,open=5,list=1]\n"
+         << "                [--password P] [--dir scratch] [--vfs program] [--cryption program] [--seed N]\n";
+}
+
+int main(int argc, char* argv[]) {
+    vector<string> args(argv + 1, argv + argc);
+    bool ok = true;
+    for (size_t i = 0; ok && i < args.size(); ++i) {
+        const string& arg = args[i];
+        if (arg == "--json") {
+            options.json = true;
+            continue;
+        }
+        if (i + 1 == args.size()) {
+            ok = false;
+            break;
+        }
+        const string& value = args[++i];
+        if (arg == "--backend") options.backend = value;
+        else if (arg == "--threads") options.threads = atoi(value.c_str());
+        else if (arg == "--rate") options.rate = atof(value.c_str());
+        else if (arg == "--requests") options.requests = atoi(value.c_str());
+        else if (arg == "--files") options.files = atoi(value.c_str());
+        else if (arg == "--size") options.size = atoi(value.c_str());
+        else if (arg == "--mix") ok = ParseMix(value);
+        else if (arg == "--password") options.password = value;
+        else if (arg == "--dir") options.dir = value;
+        else if (arg == "--vfs") options.vfsProgram = value;
+        else if (arg == "--cryption") options.cryptionProgram = value;
+        else if (arg == "--seed") options.seed = (unsigned)atoi(value.c_str());
+        else ok = false;
+    }
+    // Upload slots take the inodes the pool leaves, up to 16.
+    int uploadSlots = min(16, MAX_FILES - options.files);
+    int blocksPerFile = max(1, (options.size + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    if (!ok || (options.backend != "exec" && options.backend != "inproc") || options.threads < 1 ||
+        options.rate < 0 || options.requests < 1 || options.files < 1 || uploadSlots < 1 || options.size < 1 ||
+        options.password.empty()) {
+        Usage();
+        return 1;
+    }
+    if ((options.files + uploadSlots) * blocksPerFile > MAX_BLOCKS) {
+        cout << "Error: " << options.files + uploadSlots << " files of " << options.size
+             << " bytes do not fit in the volume.\n";
+        return 1;
+    }
+    if (!kdfParamsFromEnv(sessionParams)) {
+        cout << "Error: Invalid CRYPTION_KDF.\n";
+        return 1;
+    }
+
+    // The exec backend runs the programs from the scratch directory.
+    error_code ec;
+    fs::path vfsProgram = fs::absolute(options.vfsProgram, ec);
+    fs::path cryptionProgram = fs::absolute(options.cryptionProgram, ec);
+    options.vfsProgram = vfsProgram.string();
+    options.cryptionProgram = cryptionProgram.string();
+    fs::create_directories(options.dir, ec);
+    fs::current_path(options.dir, ec);
+    if (ec) {
+        cout << "Error: Cannot use " << options.dir << " as the scratch directory.\n";
+        return 1;
+    }
+
+    // Printable text without quotes, so it passes through a command line as is.
+    payload.resize(options.size);
+    for (int i = 0; i < options.size; ++i) payload[i] = i % 64 == 63 ? ' ' : (char)('a' + i % 26);
+    fileLocks = vector<mutex>(options.files + uploadSlots);
+    slotUsed.assign(uploadSlots, 0);
+    if (!Populate()) return 1;
+    execBackend = options.backend == "exec";
+
+    vector<Request> requests = Schedule();
+    atomic<size_t> next(0);
+    vector<thread> workers;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < options.threads; ++i) {
+        workers.emplace_back(Worker, cref(requests), ref(next), start);
+    }
+    for (thread& worker : workers) worker.join();
+    chrono::duration<double> wall = chrono::steady_clock::now() - start;
+
+    vector<double> all;
+    int errors = 0;
+    for (int op = 0; op < OP_COUNT; ++op) {
+        if (stats[op].micros.empty()) continue;
+        Report(LOAD_OP_NAMES[op], stats[op].micros, stats[op].errors, wall.count());
+        all.insert(all.end(), stats[op].micros.begin(), stats[op].micros.end());
+        errors += stats[op].errors;
+    }
+    Report("all", all, errors, wall.count());
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,218 @@
+#include "vfs_readahead.h"
+#include "vfs_disk.h"
+#include "vfs_crypto.h"
+#include "vfs_stats.h"
+#include <openssl/crypto.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+bool readaheadEnabled = true;
+
+namespace {
+
+struct Stream {
+    int nextOffset = -1;      // where a sequential read would start
+    int window = 0;           // bytes the next refill covers, 0 while not sequential
+    int chainIndex = -1;      // block number `chainIndex` of the file is `chainBlock`
+    int chainBlock = BLOCK_END;
+    int bufStart = 0;         // plain text of [bufStart, bufStart + bufLen)
+    int bufLen = 0;
+    vector<char> buf;         // kept at its largest size, so refills do not reallocate
+    bool ready = false;
+    bool pending = false;     // a refill is queued for the background thread
+    unsigned generation = 0;  // bumped by ReadaheadForget, so stale refills are dropped
+};
+
+struct Refill {
+    int idx;
+    int offset;
+    int len;
+    unsigned generation;
+};
+
+vector<Stream> streams(MAX_FILES);
+
+thread worker;
+mutex queueMutex;
+condition_variable queueReady;
+deque<Refill> queue;
+bool stopping = false;
+atomic<bool> running(false);
+
+// The window holds plain text of encrypted files, so it is wiped when dropped.
+void DropWindow(Stream& s) {
+    if (s.bufLen) OPENSSL_cleanse(s.buf.data(), s.buf.size());
+    s.bufLen = 0;
+    s.ready = false;
+}
+
+// Block number `n` of the file, walking on from the remembered position when
+// it is not past `n`.
+int ChainBlock(int idx, int n) {
+    Stream& s = streams[idx];
+    int i = 0;
+    int block = inodeTable[idx].startBlock;
+    if (readaheadEnabled && s.chainIndex >= 0 && s.chainIndex <= n) {
+        i = s.chainIndex;
+        block = s.chainBlock;
+    }
+    while (i < n && block != BLOCK_END) {
+        block = blockMap[block];
+        ++i;
+    }
+    return block;
+}
+
+// Copies and decrypts `len` bytes at `offset` straight from the blocks.
+// Consecutive blocks of the same write generation are decrypted in one go.
+bool CopyOut(int idx, int offset, char* out, int len) {
+    if (len <= 0) return true;
+    int n = offset / BLOCK_SIZE;
+    int block = ChainBlock(idx, n);
+    int done = 0;
+    int runStart = 0;
+    uint64_t runGeneration = 0;
+    while (true) {
+        int pos = (offset + done) % BLOCK_SIZE;
+        int chunk = min(len - done, BLOCK_SIZE - pos);
+        if (block < 0 || badBlocks[block]) return false;
+        if (done > 0 && blockGeneration[block] != runGeneration) {
+            if (!CryptRange(idx, offset + runStart, out + runStart, done - runStart, runGeneration)) return false;
+            runStart = done;
+        }
+        runGeneration = blockGeneration[block];
+        memcpy(out + done, &diskData[(long)block * BLOCK_SIZE] + pos, chunk);
+        done += chunk;
+        if (done == len) break;
+        block = blockMap[block];
+        ++n;
+    }
+    if (readaheadEnabled) {
+        streams[idx].chainIndex = n;
+        streams[idx].chainBlock = block;
+    }
+    return CryptRange(idx, offset + runStart, out + runStart, len - runStart, runGeneration);
+}
+
+void Fill(int idx, int offset, int len) {
+    Stream& s = streams[idx];
+    if ((int)s.buf.size() < len) {
+        DropWindow(s);
+        s.buf.resize(len);
+    }
+    s.bufStart = offset;
+    s.bufLen = len;
+    s.ready = CopyOut(idx, offset, s.buf.data(), len);
+    if (s.ready) StatAdd(STAT_READAHEAD_BYTES, len);
+    else DropWindow(s);
+}
+
+void WorkerLoop() {
+    unique_lock<mutex> lock(queueMutex);
+    while (true) {
+        queueReady.wait(lock, [] { return stopping || !queue.empty(); });
+        if (stopping) return;
+        Refill job = queue.front();
+        queue.pop_front();
+        lock.unlock();
+        {
+            lock_guard<mutex> vfsLock(vfsMutex);
+            Stream& s = streams[job.idx];
+            if (s.generation == job.generation && s.pending) {
+                s.pending = false;
+                Fill(job.idx, job.offset, min(job.len, inodeTable[job.idx].size - job.offset));
+            }
+        }
+        lock.lock();
+    }
+}
+
+void Schedule(int idx) {
+    Stream& s = streams[idx];
+    int len = min(s.window, inodeTable[idx].size - s.nextOffset);
+    if (len <= 0 || s.pending) return;
+    int bufEnd = s.bufStart + s.bufLen;
+    if (s.ready && s.nextOffset >= s.bufStart && bufEnd - s.nextOffset >= s.window / 2) return;
+
+    if (running) {
+        s.pending = true;
+        {
+            lock_guard<mutex> lock(queueMutex);
+            queue.push_back({idx, s.nextOffset, len, s.generation});
+        }
+        queueReady.notify_one();
+    } else {
+        Fill(idx, s.nextOffset, len);
+    }
+    s.window = min(s.window * 2, READAHEAD_MAX);
+}
+
+}
+
+bool ReadaheadRead(int idx, int offset, char* out, int len) {
+    if (!readaheadEnabled) return CopyOut(idx, offset, out, len);
+
+    Stream& s = streams[idx];
+    if (offset == s.nextOffset) {
+        if (s.window == 0) s.window = READAHEAD_MIN;
+    } else {
+        s.window = 0;
+        DropWindow(s);
+    }
+
+    int served = 0;
+    int bufEnd = s.bufStart + s.bufLen;
+    if (s.ready && offset >= s.bufStart && offset < bufEnd) {
+        served = min(len, bufEnd - offset);
+        memcpy(out, &s.buf[offset - s.bufStart], served);
+        StatAdd(STAT_READAHEAD_HITS, served);
+    }
+    if (served < len && !CopyOut(idx, offset + served, out + served, len - served)) return false;
+
+    s.nextOffset = offset + len;
+    if (s.window > 0) Schedule(idx);
+    return true;
+}
+
+void ReadaheadForget(int idx) {
+    Stream& s = streams[idx];
+    DropWindow(s);
+    vector<char> buf;
+    buf.swap(s.buf);
+    unsigned generation = s.generation + 1;
+    s = Stream();
+    s.generation = generation;
+    s.buf.swap(buf);
+}
+
+void ReadaheadReset() {
+    for (int i = 0; i < MAX_FILES; ++i) ReadaheadForget(i);
+}
+
+void StartReadahead() {
+    if (running) return;
+    stopping = false;
+    running = true;
+    worker = thread(WorkerLoop);
+}
+
+void StopReadahead() {
+    if (!running) return;
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+        queue.clear();
+    }
+    queueReady.notify_all();
+    worker.join();
+    running = false;
+    lock_guard<mutex> lock(vfsMutex);
+    for (Stream& s : streams) s.pending = false;
+}
@@ -0,0 +1,38 @@
+#ifndef VFS_READAHEAD_H
+#define VFS_READAHEAD_H
+
+#include "inode.h"
+
+// Read-ahead for files read front to back in pieces (readAt, ReadFileAt).
+// A read that starts where the previous read of the same file ended is
+// sequential; from the second one on, the next window of the file is copied
+// out of its blocks and decrypted ahead of time, and the reads that follow
+// are served from that copy. The window starts at READAHEAD_MIN bytes and
+// doubles each time it is refilled, up to READAHEAD_MAX; any other read
+// drops it. Each file also remembers where in its block chain the last read
+// ended, so a sequential read does not walk the chain from the start.
+//
+// Until StartReadahead() the window is filled by the read that needs it.
+// Afterwards a background thread fills it under vfsMutex, so every caller of
+// the VFS functions has to hold vfsMutex, as the addon does.
+const int READAHEAD_MIN = 4 * BLOCK_SIZE;
+const int READAHEAD_MAX = 128 * BLOCK_SIZE;
+
+// When false, every read walks the chain and decrypts on its own.
+extern bool readaheadEnabled;
+
+// ReadData after its checks: serves what it can from the window and copies
+// the rest out of the blocks.
+bool ReadaheadRead(int idx, int offset, char* out, int len);
+
+// File `idx` was written, truncated or freed.
+void ReadaheadForget(int idx);
+// Blocks moved or the tables were replaced (load, rollback, snapshot mount,
+// compaction, scrub).
+void ReadaheadReset();
+
+void StartReadahead();
+// Must not be called with vfsMutex held.
+void StopReadahead();
+
+#endif
@@ -0,0 +1,145 @@
+#include "vfs_replace.h"
+#include "vfs_utils.h"
+#include "vfs_disk.h"
+#include "vfs_stats.h"
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define VFS_HAVE_SSE2 1
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+// Files are scanned this many bytes at a time, so a search never needs a
+// full copy of the file.
+const int SCAN_WINDOW = 64 * BLOCK_SIZE;
+
+static inline int LowestBit(unsigned int mask) {
+#ifdef _MSC_VER
+    unsigned long bit;
+    _BitScanForward(&bit, mask);
+    return (int)bit;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// Returns the first occurrence of `pattern` in `text`, or nullptr.
+// Candidates are positions where both the first and the last byte of the
+// pattern match; with SSE2 these are found 16 positions per compare, and
+// only candidates get a full memcmp. Without SSE2 the first byte is located
+// with memchr and the last byte checked before the memcmp.
+const char* FindPattern(const char* text, size_t n, const char* pattern, size_t m) {
+    if (m == 0) return text;
+    if (m > n) return nullptr;
+    if (m == 1) return static_cast<const char*>(memchr(text, pattern[0], n));
+
+    size_t lastStart = n - m;
+    size_t i = 0;
+#ifdef VFS_HAVE_SSE2
+    const __m128i first = _mm_set1_epi8(pattern[0]);
+    const __m128i last = _mm_set1_epi8(pattern[m - 1]);
+    for (; i + 15 <= lastStart; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + m - 1));
+        unsigned int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        while (mask) {
+            int bit = LowestBit(mask);
+            if (memcmp(text + i + bit + 1, pattern + 1, m - 2) == 0) return text + i + bit;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    while (i <= lastStart) {
+        const char* hit = static_cast<const char*>(memchr(text + i, pattern[0], lastStart - i + 1));
+        if (!hit) return nullptr;
+        if (hit[m - 1] == pattern[m - 1] && memcmp(hit + 1, pattern + 1, m - 2) == 0) return hit;
+        i = hit - text + 1;
+    }
+    return nullptr;
+}
+
+// Collects the offsets of non-overlapping occurrences of `pattern`, reading
+// and decrypting the file one window at a time. With nth > 0 only the nth
+// occurrence is returned.
+static bool FindMatches(int idx, const string& pattern, int nth, vector<int>& matches) {
+    int size = inodeTable[idx].size;
+    int m = pattern.size();
+    int window = max(SCAN_WINDOW, 2 * m);
+    vector<char> buf(min(window, size));
+    int occurrence = 0;
+
+    int from = 0;
+    while (from <= size - m) {
+        int len = min(window, size - from);
+        if (!ReadData(idx, from, buf.data(), len)) return false;
+
+        int scan = 0;
+        while (const char* hit = FindPattern(buf.data() + scan, len - scan, pattern.data(), m)) {
+            int at = hit - buf.data();
+            ++occurrence;
+            if (nth == 0 || occurrence == nth) matches.push_back(from + at);
+            if (nth != 0 && occurrence == nth) return true;
+            scan = at + m;
+        }
+
+        if (from + len >= size) break;
+        // Keep the last m - 1 bytes so matches spanning two windows are found.
+        from = max(from + len - (m - 1), from + scan);
+    }
+    return true;
+}
+
+// Replaces every occurrence of oldText (nth == 0) or only the nth one.
+// Equal-length replacements are written in place; otherwise only the file
+// from the first match onwards is rewritten. Returns the number of
+// replacements or one of the REPLACE_ results. A write can fail after
+// earlier ones went through, so callers run this in a transaction and roll
+// back on failure.
+int ReplaceInData(int idx, const string& oldText, const string& newText, int nth) {
+    StatTimer timer(STAT_REPLACE);
+    if (oldText.empty() || nth < 0) return REPLACE_INVALID;
+
+    vector<int> matches;
+    if (!FindMatches(idx, oldText, nth, matches)) return REPLACE_UNREADABLE;
+    if (matches.empty()) return 0;
+
+    if (oldText.size() == newText.size()) {
+        for (size_t i = 0; i < matches.size(); ++i) {
+            if (!WriteData(idx, matches[i], newText.data(), newText.size())) return REPLACE_FAILED;
+        }
+        return matches.size();
+    }
+
+    int start = matches[0];
+    int size = inodeTable[idx].size;
+    string tail(size - start, '\0');
+    if (!ReadData(idx, start, &tail[0], tail.size())) return REPLACE_UNREADABLE;
+
+    string updated;
+    updated.reserve(tail.size() + matches.size() * newText.size());
+    size_t copied = 0;
+    for (size_t i = 0; i < matches.size(); ++i) {
+        size_t at = matches[i] - start;
+        updated.append(tail, copied, at - copied);
+        updated += newText;
+        copied = at + oldText.size();
+    }
+    updated.append(tail, copied, string::npos);
+
+    if (!WriteData(idx, start, updated.data(), updated.size()) ||
+        !TruncateData(idx, start + updated.size())) return REPLACE_FAILED;
+    return matches.size();
+}
+
+const char* ReplaceFailureReason(int result) {
+    if (result == REPLACE_UNREADABLE) return "Read failed (checksum mismatch or decryption error)";
+    if (result == REPLACE_INVALID) return "Invalid replacement";
+    return WriteFailureReason();
+}
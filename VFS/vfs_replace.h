@@ -0,0 +1,18 @@
+#ifndef VFS_REPLACE_H
+#define VFS_REPLACE_H
+
+#include <string>
+#include <cstddef>
+
+const char* FindPattern(const char* text, size_t n, const char* pattern, size_t m);
+
+// ReplaceInData results for a replacement that did not happen.
+const int REPLACE_FAILED = -1;       // a write failed, see WriteFailureReason()
+const int REPLACE_UNREADABLE = -2;   // the file failed its checksum or could not be decrypted
+const int REPLACE_INVALID = -3;      // empty oldText or negative nth
+
+int ReplaceInData(int idx, const std::string& oldText, const std::string& newText, int nth);
+// The error message for a result below zero.
+const char* ReplaceFailureReason(int result);
+
+#endif
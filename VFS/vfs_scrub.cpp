@@ -0,0 +1,186 @@
+#include "vfs_scrub.h"
+#include "vfs_disk.h"
+#include "vfs_readahead.h"
+#include "vfs_utils.h"
+#include "vfs_index.h"
+#include "vfs_checksum.h"
+#include "vfs_stripe.h"
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+// Blocks read from the image per request in each scrub thread.
+const int SCRUB_CHUNK = 64;
+
+// Checks blocks [begin, end) of the image against blockCrc and collects the
+// ones that do not match. Each request stays within one stripe unit.
+static void ScrubRange(int begin, int end, vector<int>& bad) {
+    vector<ifstream> files(stripeLayout.count);
+    for (int s = 0; s < stripeLayout.count; ++s) files[s].open(StripePath(s), ios::binary);
+    vector<char> buf((size_t)BLOCK_SIZE * SCRUB_CHUNK);
+    for (int b = begin, count; b < end; b += count) {
+        int stripe = BlockStripe(b);
+        count = 1;
+        while (count < SCRUB_CHUNK && b + count < end && BlockStripe(b + count) == stripe &&
+               StripeOffset(b + count) == StripeOffset(b) + (long)BLOCK_SIZE * count) {
+            ++count;
+        }
+        ifstream& fin = files[stripe];
+        fin.seekg((stripe == 0 ? DataOffset() : 0) + StripeOffset(b));
+        fin.read(buf.data(), (long)BLOCK_SIZE * count);
+        // A short read leaves zeros, which then fail the check.
+        fill(buf.begin() + max<streamsize>(fin.gcount(), 0), buf.end(), 0);
+        fin.clear();
+        for (int i = 0; i < count; ++i) {
+            if (BlockInUse(b + i) && Crc32c(&buf[(size_t)BLOCK_SIZE * i], BLOCK_SIZE) != blockCrc[b + i]) {
+                bad.push_back(b + i);
+            }
+        }
+    }
+}
+
+// Moves a block of a live file whose image copy is damaged, but whose
+// in-memory copy is intact, to a free block and retires its slot. Returns
+// false if there is no free block.
+static bool QuarantineBlock(int idx, int prev, int block) {
+    int fresh = FindFreeBlock();
+    if (fresh == -1) return false;
+    MarkBlockDirty(fresh);
+    memcpy(&diskData[(long)BLOCK_SIZE * fresh], &diskData[(long)BLOCK_SIZE * block], BLOCK_SIZE);
+    blockCrc[fresh] = blockCrc[block];
+    blockGeneration[fresh] = blockGeneration[block];
+    blockMap[fresh] = blockMap[block];
+    if (prev == BLOCK_END) inodeTable[idx].startBlock = fresh;
+    else blockMap[prev] = fresh;
+    blockMap[block] = BLOCK_BAD;
+    badBlocks[block] = false;
+    IndexBlock(fresh);
+    IndexBlock(block);
+    ReadaheadForget(idx);
+    return true;
+}
+
+bool ScrubVolume(bool quarantine, ScrubResult& result) {
+    result = ScrubResult();
+    if (mountedSnapshot != -1) return false;
+    SaveDisk();
+
+    auto start = chrono::steady_clock::now();
+    vector<Inode> diskInodes;
+    vector<uint32_t> diskInodeCrc;
+    if (!ReadImageInodes(diskInodes, diskInodeCrc)) return false;
+    bool rewrite = false;
+    for (int i = 0; i < MAX_FILES; ++i) {
+        ++result.inodesChecked;
+        if (Crc32c(&diskInodes[i], sizeof(Inode)) == diskInodeCrc[i]) continue;
+        ScrubProblem p;
+        p.inode = i;
+        p.owner = inodeTable[i].used ? inodeTable[i].fileName : "(unused inode)";
+        p.repairable = !badInodes[i];
+        p.fixed = quarantine && p.repairable;
+        rewrite = rewrite || p.fixed;
+        result.problems.push_back(p);
+    }
+
+    // Blocks: split the used part of the image evenly over the threads.
+    int extent = UsedBlockExtent();
+    int threads = (int)max(1u, thread::hardware_concurrency());
+    threads = max(1, min(threads, (extent + SCRUB_CHUNK - 1) / SCRUB_CHUNK));
+    vector<vector<int>> bad(threads);
+    vector<thread> workers;
+    int per = (extent + threads - 1) / threads;
+    for (int t = 0; t < threads; ++t) {
+        int begin = min(extent, t * per), end = min(extent, begin + per);
+        workers.emplace_back(ScrubRange, begin, end, ref(bad[t]));
+    }
+    for (thread& w : workers) w.join();
+    for (int b = 0; b < extent; ++b) result.blocksChecked += BlockInUse(b);
+    result.bytes = (long)BLOCK_SIZE * result.blocksChecked + sizeof(Inode) * MAX_FILES;
+    result.threads = threads;
+
+    // Name the owner of each damaged block and, if asked, quarantine it.
+    for (const vector<int>& list : bad) {
+        for (int block : list) {
+            ScrubProblem p;
+            p.block = block;
+            p.repairable = !badBlocks[block] &&
+                Crc32c(&diskData[(long)BLOCK_SIZE * block], BLOCK_SIZE) == blockCrc[block];
+            int prev = BLOCK_END;
+            bool attrBlock = false;
+            for (int i = 0; i < MAX_FILES && p.inode == -1; ++i) {
+                if (!inodeTable[i].used) continue;
+                prev = BLOCK_END;
+                int n = 0;
+                for (int b = inodeTable[i].startBlock; b != BLOCK_END; prev = b, b = blockMap[b], ++n) {
+                    if (b != block) continue;
+                    p.inode = i;
+                    p.owner = inodeTable[i].fileName;
+                    p.offset = n * BLOCK_SIZE;
+                    break;
+                }
+                for (int b = inodeTable[i].xattrBlock; p.inode == -1 && b != BLOCK_END; b = blockMap[b]) {
+                    if (b != block) continue;
+                    p.inode = i;
+                    p.owner = string(inodeTable[i].fileName) + " (attributes)";
+                    attrBlock = true;
+                }
+            }
+            if (p.inode == -1) {
+                for (const Snapshot& snap : snapshots) {
+                    if (snap.used && InChain(snap.blockMap[block])) {
+                        p.owner = string("snapshot ") + snap.name;
+                        break;
+                    }
+                }
+            }
+            // Unrecoverable blocks stay where they are and keep failing reads
+            // until the file is rewritten or deleted.
+            if (quarantine && p.repairable) {
+                if (p.inode != -1 && blockPins[block] == 0 && !attrBlock) {
+                    p.fixed = QuarantineBlock(p.inode, prev, block);
+                } else {
+                    // Shared with a snapshot (or an attribute block, which is
+                    // not part of the data chain): rewrite it in place.
+                    MarkBlockDirty(block);
+                    p.fixed = true;
+                }
+            }
+            result.problems.push_back(p);
+        }
+    }
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    if (rewrite) RewriteImage();
+    if (quarantine) SaveDisk();
+    return true;
+}
+
+void RunScrub(bool quarantine) {
+    ScrubResult result;
+    if (!ScrubVolume(quarantine, result)) {
+        cout << "Error: Cannot read the disk image.\n";
+        return;
+    }
+    double mbps = result.seconds > 0 ? result.bytes / result.seconds / 1e6 : 0;
+    cout << "Scrubbed " << result.inodesChecked << " inodes and " << result.blocksChecked << " blocks ("
+         << result.bytes << " bytes) in " << result.seconds * 1000 << " ms with " << result.threads
+         << " thread" << (result.threads == 1 ? "" : "s") << ", crc32c " << Crc32cImplementation()
+         << ", " << mbps << " MB/s.\n";
+    for (const ScrubProblem& p : result.problems) {
+        if (p.block == -1) cout << "Bad inode " << p.inode << " (" << p.owner << ")";
+        else if (p.inode != -1) cout << "Bad block " << p.block << ": " << p.owner << " bytes " << p.offset
+                                     << "-" << p.offset + BLOCK_SIZE - 1;
+        else cout << "Bad block " << p.block << ": " << (p.owner.empty() ? "(unowned)" : p.owner);
+        cout << (p.repairable ? " - intact in memory" : " - unrecoverable, rewrite or delete the file");
+        if (p.fixed) cout << (p.block != -1 && blockMap[p.block] == BLOCK_BAD ? ", quarantined" : ", rewritten");
+        cout << "\n";
+    }
+    if (result.problems.empty()) cout << "No problems found.\n";
+    else if (!quarantine) cout << result.problems.size() << " problem(s); scrub --quarantine repairs the ones intact in memory.\n";
+}
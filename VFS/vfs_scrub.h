@@ -0,0 +1,34 @@
+#ifndef VFS_SCRUB_H
+#define VFS_SCRUB_H
+
+#include <string>
+#include <vector>
+
+// One inode or block whose bytes in the image do not match their checksum.
+struct ScrubProblem {
+    int inode = -1;        // inode index, or the file owning the block
+    int block = -1;        // -1 for an inode problem
+    std::string owner;     // file name, or "snapshot <name>" for snapshot-only blocks
+    int offset = 0;        // byte offset of the block within the file
+    bool repairable = false;  // the in-memory copy still matches the checksum
+    bool fixed = false;       // rewritten or moved by quarantine
+};
+
+struct ScrubResult {
+    int inodesChecked = 0;
+    int blocksChecked = 0;
+    long bytes = 0;
+    double seconds = 0;
+    int threads = 0;
+    std::vector<ScrubProblem> problems;
+};
+
+// Saves, then re-reads the image file and checks every inode and in-use block
+// against its CRC32C, spreading the blocks over all cores. With `quarantine`,
+// damaged entries whose in-memory copy is still good are repaired: blocks of
+// live files move to fresh blocks and their old slots are retired, anything
+// else is rewritten in place.
+bool ScrubVolume(bool quarantine, ScrubResult& result);
+void RunScrub(bool quarantine);
+
+#endif
@@ -1,48 +1,190 @@
 #include "vfs_shell.h"
 #include "vfs_fileops.h"
 #include "vfs_disk.h"
+#include "vfs_batch.h"
+#include "vfs_stats.h"
+#include "vfs_snapshot.h"
+#include "vfs_compact.h"
+#include "vfs_scrub.h"
+#include "vfs_transfer.h"
+#include "vfs_xattr.h"
+#include "vfs_stripe.h"
 #include <iostream>
 #include <sstream>
 #include <vector>
+#include <set>
+#include <stdexcept>
+#include <fstream>
+#include <cstdlib>
 
 using namespace std;
 
-void Shell() {
-    string cmd;
-    cout << "Virtual File System Shell. Type 'help' for commands.\n";
-    while (true) {
-        cout << "vfs> ";
-        getline(cin, cmd);
-        stringstream ss(cmd);
-        string token;
-        vector<string> args;
-        while (ss >> token) args.push_back(token);
-        if (args.empty()) continue;
+// Text of the command from argument `first` onwards. Shell lines keep their
+// original spacing; command-line arguments are joined with single spaces.
+static string Tail(const vector<string>& args, const string& line, size_t first) {
+    if (line.empty()) {
+        string text;
+        for (size_t i = first; i < args.size(); ++i) {
+            if (i > first) text += " ";
+            text += args[i];
+        }
+        return text;
+    }
+    size_t pos = 0;
+    for (size_t i = 0; i < first; ++i) {
+        pos = line.find_first_not_of(" \t", pos);
+        pos = line.find_first_of(" \t", pos);
+    }
+    pos = line.find_first_not_of(" \t", pos);
+    return pos == string::npos ? "" : line.substr(pos);
+}
+
+// With VFS_TRACE set, every command is appended to that file in batch syntax
+// so a real workload (e.g. LockFS) can later be replayed with vfs_bench.
+static void RecordTrace(const vector<string>& args) {
+    const char* path = getenv("VFS_TRACE");
+    if (!path || !*path) return;
+    ofstream out(path, ios::app);
+    for (size_t i = 0; i < args.size(); ++i) out << (i ? " " : "") << QuoteBatchWord(args[i]);
+    out << "\n";
+}
 
+// Runs one command, given either as a shell line (`line`) or as command-line
+// arguments (`line` empty). Returns false if the command was not recognised
+// or could not be run.
+bool RunCommand(const vector<string>& args, const string& line) {
+    static const set<string> writes = {"create", "write", "update", "writeat", "append", "truncate", "delete", "seek", "batch", "snapshot", "defrag", "scrub", "import", "setattr", "rmattr"};
+    bool snapshotView = args[0] == "snapshot" && args.size() >= 2 && (args[1] == "list" || args[1] == "unmount");
+    if (mountedSnapshot != -1 && writes.count(args[0]) && !snapshotView) {
+        cout << "Error: Snapshot is read-only.\n";
+        return false;
+    }
+    // Only file operations are traced; replay has no use for maintenance commands.
+    static const set<string> untraced = {"batch", "stats", "snapshot", "defrag", "scrub", "import", "export", "stripe"};
+    if (!untraced.count(args[0])) RecordTrace(args);
+    try {
         if (args[0] == "create" && args.size() == 2) CreateFile(args[1]);
-        else if (args[0] == "write" && args.size() >= 3) {
-            string content = cmd.substr(cmd.find(args[2]));
-            WriteFile(args[1], content);
-        }
+        else if (args[0] == "write" && args.size() >= 3) WriteFile(args[1], Tail(args, line, 2));
         else if (args[0] == "update" && args.size() == 2) UpdateFile(args[1]);
+        else if (args[0] == "update" && (args.size() == 4 || args.size() == 5)) {
+            // Optional fifth argument: "all", or which occurrence to replace (default 1)
+            int nth = args.size() == 4 ? 1 : (args[4] == "all" ? 0 : stoi(args[4]));
+            UpdateFile(args[1], args[2], args[3], nth);
+        }
         else if (args[0] == "read" && args.size() == 2) ReadFile(args[1]);
+        else if (args[0] == "readat" && args.size() == 4) ReadFileAt(args[1], stoi(args[2]), stoi(args[3]));
+        else if (args[0] == "writeat" && args.size() >= 4) WriteFileAt(args[1], stoi(args[2]), Tail(args, line, 3));
+        else if (args[0] == "append" && args.size() >= 3) AppendFile(args[1], Tail(args, line, 2));
+        else if (args[0] == "truncate" && args.size() == 3) TruncateFile(args[1], stoi(args[2]));
         else if (args[0] == "delete" && args.size() == 2) DeleteFile(args[1]);
         else if (args[0] == "seek" && args.size() == 3) SeekFile(args[1], stoi(args[2]));
-        else if (args[0] == "ls") ListFiles();
-        else if (args[0] == "exit") break;
+        else if (args[0] == "ls") ListFiles(vector<string>(args.begin() + 1, args.end()));
+        else if (args[0] == "setattr" && args.size() >= 5) SetAttribute(args[1], args[2], args[3], Tail(args, line, 4));
+        else if (args[0] == "getattr" && (args.size() == 2 || args.size() == 3)) ShowAttributes(args[1], args.size() == 3 ? args[2] : "");
+        else if (args[0] == "rmattr" && args.size() == 3) RemoveAttribute(args[1], args[2]);
+        else if (args[0] == "stats" && args.size() == 1) PrintStats(cout, false);
+        else if (args[0] == "stats" && args.size() == 2 && args[1] == "json") PrintStats(cout, true);
+        else if (args[0] == "stats" && args.size() == 2 && args[1] == "reset") ResetStats();
+        else if (args[0] == "snapshot" && args.size() == 3 && args[1] == "create") TakeSnapshot(args[2]);
+        else if (args[0] == "snapshot" && args.size() == 3 && args[1] == "delete") RemoveSnapshot(args[2]);
+        else if (args[0] == "snapshot" && args.size() == 2 && args[1] == "list") ListSnapshots();
+        else if (args[0] == "snapshot" && args.size() == 3 && args[1] == "mount") {
+            if (!MountSnapshot(args[2])) {
+                cout << "Error: Snapshot not found.\n";
+                return false;
+            }
+            cout << "Snapshot " << args[2] << " mounted read-only.\n";
+        }
+        else if (args[0] == "snapshot" && args.size() == 2 && args[1] == "unmount") {
+            UnmountSnapshot();
+            cout << "Back on the live volume.\n";
+        }
+        else if (args[0] == "defrag" && args.size() == 2 && args[1] == "stats") PrintFragStats(cout, GetFragStats());
+        else if (args[0] == "defrag" && args.size() <= 2) {
+            // Optional slice length in milliseconds (default 2)
+            double sliceMs = args.size() == 2 ? stod(args[1]) : 2;
+            if (sliceMs <= 0) {
+                cout << "Error: Invalid slice length.\n";
+                return false;
+            }
+            DefragVolume((long)(sliceMs * 1000));
+        }
+        else if (args[0] == "scrub" && args.size() == 1) RunScrub(false);
+        else if (args[0] == "scrub" && args.size() == 2 && args[1] == "--quarantine") RunScrub(true);
+        else if (args[0] == "stripe" && args.size() == 1) PrintStripes(cout);
+        else if (args[0] == "stripe" && args.size() == 2 && args[1] == "off") {
+            if (!SetStripes(1, {})) return false;
+            cout << "All blocks are back in the image.\n";
+        }
+        else if (args[0] == "stripe" && args.size() >= 3) {
+            // Unit in blocks, then the stripe files after the image
+            if (!SetStripes(stoi(args[1]), vector<string>(args.begin() + 2, args.end()))) return false;
+            PrintStripes(cout);
+        }
+        else if (args[0] == "import" && args.size() >= 2) RunImport(Tail(args, line, 1));
+        else if (args[0] == "export" && args.size() >= 2) RunExport(Tail(args, line, 1));
+        else if (args[0] == "batch" && args.size() <= 2) {
+            // Operations from a file, or from standard input when none is given
+            if (args.size() == 1) return RunBatchScript(cin);
+            ifstream in(args[1]);
+            if (!in) {
+                cout << "Error: Cannot open batch file.\n";
+                return false;
+            }
+            return RunBatchScript(in);
+        }
         else if (args[0] == "help") {
             cout << "Commands:\n"
                  << "  create <filename>\n"
                  << "  write <filename> <content>\n"
                  << "  update <filename>\n"
+                 << "  update <filename> <old_text> <new_text> [all|n]\n"
                  << "  read <filename>\n"
+                 << "  readat <filename> <offset> <length>\n"
+                 << "  writeat <filename> <offset> <content>\n"
+                 << "  append <filename> <content>\n"
+                 << "  truncate <filename> <size>\n"
                  << "  delete <filename>\n"
                  << "  seek <filename> <position>\n"
-                 << "  ls\n"
+                 << "  ls [attribute ...]   (also shows the named attributes of each file)\n"
+                 << "  setattr <filename> <name> string|int|bool <value>\n"
+                 << "  getattr <filename> [name]\n"
+                 << "  rmattr <filename> <name>\n"
+                 << "  batch [file]   (one operation per line, applied atomically)\n"
+                 << "  stats [json|reset]   (counters of this shell session only)\n"
+                 << "  snapshot create|delete|mount <name>\n"
+                 << "  snapshot list|unmount\n"
+                 << "  defrag [slice_ms] | defrag stats\n"
+                 << "  scrub [--quarantine]\n"
+                 << "  stripe [<unit_blocks> <file> ... | off]   (spreads the blocks over more image files)\n"
+                 << "  import <host_dir>   (copies a host directory tree into the volume)\n"
+                 << "  export <host_dir>   (writes every file of the volume below host_dir)\n"
                  << "  exit\n";
         }
         else {
             cout << "Unknown command.\n";
+            return false;
         }
+    } catch (const logic_error&) {
+        cout << "Error: Invalid number.\n";
+        return false;
+    }
+    return true;
+}
+
+void Shell() {
+    string cmd;
+    cout << "Virtual File System Shell. Type 'help' for commands.\n";
+    while (true) {
+        cout << "vfs> ";
+        if (!getline(cin, cmd)) break;
+        stringstream ss(cmd);
+        string token;
+        vector<string> args;
+        while (ss >> token) args.push_back(token);
+        if (args.empty()) continue;
+
+        if (args[0] == "exit") break;
+        RunCommand(args, cmd);
     }
 }
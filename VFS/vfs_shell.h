@@ -1,6 +1,10 @@
 #ifndef VFS_SHELL_H
 #define VFS_SHELL_H
 
+#include <string>
+#include <vector>
+
+bool RunCommand(const std::vector<std::string>& args, const std::string& line);
 void Shell();
 
 #endif
@@ -0,0 +1,124 @@
+#include "vfs_snapshot.h"
+#include "vfs_disk.h"
+#include "vfs_readahead.h"
+#include "vfs_index.h"
+#include <iostream>
+#include <cstring>
+#include <ctime>
+
+using namespace std;
+
+// The live tables while a snapshot is mounted.
+static vector<Inode> liveInodes;
+static vector<int> liveBlockMap;
+
+int FindSnapshot(const string& name) {
+    for (int i = 0; i < MAX_SNAPSHOTS; ++i) {
+        if (snapshots[i].used && name == snapshots[i].name) return i;
+    }
+    return -1;
+}
+
+// Records the current inode table and block map in a free slot and pins
+// every block in use, so later writes copy those blocks instead of changing
+// them. Returns the slot, or -1 when all slots are taken.
+int CreateSnapshot(const string& name) {
+    if (mountedSnapshot != -1) return -1;
+    int slot = -1;
+    for (int i = 0; i < MAX_SNAPSHOTS && slot == -1; ++i) {
+        if (!snapshots[i].used) slot = i;
+    }
+    if (slot == -1) return -1;
+
+    Snapshot& snap = snapshots[slot];
+    strncpy(snap.name, name.c_str(), sizeof(snap.name) - 1);
+    snap.name[sizeof(snap.name) - 1] = '\0';
+    snap.used = true;
+    snap.created = (long long)time(nullptr);
+    memcpy(snap.inodes, inodeTable.data(), sizeof(snap.inodes));
+    memcpy(snap.blockMap, blockMap.data(), sizeof(snap.blockMap));
+    for (int b = 0; b < MAX_BLOCKS; ++b) {
+        if (InChain(snap.blockMap[b])) ++blockPins[b];
+    }
+    MarkSnapshotDirty(slot);
+    return slot;
+}
+
+// Drops the slot and clears blocks that no longer belong to anything.
+bool DeleteSnapshot(const string& name) {
+    int slot = FindSnapshot(name);
+    if (slot == -1 || mountedSnapshot != -1) return false;
+
+    Snapshot& snap = snapshots[slot];
+    for (int b = 0; b < MAX_BLOCKS; ++b) {
+        if (!InChain(snap.blockMap[b])) continue;
+        if (--blockPins[b] == 0 && blockMap[b] == BLOCK_FREE) {
+            MarkBlockDirty(b);
+            memset(&diskData[(long)BLOCK_SIZE * b], 0, BLOCK_SIZE);
+            IndexBlock(b);
+        }
+    }
+    memset(&snap, 0, sizeof(Snapshot));
+    MarkSnapshotDirty(slot);
+    return true;
+}
+
+bool MountSnapshot(const string& name) {
+    int slot = FindSnapshot(name);
+    if (slot == -1 || mountedSnapshot != -1) return false;
+    liveInodes.swap(inodeTable);
+    liveBlockMap.swap(blockMap);
+    inodeTable.assign(snapshots[slot].inodes, snapshots[slot].inodes + MAX_FILES);
+    blockMap.assign(snapshots[slot].blockMap, snapshots[slot].blockMap + MAX_BLOCKS);
+    mountedSnapshot = slot;
+    RebuildIndex();
+    ReadaheadReset();
+    return true;
+}
+
+void UnmountSnapshot() {
+    if (mountedSnapshot == -1) return;
+    inodeTable.swap(liveInodes);
+    blockMap.swap(liveBlockMap);
+    mountedSnapshot = -1;
+    RebuildIndex();
+    ReadaheadReset();
+}
+
+void TakeSnapshot(const string& name) {
+    if (name.empty() || name.size() >= sizeof(Snapshot::name)) {
+        cout << "Error: Invalid snapshot name.\n";
+        return;
+    }
+    if (FindSnapshot(name) != -1) {
+        cout << "Error: Snapshot already exists.\n";
+        return;
+    }
+    if (CreateSnapshot(name) == -1) {
+        cout << "Error: All " << MAX_SNAPSHOTS << " snapshot slots are in use.\n";
+        return;
+    }
+    SaveDisk();
+    cout << "Snapshot created.\n";
+}
+
+void RemoveSnapshot(const string& name) {
+    if (!DeleteSnapshot(name)) {
+        cout << "Error: Snapshot not found.\n";
+        return;
+    }
+    SaveDisk();
+    cout << "Snapshot deleted.\n";
+}
+
+void ListSnapshots() {
+    for (const Snapshot& snap : snapshots) {
+        if (!snap.used) continue;
+        int files = 0;
+        for (const Inode& node : snap.inodes) files += node.used;
+        time_t created = (time_t)snap.created;
+        char when[32];
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime(&created));
+        cout << snap.name << " (files: " << files << ", created: " << when << ")\n";
+    }
+}
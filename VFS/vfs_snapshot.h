@@ -0,0 +1,19 @@
+#ifndef VFS_SNAPSHOT_H
+#define VFS_SNAPSHOT_H
+
+#include <string>
+
+int FindSnapshot(const std::string& name);
+int CreateSnapshot(const std::string& name);
+bool DeleteSnapshot(const std::string& name);
+
+// Swaps a snapshot's tables in for the live ones. While mounted, reads see
+// the snapshot and SaveDisk does nothing; callers must refuse writes.
+bool MountSnapshot(const std::string& name);
+void UnmountSnapshot();
+
+void TakeSnapshot(const std::string& name);
+void RemoveSnapshot(const std::string& name);
+void ListSnapshots();
+
+#endif
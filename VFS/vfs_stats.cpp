@@ -0,0 +1,151 @@
+#include "vfs_stats.h"
+#include <iomanip>
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+const char* const STAT_OP_NAMES[STAT_OP_COUNT] = {
+    "lookup", "allocate", "copyIn", "copyOut", "replace", "persist", "load"
+};
+const char* const STAT_COUNTER_NAMES[STAT_COUNTER_COUNT] = {
+    "bytesIn", "bytesOut", "persistBytes", "fullSaves", "keyCacheHits", "keyCacheMisses",
+    "readaheadBytes", "readaheadHits"
+};
+
+// All statistics are relaxed atomics: no locks, and concurrent callers
+// only contend on the cache lines of the counters they touch.
+static atomic<uint64_t> callCounts[STAT_OP_COUNT];
+static atomic<uint64_t> sampleTotals[STAT_OP_COUNT];
+static atomic<uint64_t> sampleMax[STAT_OP_COUNT];
+static atomic<uint64_t> buckets[STAT_OP_COUNT][STAT_HIST_BUCKETS];
+static atomic<uint64_t> counters[STAT_COUNTER_COUNT];
+
+static inline int HighestBit(uint64_t v) {
+#ifdef _MSC_VER
+    unsigned long bit;
+    _BitScanReverse64(&bit, v);
+    return (int)bit;
+#else
+    return 63 - __builtin_clzll(v);
+#endif
+}
+
+// Values below 16 get their own bucket; above that, each power of two is
+// split into 8 linear sub-buckets.
+static int BucketOf(uint64_t ns) {
+    if (ns < 16) return (int)ns;
+    int msb = HighestBit(ns);
+    int sub = (int)((ns >> (msb - 3)) & 7);
+    return 16 + (msb - 4) * 8 + sub;
+}
+
+static uint64_t BucketValue(int bucket) {
+    if (bucket < 16) return bucket;
+    int msb = (bucket - 16) / 8 + 4;
+    uint64_t sub = (bucket - 16) % 8;
+    uint64_t low = (8 + sub) << (msb - 3);
+    return low + ((uint64_t)1 << (msb - 3)) / 2;  // middle of the bucket
+}
+
+static uint64_t NowNs() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Counts the call and returns a start time if this call is to be timed, else 0.
+uint64_t StatBegin(StatOp op) {
+    uint64_t n = callCounts[op].fetch_add(1, memory_order_relaxed);
+    return n % STAT_SAMPLE_EVERY == 0 ? NowNs() : 0;
+}
+
+void StatRecord(StatOp op, uint64_t startNs) {
+    uint64_t ns = NowNs() - startNs;
+    buckets[op][BucketOf(ns)].fetch_add(1, memory_order_relaxed);
+    sampleTotals[op].fetch_add(ns, memory_order_relaxed);
+    uint64_t prev = sampleMax[op].load(memory_order_relaxed);
+    while (ns > prev && !sampleMax[op].compare_exchange_weak(prev, ns, memory_order_relaxed)) {}
+}
+
+void StatAdd(StatCounter counter, uint64_t amount) {
+    counters[counter].fetch_add(amount, memory_order_relaxed);
+}
+
+uint64_t GetStatCounter(StatCounter counter) {
+    return counters[counter].load(memory_order_relaxed);
+}
+
+StatSummary GetStatSummary(StatOp op) {
+    StatSummary s = {};
+    s.count = callCounts[op].load(memory_order_relaxed);
+    s.totalNs = sampleTotals[op].load(memory_order_relaxed);
+    s.maxNs = sampleMax[op].load(memory_order_relaxed);
+
+    uint64_t snapshot[STAT_HIST_BUCKETS];
+    for (int b = 0; b < STAT_HIST_BUCKETS; ++b) {
+        snapshot[b] = buckets[op][b].load(memory_order_relaxed);
+        s.sampled += snapshot[b];
+    }
+    const double quantiles[] = {0.50, 0.90, 0.99, 0.999};
+    uint64_t* results[] = {&s.p50Ns, &s.p90Ns, &s.p99Ns, &s.p999Ns};
+    for (int q = 0; q < 4; ++q) {
+        uint64_t target = (uint64_t)(quantiles[q] * s.sampled + 0.999999);
+        uint64_t seen = 0;
+        for (int b = 0; b < STAT_HIST_BUCKETS && s.sampled; ++b) {
+            seen += snapshot[b];
+            if (seen >= target && seen) {
+                *results[q] = min(BucketValue(b), s.maxNs);
+                break;
+            }
+        }
+    }
+    return s;
+}
+
+void ResetStats() {
+    for (int op = 0; op < STAT_OP_COUNT; ++op) {
+        callCounts[op] = 0;
+        sampleTotals[op] = 0;
+        sampleMax[op] = 0;
+        for (int b = 0; b < STAT_HIST_BUCKETS; ++b) buckets[op][b] = 0;
+    }
+    for (int c = 0; c < STAT_COUNTER_COUNT; ++c) counters[c] = 0;
+}
+
+void PrintStats(ostream& out, bool json) {
+    if (json) {
+        out << "{\"ops\":{";
+        for (int op = 0; op < STAT_OP_COUNT; ++op) {
+            StatSummary s = GetStatSummary((StatOp)op);
+            out << (op ? "," : "") << "\"" << STAT_OP_NAMES[op] << "\":{\"count\":" << s.count
+                << ",\"sampled\":" << s.sampled << ",\"totalNs\":" << s.totalNs
+                << ",\"p50Ns\":" << s.p50Ns << ",\"p90Ns\":" << s.p90Ns << ",\"p99Ns\":" << s.p99Ns
+                << ",\"p999Ns\":" << s.p999Ns << ",\"maxNs\":" << s.maxNs << "}";
+        }
+        out << "}";
+        for (int c = 0; c < STAT_COUNTER_COUNT; ++c) {
+            out << ",\"" << STAT_COUNTER_NAMES[c] << "\":" << GetStatCounter((StatCounter)c);
+        }
+        out << "}\n";
+        return;
+    }
+
+    ios::fmtflags flags = out.flags();
+    streamsize precision = out.precision();
+    out << left << setw(10) << "stage" << right << setw(10) << "calls" << setw(10) << "p50 us"
+        << setw(10) << "p90 us" << setw(10) << "p99 us" << setw(10) << "p999 us" << setw(10) << "max us" << "\n";
+    out << fixed << setprecision(2);
+    for (int op = 0; op < STAT_OP_COUNT; ++op) {
+        StatSummary s = GetStatSummary((StatOp)op);
+        out << left << setw(10) << STAT_OP_NAMES[op] << right << setw(10) << s.count
+            << setw(10) << s.p50Ns / 1000.0 << setw(10) << s.p90Ns / 1000.0 << setw(10) << s.p99Ns / 1000.0
+            << setw(10) << s.p999Ns / 1000.0 << setw(10) << s.maxNs / 1000.0 << "\n";
+    }
+    for (int c = 0; c < STAT_COUNTER_COUNT; ++c) {
+        out << left << setw(16) << STAT_COUNTER_NAMES[c] << right << GetStatCounter((StatCounter)c) << "\n";
+    }
+    out << "(latencies sampled on 1 in " << STAT_SAMPLE_EVERY << " calls)\n";
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,70 @@
+#ifndef VFS_STATS_H
+#define VFS_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// Internal VFS stages that get a call counter and a latency histogram.
+// Everything here is per process and in memory only: the numbers cover the
+// interactive shell or a process holding the addon, never several vfs runs.
+enum StatOp {
+    STAT_LOOKUP,    // FindFile
+    STAT_ALLOCATE,  // inode and block allocation
+    STAT_COPY_IN,   // WriteData: copy + encrypt into blocks
+    STAT_COPY_OUT,  // ReadData: copy + decrypt out of blocks
+    STAT_REPLACE,   // ReplaceInData
+    STAT_PERSIST,   // SaveDisk
+    STAT_LOAD,      // LoadDisk
+    STAT_OP_COUNT
+};
+
+// Plain event counters.
+enum StatCounter {
+    STAT_BYTES_IN,
+    STAT_BYTES_OUT,
+    STAT_PERSIST_BYTES,
+    STAT_FULL_SAVES,
+    STAT_KEY_CACHE_HITS,
+    STAT_KEY_CACHE_MISSES,
+    STAT_READAHEAD_BYTES,   // bytes copied out and decrypted ahead of the reader
+    STAT_READAHEAD_HITS,    // bytes of reads served from those
+    STAT_COUNTER_COUNT
+};
+
+// Latencies go into log-linear buckets (8 per power of two, so about 12%
+// resolution) like an HDR histogram. Every call is counted; only one call in
+// STAT_SAMPLE_EVERY is timed, which keeps the clock reads off most calls.
+const int STAT_HIST_BUCKETS = 16 + 60 * 8;
+const uint64_t STAT_SAMPLE_EVERY = 8;
+
+struct StatSummary {
+    uint64_t count;
+    uint64_t sampled;
+    uint64_t totalNs;   // of the sampled calls
+    uint64_t p50Ns, p90Ns, p99Ns, p999Ns, maxNs;
+};
+
+extern const char* const STAT_OP_NAMES[STAT_OP_COUNT];
+extern const char* const STAT_COUNTER_NAMES[STAT_COUNTER_COUNT];
+
+uint64_t StatBegin(StatOp op);
+void StatRecord(StatOp op, uint64_t startNs);
+void StatAdd(StatCounter counter, uint64_t amount);
+StatSummary GetStatSummary(StatOp op);
+uint64_t GetStatCounter(StatCounter counter);
+void ResetStats();
+void PrintStats(std::ostream& out, bool json);
+
+// Times the enclosing scope, e.g. `StatTimer timer(STAT_LOOKUP);`.
+class StatTimer {
+public:
+    explicit StatTimer(StatOp op) : op(op), start(StatBegin(op)) {}
+    ~StatTimer() { if (start) StatRecord(op, start); }
+private:
+    StatOp op;
+    uint64_t start;
+};
+
+#endif
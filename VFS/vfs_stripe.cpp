@@ -0,0 +1,276 @@
+#include "vfs_stripe.h"
+#include "vfs_disk.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <thread>
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+StripeLayout stripeLayout = {1, 1, {}};
+
+namespace {
+
+// Without striping the whole data area is a single run.
+int Unit() {
+    return stripeLayout.count == 1 ? MAX_BLOCKS : stripeLayout.unit;
+}
+
+// Runs `work` for every stripe; stripes other than the image get a thread
+// each, the image is handled by the caller's thread.
+void ForEachStripe(const function<void(int)>& work) {
+    vector<thread> threads;
+    for (int s = 1; s < stripeLayout.count; ++s) threads.emplace_back(work, s);
+    work(0);
+    for (thread& t : threads) t.join();
+}
+
+// Runs of blocks in [from, to) that hold data, and of free blocks, which
+// read as zeros and are left as holes in the files.
+void ForEachRun(int from, int to, const function<bool(int)>& include,
+                const function<void(int, int, bool)>& run) {
+    for (int b = from; b < to; ) {
+        if (!include(b)) { ++b; continue; }
+        bool used = BlockInUse(b);
+        int end = b + 1;
+        while (end < to && include(end) && BlockInUse(end) == used) ++end;
+        run(b, end, used);
+        b = end;
+    }
+}
+
+string Normalized(const string& path) {
+    error_code ec;
+    filesystem::path absolute = filesystem::absolute(path, ec);
+    return (ec ? filesystem::path(path) : absolute).lexically_normal().string();
+}
+
+}
+
+bool PunchHole(const string& path, long offset, long length) {
+#if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE)
+    int fd = open(path.c_str(), O_WRONLY);
+    if (fd < 0) return false;
+    bool ok = fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, length) == 0;
+    close(fd);
+    return ok;
+#else
+    (void)path; (void)offset; (void)length;
+    return false;
+#endif
+}
+
+string StripePath(int stripe) {
+    if (stripe == 0) return diskPath;
+    filesystem::path path(stripeLayout.paths[stripe]);
+    if (path.is_absolute()) return path.string();
+    return (filesystem::path(diskPath).parent_path() / path).string();
+}
+
+int BlockStripe(int block) {
+    return block / Unit() % stripeLayout.count;
+}
+
+long StripeOffset(int block) {
+    int unit = Unit();
+    long chunk = block / unit / stripeLayout.count;
+    return (chunk * unit + block % unit) * (long)BLOCK_SIZE;
+}
+
+int StripeBlocks(int stripe, int extent) {
+    int unit = Unit();
+    int span = unit * stripeLayout.count;
+    int blocks = extent / span * unit;
+    int rest = extent % span - stripe * unit;
+    return blocks + max(0, min(unit, rest));
+}
+
+long VolumeFileBytes() {
+    long total = 0;
+    for (int s = 0; s < stripeLayout.count; ++s) {
+        error_code ec;
+        uintmax_t size = filesystem::file_size(StripePath(s), ec);
+        if (!ec) total += (long)size;
+    }
+    return total;
+}
+
+long VolumeAllocatedBytes() {
+#ifdef __linux__
+    long total = 0;
+    for (int s = 0; s < stripeLayout.count; ++s) {
+        struct stat st;
+        if (stat(StripePath(s).c_str(), &st) == 0) total += (long)st.st_blocks * 512;
+    }
+    return total;
+#else
+    return VolumeFileBytes();
+#endif
+}
+
+void ReadStripeData(istream& image) {
+    int unit = Unit();
+    int span = unit * stripeLayout.count;
+    ForEachStripe([&](int s) {
+        ifstream file;
+        if (s > 0) file.open(StripePath(s), ios::binary);
+        istream& in = s == 0 ? image : file;
+        bool more = s == 0 || file.is_open();
+        for (int b = s * unit; b < MAX_BLOCKS; b += span) {
+            long bytes = (long)BLOCK_SIZE * min(unit, MAX_BLOCKS - b);
+            char* dest = &diskData[(long)BLOCK_SIZE * b];
+            streamsize got = 0;
+            if (more) {
+                in.read(dest, bytes);
+                got = max<streamsize>(in.gcount(), 0);
+                more = static_cast<bool>(in);
+            }
+            memset(dest + got, 0, bytes - got);
+        }
+        in.clear();
+    });
+}
+
+bool WriteStripeData(ostream& image, int extent) {
+    int unit = Unit();
+    int span = unit * stripeLayout.count;
+    vector<char> ok(stripeLayout.count, 0);
+    ForEachStripe([&](int s) {
+        ofstream file;
+        if (s > 0) file.open(StripePath(s), ios::binary | ios::trunc);
+        ostream& out = s == 0 ? image : file;
+        // Free blocks are skipped over, so the file system never allocates them.
+        long base = s == 0 ? (long)out.tellp() : 0;
+        for (int chunk = s * unit; chunk < extent; chunk += span) {
+            ForEachRun(chunk, min(chunk + unit, extent), [](int) { return true; }, [&](int b, int end, bool used) {
+                if (!used) return;
+                out.seekp(base + StripeOffset(b));
+                out.write(&diskData[(long)BLOCK_SIZE * b], (long)BLOCK_SIZE * (end - b));
+            });
+        }
+        if (s > 0) file.close();
+        ok[s] = static_cast<bool>(out);
+    });
+    return count(ok.begin(), ok.end(), 0) == 0;
+}
+
+bool WriteDirtyStripes(ostream& image, long imageDataOffset, const vector<bool>& dirty) {
+    int unit = Unit();
+    int span = unit * stripeLayout.count;
+    vector<char> ok(stripeLayout.count, 1);
+    ForEachStripe([&](int s) {
+        fstream file;
+        ostream* out = s == 0 ? &image : nullptr;
+        long base = s == 0 ? imageDataOffset : 0;
+        for (int chunk = s * unit; chunk < MAX_BLOCKS; chunk += span) {
+            auto isDirty = [&](int b) { return static_cast<bool>(dirty[b]); };
+            ForEachRun(chunk, min(chunk + unit, MAX_BLOCKS), isDirty, [&](int b, int end, bool used) {
+                // Blocks freed since the last save become holes.
+                long offset = base + StripeOffset(b);
+                long bytes = (long)BLOCK_SIZE * (end - b);
+                if (!used && PunchHole(StripePath(s), offset, bytes)) return;
+                if (!out) {
+                    // Stripe files are only opened once they have something to write.
+                    file.open(StripePath(s), ios::in | ios::out | ios::binary);
+                    out = &file;
+                }
+                out->seekp(offset);
+                out->write(&diskData[(long)BLOCK_SIZE * b], bytes);
+            });
+        }
+        if (s > 0 && file.is_open()) file.close();
+        ok[s] = !out || static_cast<bool>(*out);
+    });
+    return count(ok.begin(), ok.end(), 0) == 0;
+}
+
+bool TrimStripes(long imageDataOffset, int extent) {
+    bool ok = true;
+    for (int s = 0; s < stripeLayout.count; ++s) {
+        error_code ec;
+        string path = StripePath(s);
+        uintmax_t want = (s == 0 ? imageDataOffset : 0) + (uintmax_t)BLOCK_SIZE * StripeBlocks(s, extent);
+        uintmax_t have = filesystem::file_size(path, ec);
+        if (!ec && have > want) filesystem::resize_file(path, want, ec);
+        ok = ok && !ec;
+    }
+    return ok;
+}
+
+bool SetStripes(int unit, const vector<string>& paths) {
+    if (mountedSnapshot != -1) {
+        cout << "Error: Cannot change the layout while a snapshot is mounted.\n";
+        return false;
+    }
+    if ((int)paths.size() + 1 > MAX_STRIPES || unit < 1 || unit > MAX_BLOCKS) {
+        cout << "Error: At most " << MAX_STRIPES - 1 << " stripe files and a unit of 1 to " << MAX_BLOCKS
+             << " blocks.\n";
+        return false;
+    }
+    StripeLayout layout = {};
+    layout.count = (int)paths.size() + 1;
+    layout.unit = paths.empty() ? 1 : unit;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (paths[i].empty() || paths[i].size() >= (size_t)STRIPE_PATH_LENGTH) {
+            cout << "Error: Stripe paths must be 1 to " << STRIPE_PATH_LENGTH - 1 << " characters.\n";
+            return false;
+        }
+        strcpy(layout.paths[i + 1], paths[i].c_str());
+    }
+
+    StripeLayout old = stripeLayout;
+    vector<string> oldFiles;
+    for (int s = 1; s < old.count; ++s) oldFiles.push_back(Normalized(StripePath(s)));
+    stripeLayout = layout;
+    vector<string> files = {Normalized(diskPath)};
+    for (int s = 1; s < layout.count; ++s) files.push_back(Normalized(StripePath(s)));
+    vector<string> sorted = files;
+    sort(sorted.begin(), sorted.end());
+    if (adjacent_find(sorted.begin(), sorted.end()) != sorted.end()) {
+        stripeLayout = old;
+        cout << "Error: Each stripe needs its own file, other than the image.\n";
+        return false;
+    }
+
+    // Stripe files the layout that ends up in use does not need are deleted.
+    auto removeUnused = [](const vector<string>& candidates, const vector<string>& kept) {
+        for (const string& file : candidates) {
+            if (find(kept.begin(), kept.end(), file) == kept.end()) {
+                error_code ec;
+                filesystem::remove(file, ec);
+            }
+        }
+    };
+    RewriteImage();
+    SaveDisk();
+    if (!ImageInSync()) {
+        stripeLayout = old;
+        RewriteImage();
+        SaveDisk();
+        removeUnused(files, oldFiles);
+        cout << "Error: Could not write the volume in the new layout (do the stripe directories exist?); "
+                "it was left as it was.\n";
+        return false;
+    }
+    removeUnused(oldFiles, files);
+    return true;
+}
+
+void PrintStripes(ostream& out) {
+    if (stripeLayout.count == 1) {
+        out << "Not striped: all blocks are in " << diskPath << ".\n";
+        return;
+    }
+    int extent = UsedBlockExtent();
+    out << stripeLayout.count << " stripes of " << stripeLayout.unit << " block(s):\n";
+    for (int s = 0; s < stripeLayout.count; ++s) {
+        out << "  " << s << ": " << StripePath(s) << " (" << StripeBlocks(s, extent) << " blocks)\n";
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef VFS_STRIPE_H
+#define VFS_STRIPE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "inode.h"
+
+// A volume's data blocks can be striped over several files, e.g. on
+// different disks. Blocks are dealt out `unit` at a time: block b is in
+// stripe (b / unit) % count, and each stripe keeps its blocks back to back
+// in block order. Stripe 0 is the image itself, after its tables; the other
+// stripes are plain data files. Loading and saving the volume read and
+// write all stripes at once, one thread per stripe file. Free blocks are not
+// written: the files are sparse, and blocks freed since the last save are
+// punched out (fallocate on Linux; elsewhere they are written as zeros).
+extern StripeLayout stripeLayout;
+
+std::string StripePath(int stripe);
+int BlockStripe(int block);
+// Byte offset of the block within its stripe's data.
+long StripeOffset(int block);
+// Blocks below `extent` kept in `stripe`.
+int StripeBlocks(int stripe, int extent);
+// Gives the space of a byte range back to the file system; it then reads as
+// zeros. False where that is unsupported, in which case the caller writes
+// the zeros itself.
+bool PunchHole(const std::string& path, long offset, long length);
+// Total size of the image and stripe files.
+long VolumeFileBytes();
+// Disk space they take up; less than their size where free blocks are holes.
+long VolumeAllocatedBytes();
+
+// Fills diskData from the stripes; `image` is positioned at the start of
+// the image's data. Parts missing from the files read as zeros.
+void ReadStripeData(std::istream& image);
+// Writes blocks [0, extent) to the stripes, replacing the stripe files;
+// `image` is positioned at the start of the image's data.
+bool WriteStripeData(std::ostream& image, int extent);
+// Writes the flagged blocks where they belong; the image's data starts at
+// `imageDataOffset` in `image`.
+bool WriteDirtyStripes(std::ostream& image, long imageDataOffset, const std::vector<bool>& dirty);
+// Cuts every stripe file back to the blocks below `extent`.
+bool TrimStripes(long imageDataOffset, int extent);
+
+// Moves the volume to a new layout: the image plus `paths`, `unit` blocks
+// at a time (no paths: everything back in the image), and saves it in full.
+// Stripe files no longer used are deleted.
+bool SetStripes(int unit, const std::vector<std::string>& paths);
+void PrintStripes(std::ostream& out);
+
+#endif
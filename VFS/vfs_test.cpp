@@ -0,0 +1,207 @@
+#include "vfs_disk.h"
+#include "vfs_utils.h"
+#include "vfs_snapshot.h"
+#include "vfs_fileops.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <sstream>
+#include <cstring>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// VFS regression checks. Each check prints one line; the exit code is 1 if
+// any failed. Works on a scratch image (vfs_test.img) with a fixed volume
+// key, and never touches vfs_disk.img or vfs.key.
+//
+// upgrade:  an image in the original layout (no superblock) loads with its
+//           files and cursors, also a cursor seek left past the end of the
+//           file, and is saved in the current layout.
+// rollback: a rolled back transaction restores an inode's damage flag and
+//           checksum and the snapshots, so a damaged inode stays detected.
+// replace:  an update that runs out of space halfway leaves the file as it
+//           was and reports the lack of space.
+
+const string TEST_IMAGE = "vfs_test.img";
+
+static int failures = 0;
+
+static void Check(bool ok, const string& what) {
+    cout << (ok ? "ok      " : "FAILED  ") << what << "\n";
+    if (!ok) ++failures;
+}
+
+static string Contents(const string& name) {
+    int idx = FindFile(name);
+    if (idx == -1) return "<missing>";
+    string out(inodeTable[idx].size, '\0');
+    if (!ReadData(idx, 0, &out[0], (int)out.size())) return "<unreadable>";
+    return out;
+}
+
+static int Cursor(const string& name) {
+    int idx = FindFile(name);
+    return idx == -1 ? -1 : inodeTable[idx].cursor;
+}
+
+static void RemoveImage() {
+    remove(TEST_IMAGE.c_str());
+    remove((TEST_IMAGE + ".v0.bak").c_str());
+    remove((TEST_IMAGE + ".lock").c_str());
+}
+
+// The original inode: startBlock was a byte offset into a data area of
+// MAX_FILES slots of 1 KB after the inode table.
+struct OriginalInode {
+    char fileName[100];
+    int startBlock;
+    int size;
+    int cursor;
+    bool used;
+};
+
+static void RunUpgrade() {
+    RemoveImage();
+    vector<OriginalInode> inodes(MAX_FILES);
+    memset(&inodes[0], 0, sizeof(OriginalInode) * MAX_FILES);
+    vector<char> data(MAX_FILES * 1024, 0);
+    struct { const char* name; const char* contents; int cursor; } files[] = {
+        {"a.txt", "hello", 500},           // create, write hello, seek 500
+        {"b.txt", "second file", 3},
+        {"c.txt", "damaged cursor", -7},
+    };
+    for (int i = 0; i < 3; ++i) {
+        strcpy(inodes[i].fileName, files[i].name);
+        inodes[i].startBlock = i * 1024;
+        inodes[i].size = (int)strlen(files[i].contents);
+        inodes[i].cursor = files[i].cursor;
+        inodes[i].used = true;
+        memcpy(&data[i * 1024], files[i].contents, inodes[i].size);
+    }
+    {
+        ofstream out(TEST_IMAGE, ios::binary);
+        out.write(reinterpret_cast<const char*>(&inodes[0]), sizeof(OriginalInode) * MAX_FILES);
+        out.write(&data[0], data.size());
+    }
+
+    Check(LoadDisk(), "upgrade: an original-layout image loads");
+    Check(Contents("a.txt") == "hello" && Contents("b.txt") == "second file",
+          "upgrade: the files keep their contents");
+    Check(Cursor("a.txt") == 500, "upgrade: a cursor past the end of the file is kept");
+    Check(Cursor("b.txt") == 3, "upgrade: a cursor inside the file is kept");
+    Check(Cursor("c.txt") == (int)strlen(files[2].contents), "upgrade: an invalid cursor moves to the end");
+    Check(filesystem::exists(TEST_IMAGE + ".v0.bak"), "upgrade: the original image is kept");
+
+    SaveDisk();
+    Check(LoadDisk() && ImageInSync() && Contents("a.txt") == "hello" && Cursor("a.txt") == 500,
+          "upgrade: the image is saved in the current layout and loads again");
+    RemoveImage();
+}
+
+// Empties the volume and the scratch image.
+static void ResetVolume() {
+    for (int i = 0; i < MAX_SNAPSHOTS; ++i) {
+        if (snapshots[i].used) DeleteSnapshot(snapshots[i].name);
+    }
+    for (int i = 0; i < MAX_FILES; ++i) {
+        if (inodeTable[i].used) ReleaseFile(i);
+    }
+    RemoveImage();
+    SaveDisk();
+}
+
+static void RunRollback() {
+    ResetVolume();
+    const string contents = "precious data, more than fits inline in the inode " + string(200, 'x');
+    int idx = AllocateFile("keep.txt");
+    Check(idx != -1 && WriteData(idx, 0, contents.data(), (int)contents.size()), "rollback: file written");
+    SaveDisk();
+
+    // Damage the inode in the image: its cursor no longer matches the checksum.
+    {
+        fstream image(TEST_IMAGE, ios::in | ios::out | ios::binary);
+        image.seekp(sizeof(SuperBlock) + sizeof(StripeLayout) + sizeof(Inode) * idx + offsetof(Inode, cursor));
+        image.put('\x5a');
+    }
+    Check(LoadDisk() && badInodes[idx], "rollback: the damaged inode is detected on load");
+    uint32_t crc = inodeCrc[idx];
+
+    BeginTransaction();
+    ReleaseFile(idx);
+    int slot = CreateSnapshot("in-transaction");
+    RollbackTransaction();
+
+    char byte;
+    Check(FindFile("keep.txt") == idx && badInodes[idx] && inodeCrc[idx] == crc,
+          "rollback: the inode is back with its damage flag and checksum");
+    Check(!ReadData(idx, 0, &byte, 1), "rollback: reads of the damaged inode still fail");
+    bool pinned = false;
+    for (int pins : blockPins) pinned = pinned || pins != 0;
+    Check(slot != -1 && FindSnapshot("in-transaction") == -1 && !pinned,
+          "rollback: a snapshot taken in the transaction is gone with its pins");
+
+    SaveDisk();
+    Check(LoadDisk() && badInodes[idx], "rollback: the damage is still detected after a save and reload");
+    ResetVolume();
+    RemoveImage();
+}
+
+// Runs `command` and returns what it printed.
+template <class Command>
+static string Output(Command command) {
+    ostringstream out;
+    streambuf* saved = cout.rdbuf(out.rdbuf());
+    command();
+    cout.rdbuf(saved);
+    return out.str();
+}
+
+static void RunReplace() {
+    ResetVolume();
+    string original(3 * BLOCK_SIZE, 'a');
+    for (int b = 0; b < 3; ++b) original[b * BLOCK_SIZE] = 'X';
+    int doc = AllocateFile("doc.txt");
+    int fill = AllocateFile("fill.bin");
+    string filler((MAX_BLOCKS - 4) * BLOCK_SIZE, 'f');
+    // With every block pinned by a snapshot, each rewritten block needs a
+    // free one, and only one is left.
+    Check(doc != -1 && fill != -1 && WriteData(doc, 0, original.data(), (int)original.size()) &&
+              WriteData(fill, 0, filler.data(), (int)filler.size()) && CreateSnapshot("pin") != -1,
+          "replace: the volume is nearly full");
+
+    // The first of the three replacements fits, the second does not.
+    string printed = Output([] { UpdateFile("doc.txt", "X", "Y", 0); });
+    Check(Contents("doc.txt") == original, "replace: a failed update leaves the file unchanged");
+    Check(printed.find("Not enough space") != string::npos,
+          "replace: the failure is reported as lack of space: " + printed.substr(0, printed.find('\n')));
+
+    printed = Output([] { UpdateFile("doc.txt", "X", "Y", 1); });
+    Check(Contents("doc.txt")[0] == 'Y', "replace: an update that fits goes through");
+    ResetVolume();
+    RemoveImage();
+}
+
+int main() {
+    // A fixed key, so vfs.key is neither read nor created.
+#ifdef _WIN32
+    _putenv_s("VFS_KEY", "vfs_test volume key, 32+ bytes long");
+    _putenv_s("VFS_TRACE", "");
+#else
+    setenv("VFS_KEY", "vfs_test volume key, 32+ bytes long", 1);
+    unsetenv("VFS_TRACE");
+#endif
+    diskPath = TEST_IMAGE;
+
+    RunUpgrade();
+    RunRollback();
+    RunReplace();
+
+    cout << (failures ? "vfs_test: " + to_string(failures) + " check(s) FAILED" : "vfs_test: all checks passed")
+         << "\n";
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,194 @@
+#include "vfs_transfer.h"
+#include "vfs_disk.h"
+#include "vfs_utils.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+struct TransferFile {
+    string name;
+    fs::path path;
+    string data;
+    bool ok = false;
+};
+
+static bool Fail(TransferResult& result, const string& error) {
+    result.error = error;
+    return false;
+}
+
+// Runs work(i) for i in [0, count) on up to one thread per core; threads
+// take the next index as they finish. Returns the number of threads used.
+static int RunPool(size_t count, const function<void(size_t)>& work) {
+    int threads = (int)min<size_t>(max(1u, thread::hardware_concurrency()), max<size_t>(count, 1));
+    atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++) work(i);
+    };
+    vector<thread> pool;
+    for (int t = 1; t < threads; ++t) pool.emplace_back(worker);
+    worker();
+    for (thread& t : pool) t.join();
+    return threads;
+}
+
+static void ReadHostFile(TransferFile& file) {
+    ifstream in(file.path, ios::binary | ios::ate);
+    if (!in) return;
+    streamoff size = in.tellg();
+    if (size < 0 || size > DISK_SIZE) return;
+    file.data.resize((size_t)size);
+    in.seekg(0);
+    in.read(&file.data[0], size);
+    file.ok = in.gcount() == size;
+}
+
+static void WriteHostFile(TransferFile& file) {
+    error_code ec;
+    fs::create_directories(file.path.parent_path(), ec);
+    ofstream out(file.path, ios::binary | ios::trunc);
+    out.write(file.data.data(), file.data.size());
+    file.ok = out.good();
+}
+
+// A volume name is written below the export directory only if it cannot
+// point outside of it.
+static bool SafeHostName(const string& name) {
+    if (name.empty() || name[0] == '/' || name.find('\\') != string::npos || name.find(':') != string::npos) return false;
+    size_t start = 0;
+    while (start <= name.size()) {
+        size_t end = name.find('/', start);
+        if (end == string::npos) end = name.size();
+        string part = name.substr(start, end - start);
+        if (part.empty() || part == "." || part == "..") return false;
+        start = end + 1;
+    }
+    return true;
+}
+
+static double Since(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+bool ImportTree(const string& hostDir, TransferResult& result) {
+    result = TransferResult();
+    auto start = chrono::steady_clock::now();
+    error_code ec;
+    if (!fs::is_directory(hostDir, ec)) return Fail(result, "Not a directory: " + hostDir);
+
+    // Collect the files first, so size limits are checked before anything is read.
+    vector<TransferFile> files;
+    long total = 0;
+    for (fs::recursive_directory_iterator it(hostDir, ec), end; !ec && it != end; it.increment(ec)) {
+        if (!it->is_regular_file(ec)) continue;
+        TransferFile file;
+        file.path = it->path();
+        file.name = file.path.lexically_relative(hostDir).generic_string();
+        if (file.name.size() >= sizeof(Inode::fileName)) return Fail(result, "File name too long: " + file.name);
+        total += (long)it->file_size(ec);
+        if (total > DISK_SIZE) return Fail(result, "Not enough space on disk");
+        files.push_back(file);
+    }
+    if (ec) return Fail(result, "Cannot list " + hostDir + ": " + ec.message());
+    if (files.size() > (size_t)MAX_FILES) return Fail(result, "Inode table full");
+    sort(files.begin(), files.end(), [](const TransferFile& a, const TransferFile& b) { return a.name < b.name; });
+
+    result.threads = RunPool(files.size(), [&](size_t i) { ReadHostFile(files[i]); });
+    for (const TransferFile& file : files) {
+        if (!file.ok) return Fail(result, "Cannot read " + file.path.string());
+    }
+
+    lock_guard<mutex> lock(vfsMutex);
+    if (mountedSnapshot != -1) return Fail(result, "Snapshot is read-only");
+    unordered_map<string, int> existing;
+    for (int i = 0; i < MAX_FILES; ++i) {
+        if (inodeTable[i].used) existing[inodeTable[i].fileName] = i;
+    }
+
+    BeginTransaction();
+    for (const TransferFile& file : files) {
+        auto found = existing.find(file.name);
+        int idx = found != existing.end() ? found->second : AllocateFile(file.name);
+        if (idx == -1) {
+            RollbackTransaction();
+            return Fail(result, "Inode table full");
+        }
+        if (!WriteData(idx, 0, file.data.data(), file.data.size()) || !TruncateData(idx, file.data.size())) {
+            RollbackTransaction();
+            return Fail(result, WriteFailureReason());
+        }
+        inodeTable[idx].cursor = inodeTable[idx].size;
+        result.bytes += file.data.size();
+    }
+    CommitTransaction();
+    result.files = files.size();
+    result.seconds = Since(start);
+    return true;
+}
+
+bool ExportTree(const string& hostDir, TransferResult& result) {
+    result = TransferResult();
+    auto start = chrono::steady_clock::now();
+
+    vector<TransferFile> files;
+    {
+        lock_guard<mutex> lock(vfsMutex);
+        for (int i = 0; i < MAX_FILES; ++i) {
+            if (!inodeTable[i].used) continue;
+            TransferFile file;
+            file.name = inodeTable[i].fileName;
+            if (!SafeHostName(file.name)) return Fail(result, "Cannot export file name: " + file.name);
+            file.data.resize(inodeTable[i].size);
+            if (!ReadData(i, 0, &file.data[0], file.data.size())) return Fail(result, "Read failed: " + file.name);
+            files.push_back(file);
+        }
+    }
+
+    error_code ec;
+    fs::create_directories(hostDir, ec);
+    if (!fs::is_directory(hostDir, ec)) return Fail(result, "Cannot create " + hostDir);
+    for (TransferFile& file : files) file.path = fs::path(hostDir) / fs::path(file.name);
+
+    result.threads = RunPool(files.size(), [&](size_t i) { WriteHostFile(files[i]); });
+    for (const TransferFile& file : files) {
+        if (!file.ok) return Fail(result, "Cannot write " + file.path.string());
+        result.bytes += file.data.size();
+    }
+    result.files = files.size();
+    result.seconds = Since(start);
+    return true;
+}
+
+static void PrintTransfer(const char* verb, const TransferResult& result) {
+    cout << verb << " " << result.files << " file" << (result.files == 1 ? "" : "s") << " (" << result.bytes
+         << " bytes) in " << result.seconds << " s with " << result.threads << " thread"
+         << (result.threads == 1 ? "" : "s") << ".\n";
+}
+
+void RunImport(const string& hostDir) {
+    TransferResult result;
+    if (!ImportTree(hostDir, result)) {
+        cout << "Error: " << result.error << ".\n";
+        return;
+    }
+    PrintTransfer("Imported", result);
+}
+
+void RunExport(const string& hostDir) {
+    TransferResult result;
+    if (!ExportTree(hostDir, result)) {
+        cout << "Error: " << result.error << ".\n";
+        return;
+    }
+    PrintTransfer("Exported", result);
+}
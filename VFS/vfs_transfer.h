@@ -0,0 +1,29 @@
+#ifndef VFS_TRANSFER_H
+#define VFS_TRANSFER_H
+
+#include <string>
+
+struct TransferResult {
+    int files = 0;
+    long bytes = 0;
+    double seconds = 0;
+    int threads = 0;       // host readers (import) or writers (export)
+    std::string error;
+};
+
+// Copies every regular file under `hostDir` into the volume, named by its
+// path relative to `hostDir` ("docs/a.txt"). Host files are read by a pool of
+// threads without holding vfsMutex; the files are then allocated and stored
+// under one lock as a single transaction with one SaveDisk, so either all of
+// them are imported or none. Existing files of the same name are replaced.
+bool ImportTree(const std::string& hostDir, TransferResult& result);
+
+// Writes every file of the volume (or of the mounted snapshot) below
+// `hostDir`, creating subdirectories for names containing '/'. Contents are
+// copied out under vfsMutex, then written by a pool of threads.
+bool ExportTree(const std::string& hostDir, TransferResult& result);
+
+void RunImport(const std::string& hostDir);
+void RunExport(const std::string& hostDir);
+
+#endif
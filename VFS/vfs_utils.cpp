@@ -1,24 +1,405 @@
 #include "vfs_utils.h"
 #include "vfs_disk.h"
+#include "vfs_crypto.h"
+#include "vfs_stats.h"
+#include "vfs_readahead.h"
+#include "vfs_index.h"
 #include <string>
+#include <cstring>
+#include <algorithm>
 
+// Lookups and allocation go through the bitmaps and name index of
+// vfs_index.h; every change below to an inode's use or a block's state is
+// passed on to it.
 int FindFreeInode() {
-    for (int i = 0; i < MAX_FILES; ++i) {
-        if (!inodeTable[i].used) return i;
-    }
-    return -1;
+    return IndexFreeInode();
 }
 
+// A block is only reusable once no snapshot references it either.
 int FindFreeBlock() {
-    for (int i = 0; i < MAX_FILES; ++i) {
-        if (!inodeTable[i].used) return i * FILE_SIZE;
-    }
-    return -1;
+    return IndexFreeBlock();
 }
 
 int FindFile(const std::string& name) {
-    for (int i = 0; i < MAX_FILES; ++i) {
-        if (inodeTable[i].used && name == inodeTable[i].fileName) return i;
+    StatTimer timer(STAT_LOOKUP);
+    return IndexFindFile(name);
+}
+
+static const char* writeFailure = "";
+
+static bool NoSpace() {
+    writeFailure = "Not enough space on disk";
+    return false;
+}
+
+// The file key is unwrapped from the inode, so a damaged inode is the usual
+// cause; otherwise the volume key is missing or wrong.
+static bool CryptFailed(int idx) {
+    writeFailure = badInodes[idx] ? "File metadata failed its checksum; its key cannot be used"
+                                  : "Cannot encrypt the data (volume key missing or wrong)";
+    return false;
+}
+
+const char* WriteFailureReason() {
+    return writeFailure;
+}
+
+static char* BlockData(int block) {
+    return &diskData[(long)block * BLOCK_SIZE];
+}
+
+static void FreeBlock(int block) {
+    // A snapshot may still read this block, so its data stays until the
+    // snapshot is deleted.
+    if (blockPins[block] == 0) {
+        MarkBlockDirty(block);
+        memset(BlockData(block), 0, BLOCK_SIZE);
+        badBlocks[block] = false;
+    }
+    blockMap[block] = BLOCK_FREE;
+    IndexBlock(block);
+}
+
+// Returns the n-th block of a file's chain, or BLOCK_END past its end.
+static int BlockAt(int idx, int n) {
+    int block = inodeTable[idx].startBlock;
+    while (n-- > 0 && block != BLOCK_END) block = blockMap[block];
+    return block;
+}
+
+// Gives the file its own copy of `block` if a snapshot still references it,
+// relinking the chain from `prev` (BLOCK_END for the first block). Returns
+// the block to modify, or -1 if no free block is left for the copy.
+static int UnshareBlock(int idx, int prev, int block) {
+    if (blockPins[block] == 0) return block;
+    int copy = FindFreeBlock();
+    if (copy == -1) return -1;
+    MarkBlockDirty(copy);
+    memcpy(BlockData(copy), BlockData(block), BLOCK_SIZE);
+    blockGeneration[copy] = blockGeneration[block];
+    if (badBlocks[block]) {
+        badBlocks[copy] = true;
+        blockCrc[copy] = blockCrc[block];
+    }
+    blockMap[copy] = blockMap[block];
+    blockMap[block] = BLOCK_FREE;
+    IndexBlock(copy);
+    IndexBlock(block);
+    if (prev == BLOCK_END) inodeTable[idx].startBlock = copy;
+    else blockMap[prev] = copy;
+    return copy;
+}
+
+// Number of blocks covering bytes [from, to) of the file that are shared
+// with a snapshot, i.e. that a write to that range has to copy first.
+static int SharedBlocks(int idx, int from, int to) {
+    int count = 0;
+    long start = 0;
+    for (int b = inodeTable[idx].startBlock; b != BLOCK_END && start < to; b = blockMap[b], start += BLOCK_SIZE) {
+        if (start + BLOCK_SIZE > from && blockPins[b] > 0) ++count;
+    }
+    return count;
+}
+
+// Grows the file's chain so it covers `bytes` bytes, and makes sure `extra`
+// more free blocks remain for copies of shared blocks. Nothing is allocated
+// unless enough free blocks exist for the whole request.
+static bool ReserveBlocks(int idx, int bytes, int extra) {
+    int needed = (bytes + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    int have = 0;
+    int last = BLOCK_END;
+    for (int b = inodeTable[idx].startBlock; b != BLOCK_END; b = blockMap[b]) {
+        last = b;
+        ++have;
+    }
+    int wanted = std::max(0, needed - have) + extra;
+    if (wanted == 0) return true;
+
+    StatTimer timer(STAT_ALLOCATE);
+    if (IndexCountFreeBlocks(wanted) < wanted) return false;
+
+    for (; have < needed; ++have) {
+        int block = FindFreeBlock();
+        MarkBlockDirty(block);
+        blockMap[block] = BLOCK_END;
+        IndexBlock(block);
+        memset(BlockData(block), 0, BLOCK_SIZE);
+        badBlocks[block] = false;
+        if (last == BLOCK_END) inodeTable[idx].startBlock = block;
+        else blockMap[last] = block;
+        last = block;
+    }
+    return true;
+}
+
+// Copies `len` bytes into the file at `offset`, block by block. A null
+// `data` stores zeros. The chain must already cover the range. Every block
+// touched is encrypted again as a whole under a new write generation, so a
+// partial write first decrypts the bytes it keeps.
+static bool StoreRange(int idx, int offset, const char* data, int len) {
+    int known = std::max(inodeTable[idx].size, offset);  // bytes the file holds before this write
+    int end = std::max(known, offset + len);
+    int first = offset / BLOCK_SIZE;
+    int prev = first == 0 ? BLOCK_END : BlockAt(idx, first - 1);
+    int block = prev == BLOCK_END ? inodeTable[idx].startBlock : blockMap[prev];
+    int done = 0;
+    char plain[BLOCK_SIZE];
+    while (done < len) {
+        int pos = (offset + done) % BLOCK_SIZE;
+        int base = offset + done - pos;
+        int chunk = std::min(len - done, BLOCK_SIZE - pos);
+        int keep = std::min(end - base, BLOCK_SIZE);
+        block = UnshareBlock(idx, prev, block);
+        if (block == -1) return NoSpace();
+        char* dest = BlockData(block);
+        MarkBlockDirty(block);
+        if (chunk < BLOCK_SIZE) {
+            int have = std::max(0, std::min(known - base, BLOCK_SIZE));
+            memcpy(plain, dest, have);
+            memset(plain + have, 0, BLOCK_SIZE - have);
+            if (!CryptRange(idx, base, plain, have, blockGeneration[block])) return CryptFailed(idx);
+        }
+        if (data) memcpy(plain + pos, data + done, chunk);
+        else memset(plain + pos, 0, chunk);
+        uint64_t generation = NextWriteGeneration();
+        if (!CryptRange(idx, base, plain, keep, generation)) return CryptFailed(idx);
+        memcpy(dest, plain, keep);
+        blockGeneration[block] = generation;
+        if (chunk == BLOCK_SIZE) badBlocks[block] = false;  // fully rewritten
+        done += chunk;
+        prev = block;
+        block = blockMap[block];
+    }
+    return true;
+}
+
+// Stores `len` bytes unencrypted in a new chain of blocks and sets `first`
+// to its first block (BLOCK_END when `len` is 0). Chains are never modified
+// in place; a new version is stored and the old chain freed, so snapshots
+// keep theirs.
+bool StoreChain(const char* data, int len, int& first) {
+    int needed = (len + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    if (IndexCountFreeBlocks(needed) < needed) return false;
+
+    first = BLOCK_END;
+    int last = BLOCK_END;
+    for (int done = 0; done < len; done += BLOCK_SIZE) {
+        int block = FindFreeBlock();
+        int chunk = std::min(len - done, BLOCK_SIZE);
+        MarkBlockDirty(block);
+        memcpy(BlockData(block), data + done, chunk);
+        memset(BlockData(block) + chunk, 0, BLOCK_SIZE - chunk);
+        badBlocks[block] = false;
+        blockMap[block] = BLOCK_END;
+        IndexBlock(block);
+        if (last == BLOCK_END) first = block;
+        else blockMap[last] = block;
+        last = block;
     }
-    return -1;
+    return true;
+}
+
+// Copies the first `len` bytes of a chain stored by StoreChain.
+bool LoadChain(int first, char* out, int len) {
+    int block = first;
+    for (int done = 0; done < len; done += BLOCK_SIZE) {
+        if (block < 0 || badBlocks[block]) return false;
+        memcpy(out + done, BlockData(block), std::min(len - done, BLOCK_SIZE));
+        block = blockMap[block];
+    }
+    return true;
+}
+
+void FreeChain(int first) {
+    while (first >= 0) {
+        int next = blockMap[first];
+        FreeBlock(first);
+        first = next;
+    }
+}
+
+// Claims an inode for a new, empty file. Blocks are only allocated once data
+// is written. Returns the inode index, or -1 when the inode table is full.
+int AllocateFile(const std::string& name) {
+    StatTimer timer(STAT_ALLOCATE);
+    int idx = FindFreeInode();
+    if (idx == -1) return -1;
+
+    Inode& node = inodeTable[idx];
+    if (!InitFileKey(node)) return -1;
+    strncpy(node.fileName, name.c_str(), 99);
+    node.fileName[99] = '\0';
+    node.startBlock = BLOCK_END;
+    node.size = 0;
+    node.cursor = 0;
+    node.used = true;
+    node.xattrBlock = BLOCK_END;
+    node.xattrSize = 0;
+    memset(node.xattrs, 0, sizeof(node.xattrs));
+    node.dataInline = false;
+    memset(node.inlineData, 0, sizeof(node.inlineData));
+    badInodes[idx] = false;
+    IndexInode(idx);
+    return idx;
+}
+
+void ReleaseFile(int idx) {
+    ReadaheadForget(idx);
+    FreeChain(inodeTable[idx].startBlock);
+    FreeChain(inodeTable[idx].xattrBlock);
+    inodeTable[idx].used = false;
+    inodeTable[idx].startBlock = BLOCK_END;
+    inodeTable[idx].size = 0;
+    inodeTable[idx].cursor = 0;
+    inodeTable[idx].xattrBlock = BLOCK_END;
+    inodeTable[idx].xattrSize = 0;
+    memset(inodeTable[idx].xattrs, 0, sizeof(inodeTable[idx].xattrs));
+    inodeTable[idx].dataInline = false;
+    memset(inodeTable[idx].inlineData, 0, sizeof(inodeTable[idx].inlineData));
+    badInodes[idx] = false;
+    IndexInode(idx);
+    ForgetFileKey(idx);
+}
+
+// Copies `len` bytes at `offset` of the file into `out`, decrypting them.
+// The range must lie within the file's size. Fails if the inode or one of
+// the blocks failed its checksum.
+bool ReadData(int idx, int offset, char* out, int len) {
+    StatTimer timer(STAT_COPY_OUT);
+    StatAdd(STAT_BYTES_OUT, len);
+    if (mountedSnapshot == -1 && badInodes[idx]) return false;
+    if (inodeTable[idx].dataInline) {
+        if (len > 0) memcpy(out, inodeTable[idx].inlineData + offset, len);
+        return CryptRange(idx, offset, out, len, inodeTable[idx].inlineGeneration);
+    }
+    return ReadaheadRead(idx, offset, out, len);
+}
+
+// Writes into the inode's inline data; the file stays within INLINE_DATA.
+// Like a block, the inline data is encrypted again under a new generation.
+static bool StoreInline(int idx, int offset, const char* data, int len) {
+    Inode& node = inodeTable[idx];
+    char plain[INLINE_DATA] = {0};
+    memcpy(plain, node.inlineData, node.size);
+    if (!CryptRange(idx, 0, plain, node.size, node.inlineGeneration)) return CryptFailed(idx);
+    if (data) memcpy(plain + offset, data, len);
+    else memset(plain + offset, 0, len);
+    int size = std::max(node.size, offset + len);
+    uint64_t generation = NextWriteGeneration();
+    if (!CryptRange(idx, 0, plain, size, generation)) return CryptFailed(idx);
+    memcpy(node.inlineData, plain, size);
+    node.inlineGeneration = generation;
+    node.dataInline = true;
+    node.size = size;
+    return true;
+}
+
+// Moves inline data out to a block once the file outgrows the inode. The
+// bytes are already encrypted for their offsets, so they move as they are,
+// together with their generation.
+static bool SpillInline(int idx) {
+    Inode& node = inodeTable[idx];
+    node.dataInline = false;
+    if (node.size > 0) {
+        if (!ReserveBlocks(idx, node.size, 0)) {
+            node.dataInline = true;
+            return NoSpace();
+        }
+        MarkBlockDirty(node.startBlock);
+        memcpy(BlockData(node.startBlock), node.inlineData, node.size);
+        blockGeneration[node.startBlock] = node.inlineGeneration;
+    }
+    memset(node.inlineData, 0, sizeof(node.inlineData));
+    return true;
+}
+
+// Stores `len` bytes at `offset` of the file, growing it as needed. Writing
+// past the end fills the gap with zeros, like pwrite on a regular file.
+// Only the blocks covering the range are touched.
+bool WriteData(int idx, int offset, const char* data, int len) {
+    StatTimer timer(STAT_COPY_IN);
+    Inode& node = inodeTable[idx];
+    if (offset < 0 || len < 0 || (long)offset + len > DISK_SIZE) {
+        writeFailure = "Offset or size out of range";
+        return false;
+    }
+    ReadaheadForget(idx);
+    int end = offset + len;
+    if (node.dataInline || node.startBlock == BLOCK_END) {
+        if (std::max(end, node.size) <= INLINE_DATA) {
+            if (!StoreInline(idx, offset, data, len)) return false;
+            StatAdd(STAT_BYTES_IN, len);
+            return true;
+        }
+        if (node.dataInline && !SpillInline(idx)) return false;
+    }
+    if (!ReserveBlocks(idx, end, SharedBlocks(idx, std::min(offset, node.size), end))) return NoSpace();
+
+    if (offset > node.size && !StoreRange(idx, node.size, nullptr, offset - node.size)) return false;
+    if (!StoreRange(idx, offset, data, len)) return false;
+    node.size = std::max(node.size, end);
+    StatAdd(STAT_BYTES_IN, len);
+    return true;
+}
+
+// Sets the file size, zero-extending it or releasing the blocks past the new end.
+bool TruncateData(int idx, int size) {
+    Inode& node = inodeTable[idx];
+    if (size < 0) {
+        writeFailure = "Invalid size";
+        return false;
+    }
+    if (size > node.size) return WriteData(idx, node.size, nullptr, size - node.size);
+    ReadaheadForget(idx);
+    if (node.dataInline) {
+        memset(node.inlineData + size, 0, node.size - size);
+        node.size = size;
+        node.cursor = std::min(node.cursor, size);
+        return true;
+    }
+    // A file cut down to inline size moves back into its inode; the old
+    // blocks are freed (or left to the snapshots that still use them).
+    int first = node.startBlock;
+    if (size > 0 && size <= INLINE_DATA && first != BLOCK_END && !badBlocks[first]) {
+        memcpy(node.inlineData, BlockData(first), size);
+        memset(node.inlineData + size, 0, sizeof(node.inlineData) - size);
+        node.inlineGeneration = blockGeneration[first];
+        node.dataInline = true;
+        node.startBlock = BLOCK_END;
+        FreeChain(first);
+        node.size = size;
+        node.cursor = std::min(node.cursor, size);
+        return true;
+    }
+
+    int keep = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    int block;
+    if (keep == 0) {
+        block = node.startBlock;
+        node.startBlock = BLOCK_END;
+    } else {
+        int prev = keep == 1 ? BLOCK_END : BlockAt(idx, keep - 2);
+        int last = prev == BLOCK_END ? node.startBlock : blockMap[prev];
+        int tail = size % BLOCK_SIZE;
+        if (tail) {
+            // Clearing the cut-off bytes is a write, so a shared block is copied first.
+            last = UnshareBlock(idx, prev, last);
+            if (last == -1) return NoSpace();
+        }
+        block = blockMap[last];
+        blockMap[last] = BLOCK_END;
+        if (tail) {
+            MarkBlockDirty(last);
+            memset(BlockData(last) + tail, 0, BLOCK_SIZE - tail);
+        }
+    }
+    while (block != BLOCK_END) {
+        int next = blockMap[block];
+        FreeBlock(block);
+        block = next;
+    }
+
+    node.size = size;
+    node.cursor = std::min(node.cursor, size);
+    return true;
 }
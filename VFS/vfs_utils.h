@@ -7,4 +7,17 @@ int FindFreeInode();
 int FindFreeBlock();
 int FindFile(const std::string& name);
 
+int AllocateFile(const std::string& name);
+void ReleaseFile(int idx);
+bool ReadData(int idx, int offset, char* out, int len);
+bool WriteData(int idx, int offset, const char* data, int len);
+bool TruncateData(int idx, int size);
+// Why the last failed WriteData or TruncateData call failed, e.g. "Not
+// enough space on disk", for the error message.
+const char* WriteFailureReason();
+
+bool StoreChain(const char* data, int len, int& first);
+bool LoadChain(int first, char* out, int len);
+void FreeChain(int first);
+
 #endif
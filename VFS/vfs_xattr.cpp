@@ -0,0 +1,231 @@
+#include "vfs_xattr.h"
+#include "vfs_disk.h"
+#include "vfs_utils.h"
+#include <iostream>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+const int XATTR_HEADER = 4;
+
+static void EncodeRecord(const Xattr& attr, string& out) {
+    string value;
+    if (attr.type == XATTR_STRING) {
+        value = attr.text;
+    } else if (attr.type == XATTR_INT) {
+        unsigned long long n = (unsigned long long)attr.number;
+        for (int i = 0; i < 8; ++i) value += (char)((n >> (8 * i)) & 0xff);
+    } else {
+        value.assign(1, attr.number ? 1 : 0);
+    }
+    out += (char)attr.type;
+    out += (char)attr.name.size();
+    out += (char)(value.size() & 0xff);
+    out += (char)(value.size() >> 8);
+    out += attr.name;
+    out += value;
+}
+
+// Appends the records packed in `data`. The inline area ends at the first
+// zero type byte; a record running past `len` means the inode is damaged.
+static bool DecodeRecords(const unsigned char* data, int len, vector<Xattr>& attrs) {
+    int pos = 0;
+    while (pos + XATTR_HEADER <= len && data[pos] != 0) {
+        Xattr attr;
+        attr.type = (XattrType)data[pos];
+        int nameLen = data[pos + 1];
+        int valueLen = data[pos + 2] | (data[pos + 3] << 8);
+        pos += XATTR_HEADER;
+        if (pos + nameLen + valueLen > len) return false;
+        attr.name.assign(reinterpret_cast<const char*>(data + pos), nameLen);
+        const unsigned char* value = data + pos + nameLen;
+        if (attr.type == XATTR_STRING) {
+            attr.text.assign(reinterpret_cast<const char*>(value), valueLen);
+        } else if (attr.type == XATTR_INT && valueLen == 8) {
+            unsigned long long n = 0;
+            for (int i = 0; i < 8; ++i) n |= (unsigned long long)value[i] << (8 * i);
+            attr.number = (long long)n;
+        } else if (attr.type == XATTR_BOOL && valueLen == 1) {
+            attr.number = value[0] != 0;
+        } else {
+            return false;
+        }
+        attrs.push_back(attr);
+        pos += nameLen + valueLen;
+    }
+    return true;
+}
+
+static bool LoadSpill(const Inode& node, string& spill) {
+    spill.assign(node.xattrSize, '\0');
+    return node.xattrSize == 0 || LoadChain(node.xattrBlock, &spill[0], node.xattrSize);
+}
+
+bool GetXattrs(int idx, vector<Xattr>& attrs) {
+    attrs.clear();
+    if (mountedSnapshot == -1 && badInodes[idx]) return false;
+    const Inode& node = inodeTable[idx];
+    string spill;
+    if (!DecodeRecords(node.xattrs, XATTR_INLINE, attrs) || !LoadSpill(node, spill)) return false;
+    return DecodeRecords(reinterpret_cast<const unsigned char*>(spill.data()), spill.size(), attrs);
+}
+
+bool GetXattr(int idx, const string& name, Xattr& attr) {
+    vector<Xattr> attrs;
+    if (!GetXattrs(idx, attrs)) return false;
+    for (const Xattr& a : attrs) {
+        if (a.name == name) {
+            attr = a;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Packs the records first-fit into the inline area and the rest into the
+// spill chain. The chain is only replaced if its contents change.
+static bool StoreXattrs(int idx, const vector<Xattr>& attrs) {
+    Inode& node = inodeTable[idx];
+    unsigned char packed[XATTR_INLINE] = {};
+    int used = 0;
+    string spill;
+    for (const Xattr& attr : attrs) {
+        string record;
+        EncodeRecord(attr, record);
+        if (used + (int)record.size() <= XATTR_INLINE) {
+            memcpy(packed + used, record.data(), record.size());
+            used += record.size();
+        } else {
+            spill += record;
+        }
+    }
+    if (spill.size() > (size_t)XATTR_SPILL_MAX) return false;
+
+    string oldSpill;
+    bool sameSpill = LoadSpill(node, oldSpill) && oldSpill == spill;
+    if (!sameSpill) {
+        int first;
+        if (!StoreChain(spill.data(), spill.size(), first)) return false;
+        FreeChain(node.xattrBlock);
+        node.xattrBlock = first;
+        node.xattrSize = spill.size();
+    }
+    memcpy(node.xattrs, packed, XATTR_INLINE);
+    return true;
+}
+
+bool SetXattr(int idx, const Xattr& attr) {
+    if (attr.name.empty() || attr.name.size() > (size_t)XATTR_NAME_MAX) return false;
+    if (attr.type == XATTR_STRING && attr.text.size() > (size_t)XATTR_VALUE_MAX) return false;
+    if (attr.type != XATTR_STRING && attr.type != XATTR_INT && attr.type != XATTR_BOOL) return false;
+    vector<Xattr> attrs;
+    if (!GetXattrs(idx, attrs)) return false;
+    bool replaced = false;
+    for (Xattr& a : attrs) {
+        if (a.name == attr.name) {
+            a = attr;
+            replaced = true;
+        }
+    }
+    if (!replaced) attrs.push_back(attr);
+    return StoreXattrs(idx, attrs);
+}
+
+bool RemoveXattr(int idx, const string& name) {
+    vector<Xattr> attrs;
+    if (!GetXattrs(idx, attrs)) return false;
+    for (size_t i = 0; i < attrs.size(); ++i) {
+        if (attrs[i].name == name) {
+            attrs.erase(attrs.begin() + i);
+            return StoreXattrs(idx, attrs);
+        }
+    }
+    return false;
+}
+
+bool ParseXattr(const string& name, const string& type, const string& value, Xattr& attr) {
+    attr = Xattr();
+    attr.name = name;
+    if (type == "string") {
+        attr.type = XATTR_STRING;
+        attr.text = value;
+        return true;
+    }
+    if (type == "bool") {
+        attr.type = XATTR_BOOL;
+        if (value == "true" || value == "1") attr.number = 1;
+        else if (value != "false" && value != "0") return false;
+        return true;
+    }
+    if (type == "int") {
+        attr.type = XATTR_INT;
+        try {
+            size_t end;
+            attr.number = stoll(value, &end);
+            return end == value.size();
+        } catch (const logic_error&) {
+            return false;
+        }
+    }
+    return false;
+}
+
+string FormatXattr(const Xattr& attr) {
+    if (attr.type == XATTR_STRING) return attr.text;
+    if (attr.type == XATTR_BOOL) return attr.number ? "true" : "false";
+    return to_string(attr.number);
+}
+
+void SetAttribute(const string& file, const string& name, const string& type, const string& value) {
+    int idx = FindFile(file);
+    if (idx == -1) {
+        cout << "Error: File not found.\n";
+        return;
+    }
+    Xattr attr;
+    if (!ParseXattr(name, type, value, attr)) {
+        cout << "Error: Invalid attribute type or value.\n";
+        return;
+    }
+    if (!SetXattr(idx, attr)) {
+        cout << "Error: Attribute too large or not enough space on disk.\n";
+        return;
+    }
+    SaveDisk();
+    cout << "Attribute set.\n";
+}
+
+void ShowAttributes(const string& file, const string& name) {
+    int idx = FindFile(file);
+    if (idx == -1) {
+        cout << "Error: File not found.\n";
+        return;
+    }
+    vector<Xattr> attrs;
+    if (!GetXattrs(idx, attrs)) {
+        cout << "Error: Read failed (checksum mismatch).\n";
+        return;
+    }
+    bool found = false;
+    for (const Xattr& attr : attrs) {
+        if (!name.empty() && attr.name != name) continue;
+        cout << attr.name << " = " << FormatXattr(attr) << "\n";
+        found = true;
+    }
+    if (!found) cout << (name.empty() ? "No attributes.\n" : "Error: Attribute not found.\n");
+}
+
+void RemoveAttribute(const string& file, const string& name) {
+    int idx = FindFile(file);
+    if (idx == -1) {
+        cout << "Error: File not found.\n";
+        return;
+    }
+    if (!RemoveXattr(idx, name)) {
+        cout << "Error: Attribute not found.\n";
+        return;
+    }
+    SaveDisk();
+    cout << "Attribute removed.\n";
+}
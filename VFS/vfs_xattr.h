@@ -0,0 +1,46 @@
+#ifndef VFS_XATTR_H
+#define VFS_XATTR_H
+
+#include <string>
+#include <vector>
+
+// Extended attributes: small typed name/value pairs stored with the inode.
+// Each is packed as one record: type (1 byte), name length (1), value length
+// (2, little endian), name, value. Records go into the inode's inline area
+// while they fit; the rest spill to a chain of blocks (Inode::xattrBlock).
+// Attributes are not encrypted.
+enum XattrType : unsigned char {
+    XATTR_STRING = 1,
+    XATTR_INT = 2,       // 64-bit signed, e.g. a timestamp in milliseconds
+    XATTR_BOOL = 3,
+};
+
+const int XATTR_NAME_MAX = 64;
+const int XATTR_VALUE_MAX = 4096;
+const int XATTR_SPILL_MAX = 16 * 1024;  // bytes of records per file outside the inode
+
+struct Xattr {
+    std::string name;
+    XattrType type = XATTR_STRING;
+    std::string text;       // XATTR_STRING
+    long long number = 0;   // XATTR_INT, XATTR_BOOL (0 or 1)
+};
+
+// All of them work on inode `idx` of the current inode table and expect the
+// caller to hold vfsMutex, like the functions in vfs_utils.h.
+bool GetXattrs(int idx, std::vector<Xattr>& attrs);
+bool GetXattr(int idx, const std::string& name, Xattr& attr);
+bool SetXattr(int idx, const Xattr& attr);
+bool RemoveXattr(int idx, const std::string& name);
+
+// Parses a value given as text for the given type name ("string", "int",
+// "bool"); false if the type or the value is not valid.
+bool ParseXattr(const std::string& name, const std::string& type, const std::string& value, Xattr& attr);
+std::string FormatXattr(const Xattr& attr);
+
+// Shell commands.
+void SetAttribute(const std::string& file, const std::string& name, const std::string& type, const std::string& value);
+void ShowAttributes(const std::string& file, const std::string& name);
+void RemoveAttribute(const std::string& file, const std::string& name);
+
+#endif